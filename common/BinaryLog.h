@@ -0,0 +1,115 @@
+// BinaryLog: the compact log format written when com_binarylog is on, and read back by the logdecode tool.
+// Instead of formatted text, each message stores the id of its format string along with the raw arguments.
+#pragma once
+#include <inttypes.h>
+#include <string.h>
+
+// Binary log version history
+// v1 - Base type
+
+#define BLOG_HEADER		"RBLG"
+#define BLOG_VERSION	1
+
+/*
+File layout:
+	char[4]		header ("RBLG")
+	uint32_t	version
+	...records, each starting with a uint8_t record type
+
+BLOG_RECORD_FORMAT (sent the first time a format string is used):
+	uint32_t	format id
+	uint16_t	length
+	char[]		format string (not null-terminated)
+
+BLOG_RECORD_MESSAGE:
+	uint8_t		priority
+	uint32_t	ticks
+	uint32_t	format id
+	uint16_t	size of argument data
+	...arguments, in the order they appear in the format string:
+		BLOG_ARG_INT:		int64_t
+		BLOG_ARG_DOUBLE:	double
+		BLOG_ARG_STRING:	uint16_t length, char[] (not null-terminated)
+*/
+
+enum binaryLogRecord_e {
+	BLOG_RECORD_FORMAT = 1,
+	BLOG_RECORD_MESSAGE,
+};
+
+enum binaryLogArg_e {
+	BLOG_ARG_NONE,
+	BLOG_ARG_INT,
+	BLOG_ARG_LONGLONG,	// decoded the same as BLOG_ARG_INT, but read from the va_list as a 64-bit value
+	BLOG_ARG_DOUBLE,
+	BLOG_ARG_STRING,
+	BLOG_ARG_POINTER,
+};
+
+// One conversion specifier in a format string, eg "%-8.2f"
+struct binaryLogSpec_t {
+	const char* start;		// points at the %
+	size_t length;			// length of the whole specifier
+	int numStarArgs;		// number of * widths/precisions, which each take an int argument first
+	binaryLogArg_e argType;
+};
+
+// Finds the next conversion specifier in a format string, starting at p.
+// Returns false when there are none left. Literal text (and %%) between specifiers is skipped over, the caller
+// can find it by looking at the gap between p and spec.start.
+inline bool BinaryLog_NextSpec(const char*& p, binaryLogSpec_t& spec) {
+	while (*p) {
+		if (*p != '%') {
+			p++;
+			continue;
+		}
+		if (p[1] == '%') {
+			p += 2;
+			continue;
+		}
+		spec.start = p;
+		spec.numStarArgs = 0;
+		const char* s = p + 1;
+
+		// flags, width, precision
+		while (*s && strchr("-+ #0", *s)) s++;
+		while (*s == '*' || (*s >= '0' && *s <= '9')) { if (*s == '*') spec.numStarArgs++; s++; }
+		if (*s == '.') {
+			s++;
+			while (*s == '*' || (*s >= '0' && *s <= '9')) { if (*s == '*') spec.numStarArgs++; s++; }
+		}
+
+		// length modifiers
+		bool bLongLong = false;
+		if (!strncmp(s, "I64", 3)) { bLongLong = true; s += 3; }
+		else if (!strncmp(s, "ll", 2)) { bLongLong = true; s += 2; }
+		else if (*s == 'j') { bLongLong = true; s++; }
+		else if (*s == 'z' || *s == 't') { bLongLong = sizeof(size_t) == 8; s++; }
+		else if (*s == 'l') { bLongLong = sizeof(long) == 8; s++; }
+		else if (!strncmp(s, "hh", 2)) { s += 2; }
+		else if (*s == 'h' || *s == 'L') { s++; }
+
+		switch (*s) {
+			case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+				spec.argType = bLongLong ? BLOG_ARG_LONGLONG : BLOG_ARG_INT;
+				break;
+			case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+				spec.argType = BLOG_ARG_DOUBLE;
+				break;
+			case 's':
+				spec.argType = BLOG_ARG_STRING;
+				break;
+			case 'p':
+				spec.argType = BLOG_ARG_POINTER;
+				break;
+			default:
+				spec.argType = BLOG_ARG_NONE;	// malformed or unsupported (%n), doesn't consume an argument
+				break;
+		}
+		if (*s) s++;
+		spec.length = s - spec.start;
+		p = s;
+		return true;
+	}
+	return false;
+}
@@ -3,6 +3,12 @@
 #include "RaptureAsset.h"
 #include <cereal/cereal.hpp>
 
+// Bulk payloads (pixels, raw data, level and composition arrays) are allocated through this.
+// The engine overrides it to load them aligned; it must be freed with whatever matches the override.
+#ifndef RASS_PayloadAlloc
+#define RASS_PayloadAlloc(size)	malloc(size)
+#endif
+
 /////////////////////////////////////////////////////////////////////////
 //
 // struct AssetHeader
@@ -37,7 +43,7 @@ void save_(Archive& archive, ComponentData const& m, size_t const& dcs) {
 template<class Archive>
 void load_(Archive& archive, ComponentData& m, size_t const& dcs) {
 	if (dcs > 0) {
-		m.data = (char*)malloc(dcs);
+		m.data = (char*)RASS_PayloadAlloc(dcs);
 	}
 	else {
 		m.data = nullptr;
@@ -82,7 +88,7 @@ void load(Archive& archive, ComponentMaterial& m) {
 		m.head.fps);
 	if (m.head.mapsPresent & (1 << Maptype_Diffuse)) {
 		size_t diffuseSize = sizeof(uint32_t) * m.head.width * m.head.height;
-		m.diffusePixels = (uint32_t*)malloc(diffuseSize);
+		m.diffusePixels = (uint32_t*)RASS_PayloadAlloc(diffuseSize);
 		archive(cereal::binary_data(m.diffusePixels, diffuseSize));
 	}
 	else {
@@ -90,7 +96,7 @@ void load(Archive& archive, ComponentMaterial& m) {
 	}
 	if (m.head.mapsPresent & (1 << Maptype_Normal)) {
 		size_t normalSize = sizeof(uint32_t) * m.head.normalWidth * m.head.normalHeight;
-		m.normalPixels = (uint32_t*)malloc(normalSize);
+		m.normalPixels = (uint32_t*)RASS_PayloadAlloc(normalSize);
 		archive(cereal::binary_data(m.normalPixels, normalSize));
 	}
 	else {
@@ -98,7 +104,7 @@ void load(Archive& archive, ComponentMaterial& m) {
 	}
 	if (m.head.mapsPresent & (1 << Maptype_Depth)) {
 		size_t depthSize = sizeof(uint16_t) * m.head.depthWidth * m.head.depthHeight;
-		m.depthPixels = (uint16_t*)malloc(depthSize);
+		m.depthPixels = (uint16_t*)RASS_PayloadAlloc(depthSize);
 		archive(cereal::binary_data(m.depthPixels, depthSize));
 	}
 	else {
@@ -124,7 +130,7 @@ void load(Archive& archive, ComponentImage& m) {
 	archive(m.head.width, m.head.height);
 	size_t imgSize = sizeof(uint32_t) * m.head.width * m.head.height;
 	if (imgSize > 0) {
-		m.pixels = (uint32_t*)malloc(imgSize);
+		m.pixels = (uint32_t*)RASS_PayloadAlloc(imgSize);
 		archive(cereal::binary_data(m.pixels, imgSize));
 	}
 	else {
@@ -151,7 +157,7 @@ void load_(Archive& archive, ComponentFont& m, size_t const& dcs) {
 	archive(m.head.style, m.head.pointSize, m.head.fontFace);
 	size_t loadSize = dcs - sizeof(ComponentFont::FontHeader);
 	if (loadSize > 0) {
-		m.fontData = (uint8_t*)malloc(loadSize);
+		m.fontData = (uint8_t*)RASS_PayloadAlloc(loadSize);
 		archive(cereal::binary_data(m.fontData, loadSize));
 	}
 	else {
@@ -185,7 +191,7 @@ template<class Archive>
 void load(Archive& archive, ComponentLevel& m) {
 	archive(m.head.width, m.head.height, m.head.numTiles, m.head.numEntities);
 	if (m.head.numTiles > 0) {
-		m.tiles = (ComponentLevel::TileEntry*)malloc(m.head.numTiles * sizeof(ComponentLevel::TileEntry));
+		m.tiles = (ComponentLevel::TileEntry*)RASS_PayloadAlloc(m.head.numTiles * sizeof(ComponentLevel::TileEntry));
 		for (int i = 0; i < m.head.numTiles; i++) {
 			archive(cereal::binary_data(m.tiles[i].name, sizeof(char) * TILE_NAMELEN),
 				m.tiles[i].x, m.tiles[i].y, m.tiles[i].renderType, m.tiles[i].layerOffset);
@@ -195,7 +201,7 @@ void load(Archive& archive, ComponentLevel& m) {
 		m.tiles = nullptr;
 	}
 	if (m.head.numEntities > 0) {
-		m.ents = (ComponentLevel::EntityEntry*)malloc(m.head.numEntities * sizeof(ComponentLevel::EntityEntry));
+		m.ents = (ComponentLevel::EntityEntry*)RASS_PayloadAlloc(m.head.numEntities * sizeof(ComponentLevel::EntityEntry));
 		for (int i = 0; i < m.head.numEntities; i++) {
 			archive(cereal::binary_data(m.ents[i].name, sizeof(char) * ENT_NAMELEN),
 				m.ents[i].x, m.ents[i].y, m.ents[i].spawnflags);
@@ -231,7 +237,7 @@ template<class Archive>
 void load(Archive& archive, ComponentComp& m) {
 	archive(m.head.numComponents, m.head.numKeyframes);
 	if (m.head.numComponents > 0) {
-		m.components = (ComponentComp::CompComponent*)malloc(sizeof(ComponentComp::CompComponent) * m.head.numComponents);
+		m.components = (ComponentComp::CompComponent*)RASS_PayloadAlloc(sizeof(ComponentComp::CompComponent) * m.head.numComponents);
 		for (int i = 0; i < m.head.numComponents; i++) {
 			archive(cereal::binary_data(m.components[i].partName, sizeof(char) * COMPPART_NAMELEN),
 				cereal::binary_data(m.components[i].matName, sizeof(char) * MAT_NAMELEN));
@@ -241,7 +247,7 @@ void load(Archive& archive, ComponentComp& m) {
 		m.components = nullptr;
 	}
 	if (m.head.numKeyframes > 0) {
-		m.keyframes = (ComponentComp::CompKeyframe*)malloc(sizeof(ComponentComp::CompKeyframe) * m.head.numKeyframes);
+		m.keyframes = (ComponentComp::CompKeyframe*)RASS_PayloadAlloc(sizeof(ComponentComp::CompKeyframe) * m.head.numKeyframes);
 		for (int i = 0; i < m.head.numKeyframes; i++) {
 			archive(m.keyframes[i].type, m.keyframes[i].frame, m.keyframes[i].parm);
 		}
@@ -310,7 +316,7 @@ void load(Archive& archive, AssetComponent& m) {
 		m.meta.componentType, m.meta.decompressedSize, m.meta.componentVersion);
 	switch (m.meta.componentType) {
 		case Asset_Undefined:
-			m.data.undefinedComponent = malloc(m.meta.decompressedSize);
+			m.data.undefinedComponent = RASS_PayloadAlloc(m.meta.decompressedSize);
 			archive(cereal::binary_data(m.data.undefinedComponent, m.meta.decompressedSize));
 			break;
 		case Asset_Data:
@@ -6,6 +6,7 @@ AsyncFileTask& AsyncFileTask::operator=(const AsyncFileTask& rhs) {
 	this->dataSize = rhs.dataSize;
 	this->pFile = rhs.pFile;
 	this->type = rhs.type;
+	this->trace = rhs.trace;
 	return *this;
 }
 
@@ -13,5 +14,6 @@ AsyncResourceTask& AsyncResourceTask::operator=(const AsyncResourceTask& rhs) {
 	this->callback = rhs.callback;
 	this->pResource = rhs.pResource;
 	this->type = rhs.type;
+	this->trace = rhs.trace;
 	return *this;
 }
\ No newline at end of file
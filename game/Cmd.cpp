@@ -20,47 +20,46 @@ bool isType<bool>(string& s) {
 
 static bool arch = false;
 
-void Cmd_Set_f(vector<string>& args) {
-	if(args.size() < 3)
-		return;
-
-	if(!Cvar::Exists(args[1]))
+static void Cmd_SetCvar(const CmdArgs& args, bool bArchive) {
+	string sName = args[1].ToString();
+	string sValue = args[2].ToString();
+	Cvar* cv = CvarSystem::FindCvar(sName);
+	if(cv == nullptr)
 	{
-		CvarSystem::CacheCvar(args[1], args[2]);
+		CvarSystem::CacheCvar(sName, sValue, bArchive);
 		return;
 	}
 
-	Cvar::cvarType_e eType = CvarSystem::GetCvarType(args[1]);
-	switch(eType) {
+	switch(cv->GetType()) {
 		default:
 		case Cvar::CV_STRING:
-			CvarSystem::SetStringValue(args[1], (char*)args[2].c_str());
+			CvarSystem::SetStringValue(cv, (char*)sValue.c_str());
 			break;
 		case Cvar::CV_INTEGER:
-			CvarSystem::SetIntegerValue(args[1], atoi(args[2].c_str()));
+			CvarSystem::SetIntegerValue(cv, atoi(sValue.c_str()));
 			break;
 		case Cvar::CV_FLOAT:
-			CvarSystem::SetFloatValue(args[1], (float)atof(args[2].c_str()));
+			CvarSystem::SetFloatValue(cv, (float)atof(sValue.c_str()));
 			break;
 		case Cvar::CV_BOOLEAN:
-			CvarSystem::SetBooleanValue(args[1], atob(args[2].c_str()));
+			CvarSystem::SetBooleanValue(cv, atob(sValue.c_str()));
 			break;
 	}
+	if(bArchive) {
+		CvarSystem::SetCvarFlags(sName, cv->GetFlags() | (1 << CVAR_ARCHIVE));
+	}
 }
 
-void Cmd_Seta_f(vector<string>& args) {
+void Cmd_Set_f(const CmdArgs& args) {
 	if(args.size() < 3)
 		return;
+	Cmd_SetCvar(args, false);
+}
 
-	if(!Cvar::Exists(args[1])) {
-		CvarSystem::CacheCvar(args[1], args[2], true);
+void Cmd_Seta_f(const CmdArgs& args) {
+	if(args.size() < 3)
 		return;
-	}
-
-	Cmd_Set_f(args);
-	int flags = CvarSystem::GetCvarFlags(args[1]);
-	flags = flags | (1 << CVAR_ARCHIVE);
-	CvarSystem::SetCvarFlags(args[1], flags);
+	Cmd_SetCvar(args, true);
 }
 
 void Cmd_Exec_f(vector<string>& args) {
@@ -77,20 +76,25 @@ void Cmd_Exec_f(vector<string>& args) {
 	}
 	R_Message(PRIORITY_MESSAGE, "executing %s\n", args[1].c_str());
 
-	char fileBuffer[32968];
-	File::ReadSync(p, fileBuffer, sizeof(fileBuffer));
+	string text;
+	char chunk[4096];
+	while(File::ReadSync(p, chunk, sizeof(chunk) - 1)) {
+		text += chunk;
+	}
 	File::CloseSync(p);
-	
-	string text = fileBuffer;
+
+	// The contents go into the command buffer in place of this exec, so a large config gets spread over several frames
 	if(text.length() > 0) {
-		vector<string> lines;
-		split(text, ';', lines);
-		if(lines.size() > 0) {
-			for(auto it = lines.begin(); it != lines.end(); ++it) {
-				Cmd::ProcessCommand((*it).c_str());
-			}
-		}
+		Cmd::InsertCommand(text);
+	}
+}
+
+void Cmd_Wait_f(vector<string>& args) {
+	int frames = 1;
+	if(args.size() >= 2) {
+		frames = atoi(args[1].c_str());
 	}
+	Cmd::Wait(frames > 0 ? frames : 1);
 }
 
 void Cmd_Quit_f(vector<string>& args) {
@@ -115,6 +119,55 @@ void Cmd_Zoneinfo_f(vector<string>& args) {
 	Zone::MemoryUsage();
 }
 
+void Cmd_Meminfo_f(vector<string>& args) {
+	Zone::MemoryUsage();
+	MemoryPool::PrintPoolUsage();
+}
+
+void Cmd_ZoneTrack_f(vector<string>& args) {
+	if(args.size() < 2) {
+		R_Message(PRIORITY_MESSAGE, "usage: zonetrack <0/1> (currently %i)\n", Zone::IsTracking() ? 1 : 0);
+		return;
+	}
+	Zone::SetTracking(atob(args[1]));
+}
+
+void Cmd_ZoneTop_f(vector<string>& args) {
+	int numSites = 20;
+	string tag = "";
+	if(args.size() >= 2) {
+		numSites = atoi(args[1].c_str());
+	}
+	if(args.size() >= 3) {
+		tag = args[2];
+	}
+	if(numSites <= 0) {
+		R_Message(PRIORITY_MESSAGE, "usage: zonetop [count] [tag]\n");
+		return;
+	}
+	Zone::TopAllocators(numSites, tag);
+}
+
+void Cmd_ZoneHist_f(vector<string>& args) {
+	Zone::SizeHistogram();
+}
+
+void Cmd_ZoneSnap_f(vector<string>& args) {
+	if(args.size() < 2) {
+		R_Message(PRIORITY_MESSAGE, "usage: zonesnap <name>\n");
+		return;
+	}
+	Zone::Snapshot(args[1]);
+}
+
+void Cmd_ZoneDiff_f(vector<string>& args) {
+	if(args.size() < 2) {
+		R_Message(PRIORITY_MESSAGE, "usage: zonediff <snapshot> [snapshot] (compares against live blocks if only one is given)\n");
+		return;
+	}
+	Zone::SnapshotDiff(args[1], args.size() >= 3 ? args[2] : "");
+}
+
 void Cmd_Screenshot_f(vector<string>& args) {
 	if(args.size() >= 2) {
 		Video::QueueScreenshot(args[1].c_str(), ".bmp");
@@ -142,15 +195,200 @@ void Cmd_ScreenshotPCX_f(vector<string>& args) {
 	}
 }
 
-void Cmd_Echo_f(vector<string>& args) {
+void Cmd_Echo_f(const CmdArgs& args) {
 	string text = "";
-	for(auto it = args.begin()+1; it != args.end(); ++it) {
-		text += *it;
+	for(size_t i = 1; i < args.size(); i++) {
+		text.append(args[i].text, args[i].length);
 		text += " ";
 	}
 	R_Message(PRIORITY_MESSAGE, "%s\n", text.c_str());
 }
 
+// The tokenizer as it was before spans, kept so that tokenbench has something to compare against
+static vector<string> LegacyTokenize(const string &str) {
+	vector<string> retVal;
+	size_t lastSplit = 0;
+	size_t i = 0;
+	for(i = 0; i < str.length(); i++) {
+		char c = str[i];
+		if(c == ' ') {
+			retVal.push_back(str.substr(lastSplit, i-lastSplit));
+			lastSplit = i+1;
+		} else if(c == '\"') {
+			size_t quoteStart = ++i;
+			if(quoteStart >= str.length() || str.find_first_of('\"', quoteStart) == string::npos) {
+				continue;
+			}
+			while(i < str.length() && str[i] != '\"') {
+				i++;
+			}
+			retVal.push_back(str.substr(quoteStart, i-quoteStart));
+			lastSplit = i;
+		}
+	}
+	if(retVal.size() >= 128) {
+		R_Message(PRIORITY_MESSAGE, "Command too large to process.\n");
+		vector<string> returnValue;
+		returnValue.push_back(str);
+		return returnValue;
+	}
+	if(retVal.size() <= 0) {
+		retVal.push_back(str);
+		return retVal;
+	}
+	for(auto it = retVal.begin(); it != retVal.end();) {
+		// Make sure we don't have any entries with pure whitespace
+		if(retVal.size() <= 0) {
+			break;
+		}
+		else if(it->size() <= 0) {
+			it = retVal.erase(it);
+		}
+		else if((*it).find_first_not_of(' ') == string::npos) {
+			it = retVal.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+	retVal.push_back(str.substr(lastSplit));
+	return retVal;
+}
+
+// Compares the span tokenizer against the old string-copying tokenizer, using the statements of a config
+void Cmd_TokenBench_f(vector<string>& args) {
+	if(args.size() < 2) {
+		R_Message(PRIORITY_MESSAGE, "usage: tokenbench <filename.cfg> [iterations]\n");
+		return;
+	}
+	int iterations = args.size() >= 3 ? atoi(args[2].c_str()) : 100;
+	if(iterations <= 0) {
+		iterations = 1;
+	}
+
+	File* p = File::OpenSync(args[1].c_str());
+	if (p == nullptr) {
+		R_Message(PRIORITY_WARNING, "could not open %s\n", args[1].c_str());
+		return;
+	}
+	string text;
+	char chunk[4096];
+	while(File::ReadSync(p, chunk, sizeof(chunk) - 1)) {
+		text += chunk;
+	}
+	File::CloseSync(p);
+
+	vector<string> vStatements;
+	split(text, ';', vStatements);
+	size_t numTokens = 0;
+
+	size_t numOldTokens = 0;
+	uint64_t start = Timer::Nanoseconds();
+	for(int i = 0; i < iterations; i++) {
+		for(auto it = vStatements.begin(); it != vStatements.end(); ++it) {
+			vector<string> vTokens = LegacyTokenize(*it);
+			numOldTokens += vTokens.size();
+		}
+	}
+	uint64_t oldTime = Timer::Nanoseconds() - start;
+
+	start = Timer::Nanoseconds();
+	for(int i = 0; i < iterations; i++) {
+		for(auto it = vStatements.begin(); it != vStatements.end(); ++it) {
+			CmdArgs tokens;
+			Cmd::Tokenize(it->c_str(), tokens);
+			numTokens += tokens.size();
+		}
+	}
+	uint64_t spanTime = Timer::Nanoseconds() - start;
+
+	// the old tokenizer duplicated its last token, so the counts won't match exactly
+	R_Message(PRIORITY_MESSAGE, "%i statements x %i iterations (%i tokens, %i with the old tokenizer)\n", vStatements.size(), iterations, numTokens, numOldTokens);
+	R_Message(PRIORITY_MESSAGE, "old tokenizer: %i us\n", (int)(oldTime / 1000));
+	R_Message(PRIORITY_MESSAGE, "spans:         %i us (%.2fx)\n", (int)(spanTime / 1000), spanTime > 0 ? (double)oldTime / spanTime : 0.0);
+}
+
+void Cmd_Profile_f(vector<string>& args) {
+	if(args.size() < 2) {
+		R_Message(PRIORITY_MESSAGE, "usage: profile <frames> [filename.json] (writes a Chrome trace, open it in chrome://tracing)\n");
+		return;
+	}
+	int numFrames = atoi(args[1].c_str());
+	if(numFrames <= 0) {
+		numFrames = 1;
+	}
+	Profiler::StartCapture(numFrames, args.size() >= 3 ? args[2].c_str() : "profile.json");
+}
+
+void Cmd_Pacing_f(vector<string>& args) {
+	if(args.size() >= 2 && !stricmp(args[1].c_str(), "reset")) {
+		FrameCapper::ResetPacingStats();
+		return;
+	}
+	FrameCapper::PrintPacingStats();
+}
+
+void Cmd_PerfStats_f(vector<string>& args) {
+	if(args.size() >= 2 && !stricmp(args[1].c_str(), "reset")) {
+		PerfStats::Reset();
+		return;
+	}
+	PerfStats::Print();
+}
+
+void Cmd_Metrics_f(vector<string>& args) {
+	if(args.size() >= 2 && !stricmp(args[1].c_str(), "dump")) {
+		Metrics::WriteSnapshot();
+		R_Message(PRIORITY_MESSAGE, "wrote a metrics snapshot to %s\n", METRICS_SNAPSHOT_FILE);
+		return;
+	}
+	Metrics::Print();
+}
+
+void Cmd_ResTrace_f(vector<string>& args) {
+	int seconds = args.size() >= 2 ? atoi(args[1].c_str()) : 10;
+	int numSlowest = args.size() >= 3 ? atoi(args[2].c_str()) : 10;
+	if(seconds <= 0) {
+		R_Message(PRIORITY_MESSAGE, "usage: restrace [seconds] [number of slowest requests to list]\n");
+		return;
+	}
+	ResTrace::Print(seconds, numSlowest > 0 ? numSlowest : 10);
+}
+
+void Cmd_Record_f(vector<string>& args) {
+	if(args.size() < 2) {
+		R_Message(PRIORITY_MESSAGE, "usage: record <demoname>\n");
+		return;
+	}
+	Demo::StartRecording(args[1].c_str());
+}
+
+void Cmd_StopRecord_f(vector<string>& args) {
+	Demo::StopRecording();
+}
+
+void Cmd_Timedemo_f(vector<string>& args) {
+	if(args.size() < 2) {
+		R_Message(PRIORITY_MESSAGE, "usage: timedemo <demoname> (plays the demo back as fast as possible and reports the frame times)\n");
+		return;
+	}
+	Demo::StartTimedemo(args[1].c_str());
+}
+
+void Cmd_Stress_f(vector<string>& args) {
+	if(args.size() >= 2 && !stricmp(args[1].c_str(), "stop")) {
+		Stress::Stop();
+		return;
+	}
+	int count = args.size() >= 3 ? atoi(args[2].c_str()) : 0;
+	int numSteps = args.size() >= 4 ? atoi(args[3].c_str()) : STRESS_DEFAULT_STEPS;
+	if(count <= 0 || numSteps <= 0) {
+		R_Message(PRIORITY_MESSAGE, "usage: stress <sprites|entities|text|clients> <count> [steps], or stress stop\n");
+		return;
+	}
+	Stress::Start(args[1].c_str(), count, numSteps);
+}
+
 void Cmd_VidRestart_f(vector<string>& args) {
 	Video::Restart();
 }
@@ -189,11 +427,28 @@ void Sys_InitCommands() {
 	Cmd::AddCommand("set", Cmd_Set_f);
 	Cmd::AddCommand("seta", Cmd_Seta_f);
 	Cmd::AddCommand("exec", Cmd_Exec_f);
+	Cmd::AddCommand("wait", Cmd_Wait_f);
 	Cmd::AddCommand("quit", Cmd_Quit_f);
 	Cmd::AddCommand("cmdlist", Cmd_Cmdlist_f);
 	Cmd::AddCommand("cvarlist", Cmd_Cvarlist_f);
 	Cmd::AddCommand("zoneinfo", Cmd_Zoneinfo_f);
+	Cmd::AddCommand("meminfo", Cmd_Meminfo_f);
+	Cmd::AddCommand("zonetrack", Cmd_ZoneTrack_f);
+	Cmd::AddCommand("zonetop", Cmd_ZoneTop_f);
+	Cmd::AddCommand("zonehist", Cmd_ZoneHist_f);
+	Cmd::AddCommand("zonesnap", Cmd_ZoneSnap_f);
+	Cmd::AddCommand("zonediff", Cmd_ZoneDiff_f);
 	Cmd::AddCommand("echo", Cmd_Echo_f);
+	Cmd::AddCommand("tokenbench", Cmd_TokenBench_f);
+	Cmd::AddCommand("profile", Cmd_Profile_f);
+	Cmd::AddCommand("pacing", Cmd_Pacing_f);
+	Cmd::AddCommand("perfstats", Cmd_PerfStats_f);
+	Cmd::AddCommand("metrics", Cmd_Metrics_f);
+	Cmd::AddCommand("restrace", Cmd_ResTrace_f);
+	Cmd::AddCommand("record", Cmd_Record_f);
+	Cmd::AddCommand("stoprecord", Cmd_StopRecord_f);
+	Cmd::AddCommand("timedemo", Cmd_Timedemo_f);
+	Cmd::AddCommand("stress", Cmd_Stress_f);
 	Cmd::AddCommand("blockvminput", Cmd_BlockVMInput_f);
 
 	Cmd::AddCommand("vid_restart", Cmd_VidRestart_f);
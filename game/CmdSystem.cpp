@@ -5,7 +5,20 @@
  * Commands are not objects in the Rapture engine.
  */
 namespace Cmd {
-	static unordered_map<string, conCmd_t> cmdlist;
+	// Commands either take the tokens directly or, for older commands and the modcode, a vector of strings
+	struct CmdHandler {
+		conCmd_t legacyHandler;
+		conCmdArgs_t handler;
+	};
+	static unordered_map<string, CmdHandler> cmdlist;
+
+	// Copies the tokens out into strings for commands which still take a vector<string>&
+	static void ArgsToVector(const CmdArgs& args, vector<string>& vArgs) {
+		vArgs.reserve(args.size());
+		for(size_t i = 0; i < args.size(); i++) {
+			vArgs.push_back(args[i].ToString());
+		}
+	}
 
 	// 
 	static string GetFirstCommand(bool& bFoundCommand) {
@@ -48,77 +61,243 @@ namespace Cmd {
 	// Processes something that we've tried to enter in the console.
 	// Also prints a message when the result is not found.
 	void ProcessCommand(const char *cmd) {
-		// in the future, mods will add more to this list
-		vector<string> arguments = Tokenize(cmd);
-		static string sLastTriedToComplete = "";
-		auto it = cmdlist.find(arguments[0]);
+		CmdArgs args;
+		Tokenize(cmd, args);
+		if(args.size() == 0) {
+			return;
+		}
+
+		string sName = args[0].ToString();
+		auto it = cmdlist.find(sName);
 		if(it != cmdlist.end()) {
-			auto command = (*it).second;
-			command(arguments);
+			CmdHandler& command = it->second;
+			if(command.handler != nullptr) {
+				command.handler(args);
+			}
+			else {
+				vector<string> vArgs;
+				ArgsToVector(args, vArgs);
+				command.legacyHandler(vArgs);
+			}
 			return;
 		}
-		else if(CvarSystem::ProcessCvarCommand(arguments[0], arguments)) {
+		else if(CvarSystem::FindCvar(sName) != nullptr) {
+			vector<string> vArgs;
+			ArgsToVector(args, vArgs);
+			CvarSystem::ProcessCvarCommand(sName, vArgs);
 			return;
 		}
-		R_Message(PRIORITY_MESSAGE, "unknown cmd '%s'\n", arguments[0].c_str());
+		R_Message(PRIORITY_MESSAGE, "unknown cmd '%s'\n", sName.c_str());
 	}
 
-	// Adds something to the tab completion vector.
-	// This can be either a cvar or a command.
+	// The command buffer. Text gets appended from anywhere (and any thread), but commands only
+	// ever run on the main thread, once per frame, in ExecuteBuffer.
+	static mutex mCommandBuffer;
+	static deque<string> dCommandBuffer;
+	static int iWaitFrames = 0;
+	static Cvar* com_cmdbudget = nullptr;
+
+	// Splits a block of text into individual commands on ; and newlines (but not inside of quotes)
+	static void SplitCommandText(const string& text, vector<string>& vCommands) {
+		bool bInQuotes = false;
+		size_t start = 0;
+		for(size_t i = 0; i <= text.length(); i++) {
+			char c = i < text.length() ? text[i] : '\0';
+			if(c == '\"') {
+				bInQuotes = !bInQuotes;
+				continue;
+			}
+			if(c != '\0' && (bInQuotes || (c != ';' && c != '\n' && c != '\r'))) {
+				continue;
+			}
+			string command = trim(text.substr(start, i - start), " \t\r\n");
+			if(command.length() > 0) {
+				vCommands.push_back(command);
+			}
+			start = i + 1;
+		}
+	}
+
+	// Adds text to the end of the command buffer. It will get executed during the next frame(s).
+	void AppendCommand(const string& text) {
+		vector<string> vCommands;
+		SplitCommandText(text, vCommands);
+		lock_guard<mutex> lock(mCommandBuffer);
+		dCommandBuffer.insert(dCommandBuffer.end(), vCommands.begin(), vCommands.end());
+	}
+
+	// Adds text to the front of the command buffer, so that it runs before anything else that is waiting.
+	// exec uses this so that a config's contents run in place of the exec command.
+	void InsertCommand(const string& text) {
+		vector<string> vCommands;
+		SplitCommandText(text, vCommands);
+		lock_guard<mutex> lock(mCommandBuffer);
+		dCommandBuffer.insert(dCommandBuffer.begin(), vCommands.begin(), vCommands.end());
+	}
+
+	// Stops executing the buffer for this many frames
+	void Wait(int frames) {
+		iWaitFrames = frames;
+	}
+
+	// Pops the next command off of the buffer. Returns false if the buffer is empty.
+	static bool NextBufferedCommand(string& command) {
+		lock_guard<mutex> lock(mCommandBuffer);
+		if(dCommandBuffer.empty()) {
+			return false;
+		}
+		command = dCommandBuffer.front();
+		dCommandBuffer.pop_front();
+		return true;
+	}
+
+	// Runs buffered commands until the buffer is empty, a wait is hit, or we run out of time for this frame.
+	// Whatever is left over gets run next frame.
+	void ExecuteBuffer() {
+		if(com_cmdbudget == nullptr) {
+			com_cmdbudget = Cvar::Get<int>("com_cmdbudget", "Time per frame that buffered commands may run for, in microseconds (0 = no limit)", (1 << CVAR_ARCHIVE), 2000);
+		}
+		if(iWaitFrames > 0) {
+			iWaitFrames--;
+			return;
+		}
+
+		// steady_clock only ticks once a millisecond on VS2013, which is coarser than the budget itself
+		uint64_t budget = com_cmdbudget->Integer() > 0 ? (uint64_t)com_cmdbudget->Integer() * 1000 : 0;
+		uint64_t start = Timer::Nanoseconds();
+		string command;
+		while(NextBufferedCommand(command)) {
+			ProcessCommand(command.c_str());
+			if(iWaitFrames > 0) {
+				iWaitFrames--;	// this frame counts as the first one
+				break;
+			}
+			if(budget > 0 && Timer::Nanoseconds() - start >= budget) {
+				break;
+			}
+		}
+	}
+
+	// Runs everything in the buffer right now, ignoring the frame budget and waits.
+	// Used during startup where there aren't any frames to spread the work over.
+	void FlushBuffer() {
+		string command;
+		while(NextBufferedCommand(command)) {
+			ProcessCommand(command.c_str());
+		}
+		iWaitFrames = 0;
+	}
+
+	// The tab completion index holds the names of every cvar and command, sorted and without duplicates,
+	// so that everything starting with a given prefix is one contiguous range that we can binary search for.
 	static vector<string> vTabCompletion;
 	void AddTabCompletion(const string& cmdName) {
-		vTabCompletion.push_back(cmdName);
+		auto it = lower_bound(vTabCompletion.begin(), vTabCompletion.end(), cmdName);
+		if(it != vTabCompletion.end() && *it == cmdName) {
+			return;
+		}
+		vTabCompletion.insert(it, cmdName);
+	}
+
+	// Removes something from the tab completion index.
+	void RemoveTabCompletion(const string& cmdName) {
+		auto it = lower_bound(vTabCompletion.begin(), vTabCompletion.end(), cmdName);
+		if(it != vTabCompletion.end() && *it == cmdName) {
+			vTabCompletion.erase(it);
+		}
+	}
+
+	// Finds the range of the tab completion index which starts with a prefix.
+	// The iterators are only good until the next command or cvar gets added or removed.
+	void TabCompletionRange(const string& prefix, tabCompletionIterator& begin, tabCompletionIterator& end) {
+		begin = lower_bound(vTabCompletion.cbegin(), vTabCompletion.cend(), prefix);
+		end = begin;
+		if(prefix.length() == 0) {
+			end = vTabCompletion.cend();
+			return;
+		}
+		// Everything with this prefix sorts before the prefix with its last character bumped up by one.
+		// If the last character can't be bumped, fall back to walking the range.
+		string upper = prefix;
+		unsigned char& last = (unsigned char&)upper[upper.length() - 1];
+		if(last < 0xFF) {
+			last++;
+			end = lower_bound(begin, vTabCompletion.cend(), upper);
+			return;
+		}
+		while(end != vTabCompletion.cend() && !end->compare(0, prefix.length(), prefix)) {
+			++end;
+		}
+	}
+
+	// Removes a command's completion, unless there's a cvar with the same name that still needs it.
+	static void RemoveCommandCompletion(const string& cmdName) {
+		if(CvarSystem::FindCvar(cmdName) == nullptr) {
+			RemoveTabCompletion(cmdName);
+		}
 	}
 
 	// Adds a formally-recognized command to the engine.
 	void AddCommand(const string& cmdName, conCmd_t cmd) {
 		AddTabCompletion(cmdName);
-		cmdlist[cmdName] = cmd;
+		CmdHandler& handler = cmdlist[cmdName];
+		handler.legacyHandler = cmd;
+		handler.handler = nullptr;
 	}
 
 	// Adds a formally-recognized command to the engine.
 	// const char* variant is safe to use across DLL boundaries.
 	void AddCommand(const char* cmdName, conCmd_t cmd) {
+		AddCommand(string(cmdName), cmd);
+	}
+
+	// Adds a command which reads its arguments straight out of the command text.
+	void AddCommand(const char* cmdName, conCmdArgs_t cmd) {
 		string scmd = cmdName;
 		AddTabCompletion(scmd);
-		cmdlist[scmd] = cmd;
+		CmdHandler& handler = cmdlist[scmd];
+		handler.legacyHandler = nullptr;
+		handler.handler = cmd;
 	}
 
 	// Removes a command from the engine.
-	void RemoveCommand(string cmdName) {
-		cmdlist.erase(cmdName);
+	void RemoveCommand(const string& cmdName) {
+		if(cmdlist.erase(cmdName) > 0) {
+			RemoveCommandCompletion(cmdName);
+		}
 	}
 
 	// Removes a command from the engine.
 	// const char* variant is safe to use across DLL boundaries.
 	void RemoveCommand(const char* cmdName) {
-		cmdlist.erase(cmdName);
+		string scmd = cmdName;
+		if(cmdlist.erase(scmd) > 0) {
+			RemoveCommandCompletion(scmd);
+		}
 	}
 
 	// Clears all commands that have been registered.
 	void ClearCommandList() { 
+		for(auto it = cmdlist.begin(); it != cmdlist.end(); ++it) {
+			RemoveCommandCompletion(it->first);
+		}
 		cmdlist.clear(); 
 	}
 
 	// Tab-completes a string based on information 
 	string TabComplete(const string& input) {
-		vector<string> vValid;
-		for(auto it = vTabCompletion.begin(); it != vTabCompletion.end(); ++it) {
-			string& thisOne = *it;
-			if(!thisOne.compare(0, input.size(), input)) {
-				vValid.push_back(thisOne);
-			}
-		}
-		if(vValid.size() == 0) {
+		tabCompletionIterator begin, end;
+		TabCompletionRange(input, begin, end);
+		if(begin == end) {
 			R_Message(PRIORITY_MESSAGE, "No commands found.\n");
 			return input;
 		}
-		else if(vValid.size() == 1) {
-			return vValid.at(0);
+		else if(begin + 1 == end) {
+			return *begin;
 		}
 		R_Message(PRIORITY_MESSAGE, "\n");
-		for(auto it = vValid.begin(); it != vValid.end(); ++it) {
-			R_Message(PRIORITY_MESSAGE, "%s\n", (*it).c_str());
+		for(auto it = begin; it != end; ++it) {
+			R_Message(PRIORITY_MESSAGE, "%s\n", it->c_str());
 		}
 		R_Message(PRIORITY_MESSAGE, "\n");
 		return input;
@@ -129,53 +308,53 @@ namespace Cmd {
 	// cmd.exe herp derp "herp derp"
 	// returns a vector with:
 	// cmd.exe, herp, derp, herp derp
-	inline vector<string> Tokenize(const string &str) {
-		vector<string> retVal;
-		size_t lastSplit = 0;
-		size_t i = 0;
-		for(i = 0; i < str.length(); i++) {
-			char c = str[i];
-			if(c == ' ') {
-				retVal.push_back(str.substr(lastSplit, i-lastSplit));
-				lastSplit = i+1;
-			} else if(c == '\"') {
-				size_t quoteStart = ++i;
-				if(quoteStart >= str.length() || str.find_first_of('\"', quoteStart) == string::npos) {
-					continue;
-				}
-				while(i < str.length() && str[i] != '\"') {
-					i++;
-				}
-				retVal.push_back(str.substr(quoteStart, i-quoteStart));
-				lastSplit = i;
+	// The tokens point into str, so nothing is copied.
+	void Tokenize(const char* str, CmdArgs& args) {
+		args.numTokens = 0;
+		const char* p = str;
+		while(*p) {
+			while(*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+				p++;
 			}
-		}
-		if(retVal.size() >= 128) {
-			R_Message(PRIORITY_MESSAGE, "Command too large to process.\n");
-			vector<string> returnValue;
-			returnValue.push_back(str);
-			return returnValue;
-		}
-		if(retVal.size() <= 0) {
-			retVal.push_back(str);
-			return retVal;
-		}
-		for(auto it = retVal.begin(); it != retVal.end();) {
-			// Make sure we don't have any entries with pure whitespace
-			if(retVal.size() <= 0) {
+			if(*p == '\0') {
 				break;
 			}
-			else if(it->size() <= 0) {
-				it = retVal.erase(it);
+			if(args.numTokens >= MAX_CMD_TOKENS) {
+				R_Message(PRIORITY_MESSAGE, "Command too large to process.\n");
+				args.numTokens = 1;
+				args.tokens[0].text = str;
+				args.tokens[0].length = strlen(str);
+				return;
 			}
-			else if((*it).find_first_not_of(' ') == string::npos) {
-				it = retVal.erase(it);
+
+			CmdToken& token = args.tokens[args.numTokens++];
+			if(*p == '\"') {
+				const char* end = strchr(p + 1, '\"');
+				if(end != nullptr) {
+					token.text = p + 1;
+					token.length = end - token.text;
+					p = end + 1;
+					continue;
+				}
+				// No closing quote, treat the quote as part of a normal token
 			}
-			else {
-				++it;
+			token.text = p;
+			while(*p && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+				p++;
 			}
+			token.length = p - token.text;
+		}
+	}
+
+	// Tokenizes into copies of each argument.
+	vector<string> Tokenize(const string &str) {
+		CmdArgs args;
+		Tokenize(str.c_str(), args);
+		vector<string> retVal;
+		ArgsToVector(args, retVal);
+		if(retVal.size() <= 0) {
+			retVal.push_back(str);
 		}
-		retVal.push_back(str.substr(lastSplit));
 		return retVal;
 	}
 };
\ No newline at end of file
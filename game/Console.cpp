@@ -6,8 +6,17 @@ using namespace Awesomium;
 
 /* REFACTOR ME */
 
+#define CONSOLE_DEFAULT_SCROLLBACK	1024
+
 Console* Console::singleton = nullptr;
-string Console::conLines = "";
+mutex Console::mScrollback;
+vector<string> Console::vScrollback;
+size_t Console::ulScrollbackHead = 0;
+size_t Console::ulScrollbackCount = 0;
+bool Console::bLastLineOpen = false;
+string Console::sPendingText = "";
+size_t Console::ulPendingLines = 0;
+bool Console::bPendingOverflow = false;
 
 void Console::Sizeup(vector<string>& args) {
 	Console* con = Console::GetSingleton();
@@ -51,16 +60,122 @@ void Console::SendConsoleLines(string lines) {
 	window.ToObject().Invoke(WSLit("EXPORT_SendNewLine"), args);
 }
 
+// Adds text to the scrollback ring, one line per entry. The oldest lines get overwritten once it's full.
+// mScrollback needs to be held.
+void Console::AddScrollbackText(const string& text) {
+	if(vScrollback.empty()) {
+		vScrollback.resize(CONSOLE_DEFAULT_SCROLLBACK);
+	}
+	size_t start = 0;
+	while(start < text.length()) {
+		size_t newline = text.find('\n', start);
+		size_t end = newline == string::npos ? text.length() : newline + 1;
+		if(bLastLineOpen && ulScrollbackCount > 0) {
+			vScrollback[(ulScrollbackHead + ulScrollbackCount - 1) % vScrollback.size()].append(text, start, end - start);
+		}
+		else {
+			if(ulScrollbackCount == vScrollback.size()) {
+				// Full, so reuse the oldest line
+				vScrollback[ulScrollbackHead].assign(text, start, end - start);
+				ulScrollbackHead = (ulScrollbackHead + 1) % vScrollback.size();
+			}
+			else {
+				vScrollback[(ulScrollbackHead + ulScrollbackCount) % vScrollback.size()].assign(text, start, end - start);
+				ulScrollbackCount++;
+			}
+		}
+		bLastLineOpen = newline == string::npos;
+		start = end;
+	}
+}
+
+// Puts the whole scrollback back together, oldest line first.
+// mScrollback needs to be held.
+string Console::JoinScrollback() {
+	string text;
+	for(size_t i = 0; i < ulScrollbackCount; i++) {
+		text += vScrollback[(ulScrollbackHead + i) % vScrollback.size()];
+	}
+	return text;
+}
+
+// Changes how many lines the scrollback can hold, keeping the newest ones
+void Console::ResizeScrollback(int lines) {
+	if(lines < 1) {
+		lines = 1;
+	}
+	lock_guard<mutex> lock(mScrollback);
+	vector<string> vLines;
+	size_t keep = ulScrollbackCount < (size_t)lines ? ulScrollbackCount : (size_t)lines;
+	for(size_t i = ulScrollbackCount - keep; i < ulScrollbackCount; i++) {
+		vLines.push_back(vScrollback[(ulScrollbackHead + i) % vScrollback.size()]);
+	}
+	vLines.resize(lines);
+	vScrollback.swap(vLines);
+	ulScrollbackHead = 0;
+	ulScrollbackCount = keep;
+	bPendingOverflow = true;	// make sure the web view matches
+}
+
 void Console::PushConsoleMessage(string message) {
-	conLines += message;
-	printf(message.c_str());
+	printf("%s", message.c_str());
+
+	lock_guard<mutex> lock(mScrollback);
+	AddScrollbackText(message);
 
-	if(SingletonExists())
-		GetSingleton()->SendConsoleLines(message);
+	if(!bPendingOverflow) {
+		sPendingText += message;
+		ulPendingLines += count(message.begin(), message.end(), '\n');
+		if(ulPendingLines >= vScrollback.size()) {
+			// Cheaper to resend the scrollback than to send all of this
+			bPendingOverflow = true;
+			sPendingText.clear();
+			ulPendingLines = 0;
+		}
+	}
+}
+
+// Called once a frame. Sends whatever has been printed since the last frame to the web view in one go.
+void Console::FlushConsoleMessages() {
+	if(!SingletonExists() || !GetSingleton()->IsOpen()) {
+		return;
+	}
+	string text;
+	bool bReplace;
+	{
+		lock_guard<mutex> lock(mScrollback);
+		bReplace = bPendingOverflow;
+		text.swap(sPendingText);
+		ulPendingLines = 0;
+		bPendingOverflow = false;
+	}
+	if(bReplace) {
+		GetSingleton()->ReplaceConsoleContents();
+	}
+	else if(text.length() > 0) {
+		GetSingleton()->SendConsoleLines(text);
+	}
 }
 
 void Console::ReplaceConsoleContents() { // Gets called on opening console
-	SendConsoleLines(conLines);
+	JSArray args;
+	string text;
+	size_t lines;
+	{
+		lock_guard<mutex> lock(mScrollback);
+		text = JoinScrollback();
+		lines = vScrollback.size();
+		sPendingText.clear();
+		ulPendingLines = 0;
+		bPendingOverflow = false;
+	}
+
+	args.Push(JSValue((int)lines));
+	window.ToObject().Invoke(WSLit("EXPORT_SetScrollback"), args);
+
+	args.Clear();
+	args.Push(WSLit(text.c_str()));
+	window.ToObject().Invoke(WSLit("EXPORT_SetDisplayLines"), args);
 }
 
 Console::Console() {
@@ -92,6 +207,10 @@ Console::Console() {
 
 	Cmd::AddCommand("sizeup", Console::Sizeup);
 	Cmd::AddCommand("sizedn", Console::Sizedn);
+
+	Cvar* con_scrollback = Cvar::Get<int>("con_scrollback", "Number of lines that the console keeps", (1 << CVAR_ARCHIVE), CONSOLE_DEFAULT_SCROLLBACK);
+	con_scrollback->AddCallback((void*)Console::ResizeScrollback);
+	ResizeScrollback(con_scrollback->Integer());
 }
 
 Console::~Console() {
@@ -179,7 +298,7 @@ void Console::OnMethodCall(Awesomium::WebView* caller, unsigned int remote_calle
 		itBufferPosition = inputBuffer.end()-1;
 		UpdateInputBufferPosition();
 		PushConsoleMessage("] " + ToString(buffer) + '\n');
-		Cmd::ProcessCommand(ToString(buffer).c_str());
+		Cmd::AppendCommand(ToString(buffer));
 	}
 	else if(method_name == WSLit("inputBufferUp")) {
 		if(itBufferPosition == inputBuffer.begin()) {
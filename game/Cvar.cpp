@@ -17,8 +17,11 @@ Cvar::Cvar(const string& sName, const string& sDesc, int iFlags, char* startValu
   description(sDesc),
   type(Cvar::CV_STRING),
   flags(iFlags),
+  id(CVAR_INVALID_ID),
   ptsChangeCallback(nullptr) {
+	  uStringSequence = 0;
 	  s.AssignBoth(startValue);
+	  Publish();
 }
 
 // Creates a new integer-based cvar.
@@ -27,8 +30,11 @@ name(sName),
 description(sDesc),
 type(Cvar::CV_INTEGER),
 flags(iFlags),
+id(CVAR_INVALID_ID),
 ptiChangeCallback(nullptr) {
+	uStringSequence = 0;
 	i.AssignBoth(startValue);
+	Publish();
 }
 
 // Creates a new floating point cvar.
@@ -37,8 +43,11 @@ name(sName),
 description(sDesc),
 type(Cvar::CV_FLOAT),
 flags(iFlags),
+id(CVAR_INVALID_ID),
 ptfChangeCallback(nullptr) {
+	uStringSequence = 0;
 	v.AssignBoth(startValue);
+	Publish();
 }
 
 // Creates a new boolean-based cvar.
@@ -47,8 +56,11 @@ name(sName),
 description(sDesc),
 type(Cvar::CV_BOOLEAN),
 flags(iFlags),
+id(CVAR_INVALID_ID),
 ptbChangeCallback(nullptr) {
+	uStringSequence = 0;
 	b.AssignBoth(startValue);
+	Publish();
 }
 
 // Creates a blank cvar.
@@ -57,8 +69,11 @@ Cvar::Cvar() :
   name(""),
   description(""),
   type(Cvar::CV_BOOLEAN),
+  id(CVAR_INVALID_ID),
   ptbChangeCallback(nullptr) {
+	uStringSequence = 0;
 	b.AssignBoth(false);
+	Publish();
 }
 
 // Deletes a cvar object.
@@ -70,6 +85,7 @@ Cvar::~Cvar() {
 Cvar& Cvar::operator= (char* str) {
 	if(type != CV_STRING) return *this;
 	strncpy(s.currentVal, str, sizeof(s.currentVal));
+	Publish();
 	return *this;
 }
 
@@ -78,6 +94,7 @@ Cvar& Cvar::operator= (char* str) {
 Cvar& Cvar::operator= (int val) {
 	if(type != CV_INTEGER) return *this;
 	i.currentVal = val;
+	Publish();
 	return *this;
 }
 
@@ -86,6 +103,7 @@ Cvar& Cvar::operator= (int val) {
 Cvar& Cvar::operator= (float val) {
 	if(type != CV_FLOAT) return *this;
 	v.currentVal = val;
+	Publish();
 	return *this;
 }
 
@@ -94,26 +112,20 @@ Cvar& Cvar::operator= (float val) {
 Cvar& Cvar::operator= (bool val) {
 	if(type != CV_BOOLEAN) return *this;
 	b.currentVal = val;
+	Publish();
 	return *this;
 }
 
 // Checks to see if a cvar exists.
 bool Cvar::Exists(const string& sName) {
-	try {
-		auto it = CvarSystem::cvars.find(sName);
-		if(it == CvarSystem::cvars.end())
-			return false;
-		return true;
-	}
-	catch( out_of_range e ) {
-		return false;
-	}
+	return CvarSystem::cvars.find(sName) != CvarSystem::cvars.end();
 }
 
 // Changes the value of a string-based cvar.
 // This also changes the default value of the cvar.
 void Cvar::AssignHardValue(char* value) { 
 	s.AssignBoth(value); 
+	Publish();
 	if(ptsChangeCallback) 
 		ptsChangeCallback(value); 
 }
@@ -122,6 +134,7 @@ void Cvar::AssignHardValue(char* value) {
 // This also changes the default value of the cvar.
 void Cvar::AssignHardValue(int value) {
 	i.AssignBoth(value); 
+	Publish();
 	if(ptiChangeCallback) 
 		ptiChangeCallback(value); 
 }
@@ -130,6 +143,7 @@ void Cvar::AssignHardValue(int value) {
 // This also changes the default value of the cvar.
 void Cvar::AssignHardValue(float value) { 
 	v.AssignBoth(value); 
+	Publish();
 	if(ptfChangeCallback) 
 		ptfChangeCallback(value); 
 }
@@ -138,6 +152,7 @@ void Cvar::AssignHardValue(float value) {
 // This also changes the default value of the cvar.
 void Cvar::AssignHardValue(bool value) {
 	b.AssignBoth(value);
+	Publish();
 	if(ptbChangeCallback)
 		ptbChangeCallback(value); 
 }
@@ -146,6 +161,7 @@ void Cvar::AssignHardValue(bool value) {
 void Cvar::SetValue(char* value) { 
 	if(type != CV_STRING) return; 
 	strncpy(s.currentVal, value, sizeof(s.currentVal)); 
+	Publish();
 	if(flags & (1 << CVAR_ANNOUNCE)) 
 		R_Message(PRIORITY_NOTE, "%s changed to %s\n", name.c_str(), value); 
 	RunCallback();
@@ -155,6 +171,7 @@ void Cvar::SetValue(char* value) {
 void Cvar::SetValue(int value) { 
 	if(type != CV_INTEGER) return; 
 	i.currentVal = value; 
+	Publish();
 	if(flags & (1 << CVAR_ANNOUNCE)) 
 		R_Message(PRIORITY_NOTE, "%s changed to %i\n", name.c_str(), value); 
 	RunCallback();
@@ -164,6 +181,7 @@ void Cvar::SetValue(int value) {
 void Cvar::SetValue(float value) { 
 	if(type != CV_FLOAT) return; 
 	v.currentVal = value; 
+	Publish();
 	if(flags & (1 << CVAR_ANNOUNCE)) 
 		R_Message(PRIORITY_NOTE, "%s changed to %f\n", name.c_str(), value); 
 	RunCallback();
@@ -173,11 +191,62 @@ void Cvar::SetValue(float value) {
 void Cvar::SetValue(bool value) { 
 	if(type != CV_BOOLEAN) return; 
 	b.currentVal = value; 
+	Publish();
 	if(flags & (1 << CVAR_ANNOUNCE)) 
 		R_Message(PRIORITY_NOTE, "%s changed to %s\n", name.c_str(), btoa(value)); 
 	RunCallback();
 }
 
+// Copies the current value into the published slot so that other threads can read it without locking.
+// Also bumps the global generation so that anyone caching cvar values knows to refresh them.
+void Cvar::Publish() {
+	switch(type) {
+		default:
+		case CV_STRING:
+			{
+				uint32_t seq = uStringSequence.load(memory_order_relaxed);
+				uStringSequence.store(seq + 1, memory_order_relaxed);
+				atomic_thread_fence(memory_order_release);
+				strncpy(szPublishedString, s.currentVal, sizeof(szPublishedString));
+				szPublishedString[sizeof(szPublishedString) - 1] = '\0';
+				uStringSequence.store(seq + 2, memory_order_release);
+			}
+			break;
+		case CV_INTEGER:
+			uPublishedBits.store((uint32_t)i.currentVal, memory_order_release);
+			break;
+		case CV_FLOAT:
+			{
+				uint32_t bits;
+				memcpy(&bits, &v.currentVal, sizeof(bits));
+				uPublishedBits.store(bits, memory_order_release);
+			}
+			break;
+		case CV_BOOLEAN:
+			uPublishedBits.store(b.currentVal ? 1 : 0, memory_order_release);
+			break;
+	}
+	CvarSystem::uGeneration.fetch_add(1, memory_order_release);
+}
+
+// Copies the published string value. Retries if the main thread was writing it at the same time.
+void Cvar::AtomicString(char* out, size_t outSize) const {
+	if(outSize == 0) {
+		return;
+	}
+	uint32_t before, after;
+	do {
+		before = uStringSequence.load(memory_order_acquire);
+		if(before & 1) {
+			continue;
+		}
+		strncpy(out, szPublishedString, outSize);
+		atomic_thread_fence(memory_order_acquire);
+		after = uStringSequence.load(memory_order_relaxed);
+	} while((before & 1) || before != after);
+	out[outSize - 1] = '\0';
+}
+
 // Adds a callback function to a cvar.
 // When the value of the cvar changes, the callback function will be called with the new value as parameter.
 void Cvar::AddCallback(void* function) {
@@ -14,10 +14,40 @@ Cvar* CvarSystem::RegisterCvar(Cvar *cvar) {
 	}
 	cvar->registered = true;
 	cvars[cvar->name] = cvar;
+	if(cvar->id == CVAR_INVALID_ID) {
+		cvar->id = (cvarID_t)vCvarSlots.size();
+		vCvarSlots.push_back(cvar);
+		// first one in wins a hash collision, GetCvarID falls back to the string lookup for the other
+		umHashedIDs.insert(make_pair(CvarHashName(cvar->name.c_str()), cvar->id));
+	}
 	Cmd::AddTabCompletion(cvar->name);
 	return cvar;
 }
 
+// Finds a cvar by name. Returns nullptr if no cvar with this name has been created.
+Cvar* CvarSystem::FindCvar(const string& sName) {
+	auto it = cvars.find(sName);
+	if(it == cvars.end()) {
+		return nullptr;
+	}
+	return it->second;
+}
+
+// Returns the slot of a registered cvar, or CVAR_INVALID_ID if it doesn't exist.
+cvarID_t CvarSystem::GetCvarID(const string& sName) {
+	return GetCvarID(CvarHashName(sName.c_str()), sName.c_str());
+}
+
+// Returns the slot of a registered cvar from a precomputed name hash (see CVAR_REF)
+cvarID_t CvarSystem::GetCvarID(uint32_t uHash, const char* sName) {
+	auto it = umHashedIDs.find(uHash);
+	if(it != umHashedIDs.end() && !strcmp(vCvarSlots[it->second]->name.c_str(), sName)) {
+		return it->second;
+	}
+	Cvar* cv = FindCvar(sName);
+	return cv ? cv->id : CVAR_INVALID_ID;
+}
+
 // Registers a Cvar by creating a new Cvar object (a string-based one).
 Cvar* CvarSystem::RegisterCvar(const char* sName, const char* sDesc, int iFlags, char* startValue) {
 	auto it = cvars.find(sName);
@@ -156,6 +186,8 @@ void CvarSystem::Initialize() {
 void CvarSystem::Destroy() {
 	ArchiveCvars();
 	cvars.clear();
+	vCvarSlots.clear();
+	umHashedIDs.clear();
 	init = false;
 }
 
@@ -217,42 +249,38 @@ void CvarSystem::ArchiveCvars() {
 
 // Returns the string value of a Cvar.
 string CvarSystem::GetStringValue(const char* sName) {
-	if(!Cvar::Exists(sName)) { // use cache
-		return ""; // FIXME
-	}
-	else {
-		return Cvar::Get<char*>(sName, "", 0, "")->s.currentVal;
+	Cvar* cv = FindCvar(sName);
+	if(cv == nullptr) {
+		return ""; // FIXME: use cache
 	}
+	return cv->s.currentVal;
 }
 
 // Returns the integer value of a cvar.
 int CvarSystem::GetIntegerValue(const char* sName) {
-	if(!Cvar::Exists(sName)) { // use cache
-		return 0; // FIXME
-	}
-	else {
-		return Cvar::Get<int>(sName, "", 0, 0)->i.currentVal;
+	Cvar* cv = FindCvar(sName);
+	if(cv == nullptr) {
+		return 0; // FIXME: use cache
 	}
+	return cv->i.currentVal;
 }
 
 // Returns the floating point value of a cvar.
 float CvarSystem::GetFloatValue(const char* sName) {
-	if(!Cvar::Exists(sName)) {
-		return 0.0f; // FIXME
-	}
-	else {
-		return Cvar::Get<float>(sName, "", 0, 0.0f)->v.currentVal;
+	Cvar* cv = FindCvar(sName);
+	if(cv == nullptr) {
+		return 0.0f; // FIXME: use cache
 	}
+	return cv->v.currentVal;
 }
 
 // Returns the boolean value of a cvar.
 bool CvarSystem::GetBooleanValue(const char* sName) {
-	if(!Cvar::Exists(sName)) {
-		return false; // FIXME
-	}
-	else {
-		return Cvar::Get<bool>(sName, "", 0, false)->b.currentVal;
+	Cvar* cv = FindCvar(sName);
+	if(cv == nullptr) {
+		return false; // FIXME: use cache
 	}
+	return cv->b.currentVal;
 }
 
 // Retrieves the first registered Cvar.
@@ -475,4 +503,7 @@ float CvarSystem::EXPORT_Value(Cvar* cvar, float* value) {
 bool CvarSystem::init = false;
 unordered_map<string, Cvar*> CvarSystem::cvars;
 unordered_map<string, CvarCacheObject*> CvarSystem::cache;
+vector<Cvar*> CvarSystem::vCvarSlots;
+unordered_map<uint32_t, cvarID_t> CvarSystem::umHashedIDs;
+atomic<unsigned int> CvarSystem::uGeneration(0);
 
@@ -0,0 +1,504 @@
+#include "sys_local.h"
+
+/*
+ * Demos record everything that reaches the client from outside: input as it comes into the InputManager, and packets from
+ * the server as they come into Network::Client::DispatchSinglePacket. Playing one back feeds the same things in on the same
+ * frames, with live input and server packets shut off and the game clock (trap->GetTicks) stepping through the recorded frame times.
+ * That means a demo only plays back correctly from the state that it was recorded in, with the same build and assets,
+ * so record and play them from the commandline (+record name, +timedemo name).
+ *
+ * timedemo plays a demo back as fast as it will go, then reports how long it took.
+ *
+ * File layout:
+ *	char[4]		header ("RDEM")
+ *	uint32_t	version
+ *	...records, each starting with a uint8_t record type
+ *
+ * DEMO_RECORD_FRAME (starts each frame; everything up to the next one happened during it):
+ *	uint32_t	milliseconds since recording started
+ * DEMO_RECORD_KEYDOWN, DEMO_RECORD_KEYUP:
+ *	int32_t		scancode
+ *	int32_t		keycode
+ *	uint16_t	modifiers
+ *	uint8_t		length, char[] text (not null-terminated)
+ * DEMO_RECORD_MOUSEBUTTON:
+ *	uint8_t		button
+ *	uint8_t		state
+ *	int32_t		x, y
+ * DEMO_RECORD_MOUSEMOVE:
+ *	int32_t		x, y
+ * DEMO_RECORD_TEXTINPUT:
+ *	uint8_t		length, char[] text (not null-terminated)
+ * DEMO_RECORD_PACKET:
+ *	uint32_t	type
+ *	uint64_t	send time
+ *	uint32_t	size, char[] data
+ * DEMO_RECORD_END
+ */
+
+namespace Demo {
+	enum demoState_e {
+		DEMO_IDLE,
+		DEMO_RECORDSTART,	// recording starts with the next frame
+		DEMO_RECORDING,
+		DEMO_PLAYSTART,		// playback starts with the next frame
+		DEMO_PLAYING,
+	};
+
+	struct demoInput_t {
+		uint8_t type;
+		SDL_Keysym key;
+		char text[DEMO_TEXT_SIZE];
+		uint8_t button;
+		uint8_t state;
+		int32_t x, y;
+	};
+
+	static demoState_e state = DEMO_IDLE;
+	static File* pDemoFile = nullptr;
+	static string sDemoFile;
+	static unsigned int uNumFrames = 0;
+
+	static Uint32 uBaseTicks = 0;		// real clock when recording or playback started
+	static Uint32 uFrameTicks = 0;		// game clock for the current frame
+	static uint64_t ulFrameStart = 0;
+
+	// Records are put together here and written out in one go
+	static unsigned char recordBuffer[32 + MAX_PACKET_DATASIZE];
+	static size_t recordLength = 0;
+
+	// Playback reads in everything for a frame when it starts
+	static vector<demoInput_t> vFrameInputs;
+	static vector<Packet> vFramePackets;
+	static uint32_t uNextFrameTime = 0;
+	static bool bLastFrame = false;
+
+	// Timedemo results, in milliseconds
+	static uint64_t ulPlaybackStart = 0;
+	static vector<float> vFrameTimes;
+	static vector<float> vPhaseTimes[PERF_MAX];
+
+	bool IsRecording() {
+		return state == DEMO_RECORDSTART || state == DEMO_RECORDING;
+	}
+
+	bool IsPlaying() {
+		return state == DEMO_PLAYSTART || state == DEMO_PLAYING;
+	}
+
+	// The game clock. While a demo is recorded or played it stays put for the whole frame, so that playback sees the same times.
+	Uint32 Ticks() {
+		if (state != DEMO_RECORDING && state != DEMO_PLAYING) {
+			return SDL_GetTicks();
+		}
+		uint64_t ulStalled = (Timer::Nanoseconds() - ulFrameStart) / 1000000;
+		if (ulStalled > DEMO_STALL_MS) {
+			return uFrameTicks + (Uint32)ulStalled;
+		}
+		return uFrameTicks;
+	}
+
+	static void CloseDemo() {
+		if (pDemoFile != nullptr) {
+			File::CloseSync(pDemoFile);
+			pDemoFile = nullptr;
+		}
+		vFrameInputs.clear();
+		vFramePackets.clear();
+		state = DEMO_IDLE;
+	}
+
+	/*
+		Recording
+	*/
+
+	static void BeginRecord(demoRecord_e type) {
+		recordLength = 0;
+		recordBuffer[recordLength++] = (unsigned char)type;
+	}
+
+	static void Append(const void* data, size_t size) {
+		memcpy(recordBuffer + recordLength, data, size);
+		recordLength += size;
+	}
+
+	static void AppendText(const char* text) {
+		uint8_t length = text != nullptr ? (uint8_t)strnlen(text, DEMO_TEXT_SIZE - 1) : 0;
+		Append(&length, sizeof(length));
+		Append(text, length);
+	}
+
+	static void EndRecord() {
+		if (!File::WriteSync(pDemoFile, recordBuffer, recordLength)) {
+			R_Message(PRIORITY_WARNING, "could not write to %s, recording stopped\n", sDemoFile.c_str());
+			CloseDemo();
+		}
+	}
+
+	void StartRecording(const char* name) {
+		if (state != DEMO_IDLE) {
+			R_Message(PRIORITY_WARNING, "a demo is already being %s\n", IsRecording() ? "recorded" : "played");
+			return;
+		}
+		sDemoFile = name;
+		sDemoFile += DEMO_EXTENSION;
+		pDemoFile = File::OpenSync(sDemoFile.c_str(), "wb");
+		if (pDemoFile == nullptr) {
+			R_Message(PRIORITY_WARNING, "could not open %s for writing\n", sDemoFile.c_str());
+			return;
+		}
+		uint32_t version = DEMO_VERSION;
+		File::WriteSync(pDemoFile, (void*)DEMO_HEADER, 4);
+		File::WriteSync(pDemoFile, &version, sizeof(version));
+		uNumFrames = 0;
+		state = DEMO_RECORDSTART;
+		R_Message(PRIORITY_MESSAGE, "recording to %s\n", sDemoFile.c_str());
+	}
+
+	void StopRecording() {
+		if (!IsRecording()) {
+			R_Message(PRIORITY_WARNING, "not recording a demo\n");
+			return;
+		}
+		BeginRecord(DEMO_RECORD_END);
+		EndRecord();
+		R_Message(PRIORITY_MESSAGE, "stopped recording %s (%u frames)\n", sDemoFile.c_str(), uNumFrames);
+		CloseDemo();
+	}
+
+	void RecordKey(SDL_Keysym key, char* text, bool bDown) {
+		if (state != DEMO_RECORDING) {
+			return;
+		}
+		int32_t scancode = key.scancode;
+		int32_t sym = key.sym;
+		uint16_t mod = key.mod;
+		BeginRecord(bDown ? DEMO_RECORD_KEYDOWN : DEMO_RECORD_KEYUP);
+		Append(&scancode, sizeof(scancode));
+		Append(&sym, sizeof(sym));
+		Append(&mod, sizeof(mod));
+		AppendText(text);
+		EndRecord();
+	}
+
+	void RecordMouseButton(unsigned int buttonId, unsigned char buttonState, int x, int y) {
+		if (state != DEMO_RECORDING) {
+			return;
+		}
+		uint8_t button = (uint8_t)buttonId;
+		int32_t pos[2] = { x, y };
+		BeginRecord(DEMO_RECORD_MOUSEBUTTON);
+		Append(&button, sizeof(button));
+		Append(&buttonState, sizeof(buttonState));
+		Append(pos, sizeof(pos));
+		EndRecord();
+	}
+
+	void RecordMouseMove(int x, int y) {
+		if (state != DEMO_RECORDING) {
+			return;
+		}
+		int32_t pos[2] = { x, y };
+		BeginRecord(DEMO_RECORD_MOUSEMOVE);
+		Append(pos, sizeof(pos));
+		EndRecord();
+	}
+
+	void RecordTextInput(char* text) {
+		if (state != DEMO_RECORDING) {
+			return;
+		}
+		BeginRecord(DEMO_RECORD_TEXTINPUT);
+		AppendText(text);
+		EndRecord();
+	}
+
+	void RecordPacket(Packet& packet) {
+		if (state != DEMO_RECORDING) {
+			return;
+		}
+		uint32_t type = packet.packetHead.type;
+		uint64_t sendTime = packet.packetHead.sendTime;
+		uint32_t size = packet.packetHead.packetSize < MAX_PACKET_DATASIZE ? (uint32_t)packet.packetHead.packetSize : MAX_PACKET_DATASIZE;
+		BeginRecord(DEMO_RECORD_PACKET);
+		Append(&type, sizeof(type));
+		Append(&sendTime, sizeof(sendTime));
+		Append(&size, sizeof(size));
+		Append(packet.packetData, size);
+		EndRecord();
+	}
+
+	/*
+		Playback
+	*/
+
+	static bool Read(void* data, size_t size) {
+		return size == 0 || File::ReadSync(pDemoFile, data, size);
+	}
+
+	static bool ReadText(char* text) {
+		uint8_t length;
+		memset(text, 0, DEMO_TEXT_SIZE);
+		if (!Read(&length, sizeof(length)) || length >= DEMO_TEXT_SIZE) {
+			return false;
+		}
+		return Read(text, length);
+	}
+
+	static bool ReadInput(uint8_t type) {
+		demoInput_t input;
+		memset(&input, 0, sizeof(input));
+		input.type = type;
+		int32_t pos[2] = { 0, 0 };
+		switch (type) {
+			case DEMO_RECORD_KEYDOWN:
+			case DEMO_RECORD_KEYUP:
+				{
+					int32_t scancode, sym;
+					uint16_t mod;
+					if (!Read(&scancode, sizeof(scancode)) || !Read(&sym, sizeof(sym)) || !Read(&mod, sizeof(mod)) || !ReadText(input.text)) {
+						return false;
+					}
+					input.key.scancode = (SDL_Scancode)scancode;
+					input.key.sym = (SDL_Keycode)sym;
+					input.key.mod = mod;
+				}
+				break;
+			case DEMO_RECORD_MOUSEBUTTON:
+				if (!Read(&input.button, sizeof(input.button)) || !Read(&input.state, sizeof(input.state)) || !Read(pos, sizeof(pos))) {
+					return false;
+				}
+				break;
+			case DEMO_RECORD_MOUSEMOVE:
+				if (!Read(pos, sizeof(pos))) {
+					return false;
+				}
+				break;
+			case DEMO_RECORD_TEXTINPUT:
+				if (!ReadText(input.text)) {
+					return false;
+				}
+				break;
+		}
+		input.x = pos[0];
+		input.y = pos[1];
+		vFrameInputs.push_back(input);
+		return true;
+	}
+
+	static bool ReadPacket() {
+		uint32_t type, size;
+		uint64_t sendTime;
+		if (!Read(&type, sizeof(type)) || !Read(&sendTime, sizeof(sendTime)) || !Read(&size, sizeof(size)) || size > MAX_PACKET_DATASIZE) {
+			return false;
+		}
+		vFramePackets.push_back(Packet());
+		Packet& packet = vFramePackets.back();
+		packet.packetHead.type = type;
+		packet.packetHead.sendTime = sendTime;
+		packet.packetHead.packetSize = size;
+		if (!Read(packet.packetData, size)) {
+			vFramePackets.pop_back();
+			return false;
+		}
+		return true;
+	}
+
+	// Reads in the rest of the current frame, up to and including the next frame record
+	static void ReadFrame() {
+		vFrameInputs.clear();
+		vFramePackets.clear();
+		uint8_t type;
+		while (Read(&type, sizeof(type))) {
+			bool bOk = true;
+			switch (type) {
+				case DEMO_RECORD_FRAME:
+					if (Read(&uNextFrameTime, sizeof(uNextFrameTime))) {
+						return;
+					}
+					bOk = false;
+					break;
+				case DEMO_RECORD_KEYDOWN:
+				case DEMO_RECORD_KEYUP:
+				case DEMO_RECORD_MOUSEBUTTON:
+				case DEMO_RECORD_MOUSEMOVE:
+				case DEMO_RECORD_TEXTINPUT:
+					bOk = ReadInput(type);
+					break;
+				case DEMO_RECORD_PACKET:
+					bOk = ReadPacket();
+					break;
+				case DEMO_RECORD_END:
+					bLastFrame = true;
+					return;
+				default:
+					bOk = false;
+					break;
+			}
+			if (!bOk) {
+				R_Message(PRIORITY_WARNING, "%s is corrupt (record type %u), stopping there\n", sDemoFile.c_str(), type);
+				break;
+			}
+		}
+		bLastFrame = true;
+	}
+
+	void StartTimedemo(const char* name) {
+		if (state != DEMO_IDLE) {
+			R_Message(PRIORITY_WARNING, "a demo is already being %s\n", IsRecording() ? "recorded" : "played");
+			return;
+		}
+		sDemoFile = name;
+		sDemoFile += DEMO_EXTENSION;
+		pDemoFile = File::OpenSync(sDemoFile.c_str(), "rb");
+		if (pDemoFile == nullptr) {
+			R_Message(PRIORITY_WARNING, "could not open %s\n", sDemoFile.c_str());
+			return;
+		}
+
+		char header[4];
+		uint32_t version;
+		uint8_t type;
+		if (!Read(header, sizeof(header)) || strncmp(header, DEMO_HEADER, 4) || !Read(&version, sizeof(version))) {
+			R_Message(PRIORITY_WARNING, "%s is not a demo\n", sDemoFile.c_str());
+			CloseDemo();
+			return;
+		}
+		if (version != DEMO_VERSION) {
+			R_Message(PRIORITY_WARNING, "%s is version %u, expected version %u\n", sDemoFile.c_str(), version, DEMO_VERSION);
+			CloseDemo();
+			return;
+		}
+		if (!Read(&type, sizeof(type)) || type != DEMO_RECORD_FRAME || !Read(&uNextFrameTime, sizeof(uNextFrameTime))) {
+			R_Message(PRIORITY_WARNING, "%s has no frames\n", sDemoFile.c_str());
+			CloseDemo();
+			return;
+		}
+
+		uNumFrames = 0;
+		bLastFrame = false;
+		vFrameTimes.clear();
+		for (int i = 0; i < PERF_MAX; i++) {
+			vPhaseTimes[i].clear();
+		}
+		state = DEMO_PLAYSTART;
+		R_Message(PRIORITY_MESSAGE, "playing %s...\n", sDemoFile.c_str());
+	}
+
+	static void PrintTimedemo() {
+		double dSeconds = (Timer::Nanoseconds() - ulPlaybackStart) / 1000000000.0;
+		R_Message(PRIORITY_MESSAGE, "\n%s: %u frames in %.3f seconds (%.1f fps)\n", sDemoFile.c_str(), uNumFrames, dSeconds,
+			dSeconds > 0.0 ? uNumFrames / dSeconds : 0.0);
+		if (vFrameTimes.empty()) {
+			return;
+		}
+
+		frameStats_t stats;
+		R_Message(PRIORITY_MESSAGE, "%-20s %8s %8s %8s %8s %8s %10s\n", "Phase (ms)", "Avg", "p50", "p95", "p99", "Max", "Total (s)");
+		R_Message(PRIORITY_MESSAGE, "%-20s %8s %8s %8s %8s %8s %10s\n", "----------", "---", "---", "---", "---", "---", "---------");
+		PerfStats::SummarizeSamples(&vFrameTimes[0], vFrameTimes.size(), stats);
+		R_Message(PRIORITY_MESSAGE, "%-20s %8.3f %8.3f %8.3f %8.3f %8.3f %10.3f\n", "Frame", stats.fAverage, stats.fP50, stats.fP95, stats.fP99, stats.fMax,
+			stats.fAverage * stats.numFrames / 1000.0f);
+		for (int i = 0; i < PERF_MAX; i++) {
+			PerfStats::SummarizeSamples(&vPhaseTimes[i][0], vPhaseTimes[i].size(), stats);
+			R_Message(PRIORITY_MESSAGE, "%-20s %8.3f %8.3f %8.3f %8.3f %8.3f %10.3f\n", PerfStats::PhaseName((perfPhase_e)i),
+				stats.fAverage, stats.fP50, stats.fP95, stats.fP99, stats.fMax, stats.fAverage * stats.numFrames / 1000.0f);
+		}
+	}
+
+	/*
+		Every frame
+	*/
+
+	// Called by the main thread at the start of every frame, right after PerfStats::FrameBoundary
+	void Frame() {
+		switch (state) {
+			case DEMO_RECORDSTART:
+				uBaseTicks = SDL_GetTicks();
+				state = DEMO_RECORDING;
+				// fall through
+			case DEMO_RECORDING:
+				{
+					ulFrameStart = Timer::Nanoseconds();
+					uFrameTicks = SDL_GetTicks();
+					uint32_t uTime = uFrameTicks - uBaseTicks;
+					BeginRecord(DEMO_RECORD_FRAME);
+					Append(&uTime, sizeof(uTime));
+					EndRecord();
+					uNumFrames++;
+				}
+				break;
+			case DEMO_PLAYSTART:
+				uBaseTicks = SDL_GetTicks();
+				ulPlaybackStart = Timer::Nanoseconds();
+				state = DEMO_PLAYING;
+				// fall through
+			case DEMO_PLAYING:
+				{
+					// PerfStats has just finished timing the last frame that we played
+					float fFrameTime, fPhases[PERF_MAX];
+					if (uNumFrames > 0 && PerfStats::GetLastFrame(&fFrameTime, fPhases)) {
+						vFrameTimes.push_back(fFrameTime);
+						for (int i = 0; i < PERF_MAX; i++) {
+							vPhaseTimes[i].push_back(fPhases[i]);
+						}
+					}
+					if (bLastFrame) {
+						PrintTimedemo();
+						CloseDemo();
+						return;
+					}
+					ulFrameStart = Timer::Nanoseconds();
+					uFrameTicks = uBaseTicks + uNextFrameTime;
+					ReadFrame();
+					uNumFrames++;
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	// Called from InputManager::InputFrame in place of the live events, which are being dropped
+	void ReplayInput() {
+		if (state != DEMO_PLAYING) {
+			return;
+		}
+		for (auto it = vFrameInputs.begin(); it != vFrameInputs.end(); ++it) {
+			switch (it->type) {
+				case DEMO_RECORD_KEYDOWN:
+					Input->SendKeyDownEvent(it->key, it->text);
+					break;
+				case DEMO_RECORD_KEYUP:
+					Input->SendKeyUpEvent(it->key, it->text);
+					break;
+				case DEMO_RECORD_MOUSEBUTTON:
+					Input->SendMouseButtonEvent(it->button, it->state, it->x, it->y);
+					break;
+				case DEMO_RECORD_MOUSEMOVE:
+					Input->SendMouseMoveEvent(it->x, it->y);
+					break;
+				case DEMO_RECORD_TEXTINPUT:
+					Input->SendTextInputEvent(it->text);
+					break;
+			}
+		}
+	}
+
+	// Called at the start of Network::Client::Frame, before the client gamecode runs
+	void ReplayPackets() {
+		if (state != DEMO_PLAYING) {
+			return;
+		}
+		for (auto it = vFramePackets.begin(); it != vFramePackets.end(); ++it) {
+			Network::Client::DeliverPacket(*it);
+		}
+	}
+
+	void Shutdown() {
+		if (IsRecording()) {
+			StopRecording();
+		}
+		CloseDemo();
+	}
+}
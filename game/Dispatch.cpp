@@ -8,6 +8,8 @@
  * 1. Any messages with priority which matches the Hidden bitmask are never logged nor acted upon.
  * 2. Any messages with priority which matches the Shutdown bitmask will cause the engine to shut down.
  * 3. Any messages with priority that matches the Message bitmask will cause a console message to appear.
+ * With com_binarylog, the logfile stores the format string and raw arguments of each message instead (see BinaryLog.h),
+ * which is cheap enough that hidden messages get logged too. Use the logdecode tool to turn it back into text.
  */
 
 Dispatch* ptDispatch = nullptr;
@@ -19,16 +21,20 @@ iHiddenMask(_iHiddenMask),
 iShutdownMask(_iShutdownMask),
 iMessageMask(_iMessageMask),
 ptLogFile(nullptr),
+ptLogWriter(nullptr),
+bBinaryLog(false),
+iBinaryLogs(0),
 bSetup(false){
+	szLogName[0] = '\0';
 }
 
 // Destroys the dispatch system.
 Dispatch::~Dispatch() {
-	if (!ptLogFile) {
-		return;
+	CatchError();
+	for(auto it = vRetiredWriters.begin(); it != vRetiredWriters.end(); ++it) {
+		delete *it;
 	}
-	File::CloseSync(ptLogFile);
-	ptLogFile = nullptr;
+	vRetiredWriters.clear();
 }
 
 // Since some messages may have been sent (but not properly dealt with), we should probably deal with those now.
@@ -49,94 +55,92 @@ void Dispatch::Setup() {
 	com_dispatchShutdownMask->AddCallback((void*)Dispatch::ChangeShutdownMask);
 	com_dispatchMessageMask->AddCallback((void*)Dispatch::ChangeMessageMask);
 
-	char fileName[MAX_HANDLE_STRING*2] = { 0 };
 	time_t theTime = time(nullptr);
+	strftime(szLogName, sizeof(szLogName), "logs/rapturelog_%Y-%m-%d_%H-%M-%S", localtime(&theTime));
 
-	strftime(fileName, sizeof(fileName), "logs/rapturelog_%Y-%m-%d_%H-%M-%S.log", localtime(&theTime));
-	ptLogFile = File::OpenSync(fileName, "wb+");
+	// The config gets executed after this, so if it turns on binary logging we switch over to a binary file then
+	OpenLog(false);
 	if(!ptLogFile) {
 		return;
 	}
 	bSetup = true;
 
+	Cvar* com_binarylog = Cvar::Get<bool>("com_binarylog", "Write a binary log (including hidden messages), decode it with logdecode", (1 << CVAR_ARCHIVE), false);
+	com_binarylog->AddCallback((void*)Dispatch::ChangeBinaryLog);
+
 	for(auto it = vPreSetupMessages.begin(); it != vPreSetupMessages.end(); ++it) {
 		PrintMessage(it->first, it->second.c_str());
 	}
 }
 
+// Opens the logfile (closing any that we already had open)
+// Switching back to text appends to the session's text log. Binary logs can't be appended to, so each one gets a new file.
+void Dispatch::OpenLog(bool bBinary) {
+	char fileName[MAX_HANDLE_STRING*2+16] = { 0 };
+	if(!bBinary) {
+		sprintf(fileName, "%s.log", szLogName);
+	}
+	else if(iBinaryLogs++ == 0) {
+		sprintf(fileName, "%s.rblg", szLogName);
+	}
+	else {
+		sprintf(fileName, "%s_%i.rblg", szLogName, iBinaryLogs);
+	}
+	File* ptNewFile = File::OpenSync(fileName, bBinary ? "wb+" : "ab");
+	LogWriter* ptNewWriter = ptNewFile != nullptr ? new LogWriter(ptNewFile, bBinary) : nullptr;
+
+	// Publish the new writer before retiring the old one, so other threads never see a stopped writer
+	bBinaryLog.store(ptNewWriter != nullptr && bBinary, memory_order_release);
+	LogWriter* ptOldWriter = ptLogWriter.exchange(ptNewWriter, memory_order_acq_rel);
+	if(ptOldWriter != nullptr) {
+		ptOldWriter->Stop();
+		vRetiredWriters.push_back(ptOldWriter);
+	}
+	if(ptLogFile != nullptr) {
+		File::CloseSync(ptLogFile);
+	}
+	ptLogFile = ptNewFile;
+}
+
 // This (dumbly-named) function closes the logfile.
+// Anything still waiting to be written gets written first.
 void Dispatch::CatchError() {
-	File::CloseSync(ptLogFile);
-	ptLogFile = nullptr;
+	LogWriter* ptWriter = ptLogWriter.exchange(nullptr, memory_order_acq_rel);
+	if(ptWriter != nullptr) {
+		delete ptWriter;
+	}
+	if(ptLogFile != nullptr) {
+		File::CloseSync(ptLogFile);
+		ptLogFile = nullptr;
+	}
 }
 
 // This (dumbly-named) function dispatches a message with specified priority.
 void Dispatch::PrintMessage(const int iPriority, const char* message) {
-	static bool bLastHadNewline = true;
-	bool bThisHasNewline = false;
 	if(!bSetup) {
 		vPreSetupMessages.push_back(make_pair(iPriority, message));
 	}
 
-	if(iPriority < 0 && iPriority >= PRIORITY_MAX) {
+	if(iPriority < 0 || iPriority >= PRIORITY_MAX) {
 		return;
 	}
 
-	if(iHiddenMask & (1 << iPriority) && iPriority != PRIORITY_ERRFATAL) {
+	if(IsHidden(iPriority)) {
 		// Fatal errors are NEVER hidden
 		return;
 	}
 
-	if(ptLogFile != nullptr) {
-		stringstream input;
-		string in = message;
-#ifdef WIN32
-		size_t pos = 0;
-		while((pos = in.find('\n', pos)) != string::npos) {
-			in.replace(pos, 1, "\r\n");
-			pos += 2;
-			bThisHasNewline = true;
+	LogWriter* ptWriter = ptLogWriter.load(memory_order_acquire);
+	if(ptWriter != nullptr) {
+		// The writer thread timestamps and writes this out for us
+		// (binary logs have already been sent the message by PrintBinary)
+		if(!ptWriter->IsBinary()) {
+			ptWriter->Push(iPriority, message);
 		}
-#endif
-
-		if(bLastHadNewline) {
-			// Insert the time
-			auto ticks = SDL_GetTicks();
-			input << setfill('0') << setw(2) << floor(ticks / 3600000) << ":"; // Hours
-			input << setfill('0') << setw(2) << floor(ticks / 60000) << ":"; // Minutes
-			input << setfill('0') << setw(2) << floor(ticks / 1000) << " "; // Seconds
-
-			// Insert the message type
-			switch(iPriority) {
-				default:
-				case PRIORITY_NOTE:
-					input << "[NOTE]\t\t";
-					break;
-				case PRIORITY_DEBUG:
-					input << "[DEBUG]\t\t";
-					break;
-				case PRIORITY_MESSAGE:
-					input << "[MESSAGE]\t";
-					break;
-				case PRIORITY_WARNING:
-					input << "[WARNING]\t";
-					break;
-				case PRIORITY_ERROR:
-					input << "[ERROR]\t";
-					break;
-				case PRIORITY_ERRFATAL:
-					input << "[FATAL]\t\t";
-					break;
-			}
+		if(iPriority == PRIORITY_ERRFATAL) {
+			// Make sure the log has everything that led up to this before we go down
+			ptWriter->Flush();
 		}
-
-		// Lastly, insert the message itself
-		input << in;
-
-		// Now write to log
-		bLastHadNewline = bThisHasNewline;
-
-		File::WriteSync(ptLogFile, (void*)input.str().c_str(), input.str().length());
 	} else {
 		printf(message);
 	}
@@ -175,6 +179,23 @@ void Dispatch::PrintMessage(const int iPriority, const char* message) {
 	}
 }
 
+// Sends a message to the binary log, without formatting it.
+void Dispatch::PrintBinary(const int iPriority, const char* fmt, va_list args) {
+	LogWriter* ptWriter = ptLogWriter.load(memory_order_acquire);
+	if(ptWriter == nullptr || !ptWriter->IsBinary()) {
+		return;
+	}
+	ptWriter->PushBinary(iPriority, fmt, args);
+}
+
+// Switches between a text and binary logfile
+void Dispatch::ChangeBinaryLog(bool newValue) {
+	if(!ptDispatch || !ptDispatch->bSetup || ptDispatch->bBinaryLog == newValue) {
+		return;
+	}
+	ptDispatch->OpenLog(newValue);
+}
+
 // Changes the hidden bitmask
 void Dispatch::ChangeHiddenMask(int newValue) {
 	if(!ptDispatch) {
@@ -205,6 +226,21 @@ void R_Message(int iPriority, const char *fmt, ...) {
 	va_list args;
 	char str[1024];
 
+	if(iPriority < 0 || iPriority >= PRIORITY_MAX) {
+		return;
+	}
+
+	if(ptDispatch->IsBinaryLogging()) {
+		va_start(args, fmt);
+		ptDispatch->PrintBinary(iPriority, fmt, args);
+		va_end(args);
+	}
+
+	// Don't bother formatting something that nobody is going to see
+	if(ptDispatch->IsHidden(iPriority)) {
+		return;
+	}
+
 	va_start(args, fmt);
 	vsnprintf(str, 1024, fmt, args);
 	va_end(args);
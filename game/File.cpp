@@ -1,5 +1,16 @@
 #include "sys_local.h"
 
+// Leaked on purpose, see MemoryPool::Free
+static ObjectPool<File>& filePool = *new ObjectPool<File>("File", 32);
+
+void* File::operator new(size_t size) {
+	return filePool.AllocateObject(size);
+}
+
+void File::operator delete(void* ptr) {
+	filePool.Free(ptr);
+}
+
 File::File() {
 	flags = 0;
 	path = "";
@@ -110,6 +121,9 @@ bool File::ReadSync(File* pFile, void* data, size_t dataSize) {
 		pFile->flags |= File_Bad;
 		return false;
 	}
+	if (Filesystem::pMetricBytesRead) {
+		Filesystem::pMetricBytesRead->Add(read);
+	}
 	pFile->flags |= File_Read;
 	return true;
 }
@@ -123,6 +137,9 @@ bool File::WriteSync(File* pFile, void* data, size_t dataSize) {
 		pFile->flags |= File_Bad;
 		return false;
 	}
+	if (Filesystem::pMetricBytesWritten) {
+		Filesystem::pMetricBytesWritten->Add(written);
+	}
 	pFile->flags |= File_Written;
 	return true;
 }
@@ -143,8 +160,11 @@ bool File::CloseSync(File* pFile) {
 Gets run whenever the filesystem deques an open command on this file.
 The callback is run after the open command has successfully completed.
 */
-void File::DequeOpen(fileOpenedCallback callback) {
+void File::DequeOpen(fileOpenedCallback callback, requestTrace_t* pTrace) {
 	this->fp = fopen(this->path.c_str(), this->mode.c_str());
+	if (pTrace) {
+		pTrace->Stamp(TRACE_IODONE);
+	}
 	if (this->fp == nullptr) {
 		this->flags |= File_Bad;
 		return;	// Don't run the callback if we failed
@@ -159,17 +179,23 @@ void File::DequeOpen(fileOpenedCallback callback) {
 Gets run whenever the filesystem deques a read command on this file.
 The callback is run after the read command has completed successfully.
 */
-void File::DequeRead(void* data, size_t dataSize, fileReadCallback callback) {
+void File::DequeRead(void* data, size_t dataSize, fileReadCallback callback, requestTrace_t* pTrace) {
 	if (this->fp == nullptr) {
 		this->flags |= File_Bad;
 		return;
 	}
 	memset(data, 0, dataSize);	// Null-terminate it by default
 	size_t read = fread(data, 1, dataSize, this->fp);
+	if (pTrace) {
+		pTrace->Stamp(TRACE_IODONE);
+	}
 	if (read == 0) {
 		this->flags |= File_Bad;
 		return;
 	}
+	if (Filesystem::pMetricBytesRead) {
+		Filesystem::pMetricBytesRead->Add(read);
+	}
 	if (callback) {
 		callback(this, data, dataSize);
 	}
@@ -180,16 +206,22 @@ void File::DequeRead(void* data, size_t dataSize, fileReadCallback callback) {
 Gets run whenever the filesystem deques a write command on this file.
 The callback is run after the write command is complete.
 */
-void File::DequeWrite(void* data, size_t dataSize, fileWrittenCallback callback) {
+void File::DequeWrite(void* data, size_t dataSize, fileWrittenCallback callback, requestTrace_t* pTrace) {
 	if (this->fp == nullptr) {
 		this->flags |= File_Bad;
 		return;
 	}
 	size_t written = fwrite(data, 1, dataSize, this->fp);
+	if (pTrace) {
+		pTrace->Stamp(TRACE_IODONE);
+	}
 	if (written == 0) {
 		this->flags |= File_Bad;
 		return;
 	}
+	if (Filesystem::pMetricBytesWritten) {
+		Filesystem::pMetricBytesWritten->Add(written);
+	}
 	if (callback) {
 		callback(this, data, dataSize);
 	}
@@ -200,8 +232,11 @@ void File::DequeWrite(void* data, size_t dataSize, fileWrittenCallback callback)
 Gets run whenever the filesystem deques a close command on this file.
 The callback is run after the close command is complete.
 */
-void File::DequeClose(fileClosedCallback callback) {
+void File::DequeClose(fileClosedCallback callback, requestTrace_t* pTrace) {
 	fclose(this->fp);
+	if (pTrace) {
+		pTrace->Stamp(TRACE_IODONE);
+	}
 	if (callback) {
 		callback(this);
 	}
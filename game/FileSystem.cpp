@@ -3,10 +3,13 @@
 #include <vector>
 #include <concurrentqueue.h>
 #include <dirent.h>
+#define RASS_PayloadAlloc(size)	Filesystem::AllocPayload(size)
 #include <SerializedRaptureAsset.h>
 #include <fstream>
 #include <cereal/archives/binary.hpp>
 
+#define FS_TASKQUEUE_CAPACITY	256
+
 unordered_map<string, AssetComponent*> m_assetComponents;
 
 namespace Filesystem {
@@ -19,11 +22,24 @@ namespace Filesystem {
 	Cvar* fs_multithreaded = nullptr;
 	Cvar* fs_threads = nullptr;
 	Cvar* fs_threadsleep = nullptr;
+	Cvar* fs_hugepages = nullptr;
+
+	/* Metrics */
+	Metric* pMetricBytesRead = nullptr;
+	Metric* pMetricBytesWritten = nullptr;
+	Metric* pMetricCacheHits = nullptr;
+	Metric* pMetricCacheMisses = nullptr;
+	static Metric* pMetricFileTasks = nullptr;
+	static Metric* pMetricResourceTasks = nullptr;
+	static Metric* pMetricResourceTime = nullptr;
+	static Metric* pMetricFileQueue = nullptr;
+	static Metric* pMetricResourceQueue = nullptr;
 
 	/* Parallelism */
+	// Task records are stored by value; preallocating the blocks keeps enqueue off of the heap
 	using namespace moodycamel;
-	ConcurrentQueue<AsyncFileTask> qFileTasks;
-	ConcurrentQueue<AsyncResourceTask> qResourceTasks;
+	ConcurrentQueue<AsyncFileTask> qFileTasks(FS_TASKQUEUE_CAPACITY);
+	ConcurrentQueue<AsyncResourceTask> qResourceTasks(FS_TASKQUEUE_CAPACITY);
 	MutexVariable<vector<File*>> vOpenFiles;
 	vector<thread*> vWorkerThreads;
 	bool thread_die = false;
@@ -33,39 +49,85 @@ namespace Filesystem {
 
 	vector<string> vSearchPaths;
 	
+	/* Tasks run on a worker, or right away when the filesystem isn't multithreaded */
+	static void RunFileTask(AsyncFileTask& task) {
+		PROFILE_ZONE("File task");
+		task.trace.Stamp(TRACE_DEQUEUE);
+		switch (task.type) {
+		case AsyncFileTask::Task_Open:
+			task.pFile->DequeOpen((fileOpenedCallback)task.callback, &task.trace);
+			break;
+		case AsyncFileTask::Task_Close:
+			task.pFile->DequeClose((fileClosedCallback)task.callback, &task.trace);
+			break;
+		case AsyncFileTask::Task_Read:
+			task.pFile->DequeRead(task.data, task.dataSize, (fileReadCallback)task.callback, &task.trace);
+			break;
+		case AsyncFileTask::Task_Write:
+			task.pFile->DequeWrite(task.data, task.dataSize, (fileWrittenCallback)task.callback, &task.trace);
+			break;
+		}
+		if (pMetricFileTasks) {
+			pMetricFileTasks->Add(1);
+		}
+		ResTrace::Submit(task.trace);
+	}
+
+	static void RunResourceTask(AsyncResourceTask& task) {
+		PROFILE_ZONE("Resource task");
+		task.trace.Stamp(TRACE_DEQUEUE);
+		switch (task.type) {
+			case AsyncResourceTask::Task_Request:
+				task.pResource->DequeRetrieve((assetRequestCallback)task.callback, &task.trace);
+				break;
+		}
+		ResTrace::Submit(task.trace);
+		if (pMetricResourceTasks) {
+			pMetricResourceTasks->Add(1);
+			pMetricResourceTime->Record((task.trace.ulStamps[TRACE_CALLBACKDONE] - task.trace.ulStamps[TRACE_DEQUEUE]) / 1000);
+		}
+	}
+
 	/* What each worker thread is running */
 	void worker_thread() {
+		Profiler::SetThreadName("Filesystem worker");
 		while (!thread_die) {
 			// Do a file task and then a resource task each step
 			AsyncFileTask FTask;
 			if (qFileTasks.try_dequeue(FTask)) {
-				switch (FTask.type) {
-				case AsyncFileTask::Task_Open:
-					FTask.pFile->DequeOpen((fileOpenedCallback)FTask.callback);
-					break;
-				case AsyncFileTask::Task_Close:
-					FTask.pFile->DequeClose((fileClosedCallback)FTask.callback);
-					break;
-				case AsyncFileTask::Task_Read:
-					FTask.pFile->DequeRead(FTask.data, FTask.dataSize, (fileReadCallback)FTask.callback);
-					break;
-				case AsyncFileTask::Task_Write:
-					FTask.pFile->DequeRead(FTask.data, FTask.dataSize, (fileWrittenCallback)FTask.callback);
-					break;
-				}
+				RunFileTask(FTask);
 			}
 			
 			AsyncResourceTask RTask;
 			if (qResourceTasks.try_dequeue(RTask)) {
-				switch (RTask.type) {
-					case AsyncResourceTask::Task_Request:
-						RTask.pResource->DequeRetrieve((assetRequestCallback)RTask.callback);
-						break;
-				}
+				RunResourceTask(RTask);
 			}
 
-			::this_thread::sleep_for(chrono::milliseconds(fs_threadsleep->Integer()));
+			::this_thread::sleep_for(chrono::milliseconds(fs_threadsleep->AtomicInteger()));
 		}
+		Profiler::ExitThread();
+	}
+
+	/* Queue depths are only sampled when metrics get looked at */
+	static void SampleMetrics() {
+		if (pMetricFileQueue == nullptr) {
+			return;
+		}
+		pMetricFileQueue->Set(qFileTasks.size_approx());
+		pMetricResourceQueue->Set(qResourceTasks.size_approx());
+	}
+
+	static void InitMetrics() {
+		pMetricBytesRead = Metrics::Counter("fs.bytes_read");
+		pMetricBytesWritten = Metrics::Counter("fs.bytes_written");
+		pMetricCacheHits = Metrics::Counter("resource.cache_hits");
+		pMetricCacheMisses = Metrics::Counter("resource.cache_misses");
+		pMetricFileTasks = Metrics::Counter("fs.file_tasks");
+		pMetricResourceTasks = Metrics::Counter("fs.resource_tasks");
+		pMetricResourceTime = Metrics::Histogram("fs.resource_task_us");
+		pMetricFileQueue = Metrics::Gauge("fs.file_queue");
+		pMetricResourceQueue = Metrics::Gauge("fs.resource_queue");
+		Metrics::AddSampler(SampleMetrics);
 	}
 
 	/* Create the thread pool */
@@ -149,6 +211,169 @@ namespace Filesystem {
 		}
 	}
 
+	/* Asset cache */
+	// Every asset file that's been loaded, so that the files zone can be trimmed when it runs over budget.
+	// An asset stays resident for as long as a Resource is holding on to one of its components.
+	struct loadedAsset_t {
+		RaptureAsset* pAsset;
+		int numResources;
+		unsigned int lastUsed;
+	};
+	static unordered_map<string, loadedAsset_t> mLoadedAssets;
+	static unsigned int assetCacheClock = 0;
+	recursive_mutex assetCacheMutex;
+
+	static string AssetKey(const string& assetName) {
+		string key = assetName;
+		transform(key.begin(), key.end(), key.begin(), ::tolower);
+		return key;
+	}
+
+	/* Frees the payload that a component points to (the component itself lives in the files zone). Returns the payload bytes freed. */
+	static size_t FreeComponentData(AssetComponent* pComp) {
+		size_t freed = 0;
+		switch (pComp->meta.componentType) {
+			case Asset_Undefined:
+				if (pComp->meta.decompressedSize > 0) {
+					freed += FreePayload(pComp->data.undefinedComponent);
+					pComp->data.undefinedComponent = nullptr;
+				}
+				break;
+			case Asset_Data:
+				if (pComp->data.dataComponent->data) {
+					freed += FreePayload(pComp->data.dataComponent->data);
+					pComp->data.dataComponent->data = nullptr;
+				}
+				free(pComp->data.dataComponent);
+				break;
+			case Asset_Material:
+				if (pComp->data.materialComponent->diffusePixels) {
+					freed += FreePayload(pComp->data.materialComponent->diffusePixels);
+					pComp->data.materialComponent->diffusePixels = nullptr;
+				}
+				if (pComp->data.materialComponent->normalPixels) {
+					freed += FreePayload(pComp->data.materialComponent->normalPixels);
+					pComp->data.materialComponent->normalPixels = nullptr;
+				}
+				if (pComp->data.materialComponent->depthPixels) {
+					freed += FreePayload(pComp->data.materialComponent->depthPixels);
+					pComp->data.materialComponent->depthPixels = nullptr;
+				}
+				free(pComp->data.materialComponent);
+				break;
+			case Asset_Image:
+				if (pComp->data.imageComponent->pixels) {
+					freed += FreePayload(pComp->data.imageComponent->pixels);
+					pComp->data.imageComponent->pixels = nullptr;
+				}
+				free(pComp->data.imageComponent);
+				break;
+			case Asset_Font:
+				if (pComp->data.fontComponent->fontData) {
+					freed += FreePayload(pComp->data.fontComponent->fontData);
+					pComp->data.fontComponent->fontData = nullptr;
+				}
+				free(pComp->data.fontComponent);
+				break;
+			case Asset_Level:
+				if (pComp->data.levelComponent->tiles) {
+					freed += FreePayload(pComp->data.levelComponent->tiles);
+					pComp->data.levelComponent->tiles = nullptr;
+				}
+				if (pComp->data.levelComponent->ents) {
+					freed += FreePayload(pComp->data.levelComponent->ents);
+					pComp->data.levelComponent->ents = nullptr;
+				}
+				free(pComp->data.levelComponent);
+				break;
+			case Asset_Composition:
+				if (pComp->data.compComponent->components) {
+					freed += FreePayload(pComp->data.compComponent->components);
+					pComp->data.compComponent->components = nullptr;
+				}
+				if (pComp->data.compComponent->keyframes) {
+					freed += FreePayload(pComp->data.compComponent->keyframes);
+					pComp->data.compComponent->keyframes = nullptr;
+				}
+				free(pComp->data.compComponent);
+				break;
+		}
+		return freed;
+	}
+
+	/* Frees an asset file and drops its components from the lookup table. Returns how much of the files zone was given back. */
+	static size_t UnloadRaptureAsset(const string& key, RaptureAsset* pAsset) {
+		size_t freed = 0;
+		for (int i = 0; i < pAsset->head.numberComponents; i++) {
+			AssetComponent* pComp = &pAsset->components[i];
+			auto it = m_assetComponents.find(key + '/' + AssetKey(pComp->meta.componentName));
+			if (it != m_assetComponents.end() && it->second == pComp) {
+				m_assetComponents.erase(it);
+			}
+			freed += FreeComponentData(pComp);
+		}
+		freed += Zone::FastFree(pAsset->components, "files");
+		freed += Zone::FastFree(pAsset, "files");
+		return freed;
+	}
+
+	/* Eviction callback for the files zone: unloads assets that nothing is using, least recently used first. Runs on the main thread. */
+	static void EvictIdleAssets(const char* tag, size_t bytesOverBudget) {
+		lock_guard<recursive_mutex> lock(assetCacheMutex);
+		vector<pair<unsigned int, string>> vIdle;
+		for (auto it = mLoadedAssets.begin(); it != mLoadedAssets.end(); ++it) {
+			if (it->second.numResources <= 0) {
+				vIdle.push_back(make_pair(it->second.lastUsed, it->first));
+			}
+		}
+		sort(vIdle.begin(), vIdle.end());
+
+		size_t freed = 0;
+		int numEvicted = 0;
+		for (auto it = vIdle.begin(); it != vIdle.end() && freed < bytesOverBudget; ++it) {
+			auto asset = mLoadedAssets.find(it->second);
+			freed += UnloadRaptureAsset(asset->first, asset->second.pAsset);
+			mLoadedAssets.erase(asset);
+			numEvicted++;
+		}
+		if (numEvicted > 0) {
+			R_Message(PRIORITY_DEBUG, "Evicted %i idle assets (%i bytes) from zone tag '%s'\n", numEvicted, freed, tag);
+		}
+	}
+
+	/* Makes a freshly loaded asset findable. If another thread loaded the same asset first, the duplicate is thrown away. */
+	void CacheRaptureAsset(RaptureAsset* pAsset, const string& assetName) {
+		lock_guard<recursive_mutex> lock(assetCacheMutex);
+		string key = AssetKey(assetName);
+		if (mLoadedAssets.find(key) != mLoadedAssets.end()) {
+			UnloadRaptureAsset(key, pAsset);
+			return;
+		}
+		for (int i = 0; i < pAsset->head.numberComponents; i++) {
+			m_assetComponents[key + '/' + AssetKey(pAsset->components[i].meta.componentName)] = &pAsset->components[i];
+		}
+		loadedAsset_t loaded = { pAsset, 0, ++assetCacheClock };
+		mLoadedAssets[key] = loaded;
+	}
+
+	/* Pins an asset while a Resource is using it */
+	void AcquireRaptureAsset(const string& assetName) {
+		lock_guard<recursive_mutex> lock(assetCacheMutex);
+		auto it = mLoadedAssets.find(AssetKey(assetName));
+		if (it != mLoadedAssets.end()) {
+			it->second.numResources++;
+			it->second.lastUsed = ++assetCacheClock;
+		}
+	}
+
+	void ReleaseRaptureAsset(const string& assetName) {
+		lock_guard<recursive_mutex> lock(assetCacheMutex);
+		auto it = mLoadedAssets.find(AssetKey(assetName));
+		if (it != mLoadedAssets.end() && it->second.numResources > 0) {
+			it->second.numResources--;
+		}
+	}
+
 	/* Init the filesystem */
 	void Init() {
 		Zone::NewTag("files");
@@ -161,10 +386,13 @@ namespace Filesystem {
 		fs_multithreaded = CvarSystem::RegisterCvar("fs_multithreaded", "Whether to use a multithreaded filesystem", (1 << CVAR_ROM), true);
 		fs_threads = CvarSystem::RegisterCvar("fs_threads", "How many threads to use. 2 is best for most systems; 4 is best for RAID or SSD drives.", 0, 2);
 		fs_threadsleep = CvarSystem::RegisterCvar("fs_threadsleep", "How long filesystem threads should sleep for between tasks.", (1 << CVAR_ARCHIVE), 50);
+		fs_hugepages = CvarSystem::RegisterCvar("fs_hugepages", "Ask the OS to back large asset payloads with transparent huge pages, where supported.", (1 << CVAR_ARCHIVE), false);
 
 		fs_threads->AddCallback(ResizeThreadPool);
 
+		InitMetrics();
 		InitThreadPool(fs_threads->Integer());
+		Zone::AddEvictionCallback("files", EvictIdleAssets);
 
 		// Initialize searchpaths
 		vSearchPaths.push_back(string(fs_basepath->String()) + "/" + string(fs_core->String()));
@@ -198,85 +426,51 @@ namespace Filesystem {
 
 	/* Shutdown the filesystem */
 	void Exit() {
+		Zone::RemoveEvictionCallback("files", EvictIdleAssets);
+
 		// Free misc resource data
-		for (auto it = m_assetComponents.begin(); it != m_assetComponents.end(); it++) {
-			AssetComponent* pComp = it->second;
-			switch (pComp->meta.componentType) {
-				case Asset_Undefined:
-					if (pComp->meta.decompressedSize > 0) {
-						free(pComp->data.undefinedComponent);
-						pComp->data.undefinedComponent = nullptr;
-					}
-					break;
-				case Asset_Data:
-					if (pComp->data.dataComponent->data) {
-						free(pComp->data.dataComponent->data);
-						pComp->data.dataComponent->data = nullptr;
-					}
-					free(pComp->data.dataComponent);
-					break;
-				case Asset_Material:
-					if (pComp->data.materialComponent->diffusePixels) {
-						free(pComp->data.materialComponent->diffusePixels);
-						pComp->data.materialComponent->diffusePixels = nullptr;
-					}
-					if (pComp->data.materialComponent->normalPixels) {
-						free(pComp->data.materialComponent->normalPixels);
-						pComp->data.materialComponent->normalPixels = nullptr;
-					}
-					if (pComp->data.materialComponent->depthPixels) {
-						free(pComp->data.materialComponent->depthPixels);
-						pComp->data.materialComponent->depthPixels = nullptr;
-					}
-					free(pComp->data.materialComponent);
-					break;
-				case Asset_Image:
-					if (pComp->data.imageComponent->pixels) {
-						free(pComp->data.imageComponent->pixels);
-						pComp->data.imageComponent->pixels = nullptr;
-					}
-					free(pComp->data.imageComponent);
-					break;
-				case Asset_Font:
-					if (pComp->data.fontComponent->fontData) {
-						free(pComp->data.fontComponent->fontData);
-						pComp->data.fontComponent->fontData = nullptr;
-					}
-					free(pComp->data.fontComponent);
-					break;
-				case Asset_Level:
-					if (pComp->data.levelComponent->tiles) {
-						free(pComp->data.levelComponent->tiles);
-						pComp->data.levelComponent->tiles = nullptr;
-					}
-					if (pComp->data.levelComponent->ents) {
-						free(pComp->data.levelComponent->ents);
-						pComp->data.levelComponent->ents = nullptr;
-					}
-					free(pComp->data.levelComponent);
-					break;
-				case Asset_Composition:
-					if (pComp->data.compComponent->components) {
-						free(pComp->data.compComponent->components);
-						pComp->data.compComponent->components = nullptr;
-					}
-					if (pComp->data.compComponent->keyframes) {
-						free(pComp->data.compComponent->keyframes);
-						pComp->data.compComponent->keyframes = nullptr;
-					}
-					free(pComp->data.compComponent);
-					break;
+		{
+			lock_guard<recursive_mutex> lock(assetCacheMutex);
+			for (auto it = m_assetComponents.begin(); it != m_assetComponents.end(); it++) {
+				FreeComponentData(it->second);
 			}
+			m_assetComponents.clear();
+			mLoadedAssets.clear();
 		}
 
 		Zone::FreeAll("files");
 
 		ShutdownThreadPool();
+
+		// Metrics::Shutdown deletes these, and files can still be read and written after this
+		pMetricBytesRead = pMetricBytesWritten = nullptr;
+		pMetricCacheHits = pMetricCacheMisses = nullptr;
+		pMetricFileTasks = pMetricResourceTasks = pMetricResourceTime = nullptr;
+		pMetricFileQueue = pMetricResourceQueue = nullptr;
+	}
+
+	/* Asset payloads are loaded aligned so that they can be processed with aligned SIMD loads */
+	/* They go on the files tag with the rest of the asset, so its budget and zonetrack see them */
+	void* AllocPayload(size_t size) {
+		void* memory = Zone::AllocAligned(size, "files");
+		if (memory != nullptr && size >= ZONE_HUGEPAGE_SIZE && fs_hugepages != nullptr && fs_hugepages->Bool()) {
+			Sys_AdviseHugePages(memory, size);
+		}
+		return memory;
+	}
+
+	size_t FreePayload(void* memory) {
+		return Zone::FastFree(memory, "files");
 	}
 
-	/* Loads up a RaptureAsset and stores it in zone memory */
+	/* cereal only needs something to read from, so a buffer that's already in memory will do */
+	struct memoryStreambuf : public streambuf {
+		memoryStreambuf(char* buffer, size_t size) { setg(buffer, buffer, buffer + size); }
+	};
+
+	/* Loads up a RaptureAsset and stores it in zone memory. CacheRaptureAsset makes its components findable. */
 	/* TODO: move to hunk */
-	void LoadRaptureAsset(RaptureAsset** ptAsset, const string& assetName) {
+	bool LoadRaptureAsset(RaptureAsset** ptAsset, const string& assetName, requestTrace_t* pTrace) {
 		RaptureAsset* pAsset = *ptAsset;
 		auto assetPath = m_assetList[assetName];
 		ifstream infile;
@@ -284,23 +478,36 @@ namespace Filesystem {
 		infile.open(assetPath.c_str(), std::ios::binary);
 		if (infile.bad() || infile.eof()) {
 			R_Message(PRIORITY_ERRFATAL, "Could not load asset %s - try running as administrator\n", assetName.c_str());
-			return;
+			return false;
+		}
+
+		// Read the whole file before deserializing it, so that the disk and cereal can be timed separately
+		infile.seekg(0, ios::end);
+		streamoff fileSize = infile.tellg();
+		infile.seekg(0, ios::beg);
+		vector<char> vFileData(fileSize > 0 ? (size_t)fileSize : 0);
+		if (!vFileData.empty()) {
+			infile.read(&vFileData[0], vFileData.size());
+		}
+		infile.close();
+		if (pTrace) {
+			pTrace->Stamp(TRACE_IODONE);
 		}
 
-		cereal::BinaryInputArchive in(infile);
+		memoryStreambuf buffer(vFileData.empty() ? nullptr : &vFileData[0], vFileData.size());
+		istream stream(&buffer);
+		cereal::BinaryInputArchive in(stream);
 		in >> pAsset->head;
 
 		if (pAsset->head.version != RASS_VERSION) {
 			R_Message(PRIORITY_WARNING, "Asset file with bad version (found %i, expected %i)\n", pAsset->head.version, RASS_VERSION);
-			infile.close();
-			return;
+			return false;
 		}
 
 		// TODO: compression
 		if (pAsset->head.compressionType != Compression_None) {
 			R_Message(PRIORITY_WARNING, "Compression not supported (found in asset %s)\n", pAsset->head.assetName);
-			infile.close();
-			return;
+			return false;
 		}
 
 		// TODO: DLC check
@@ -308,12 +515,11 @@ namespace Filesystem {
 		pAsset->components = (AssetComponent*)Zone::Alloc(sizeof(AssetComponent) * pAsset->head.numberComponents, "files");
 		for (int i = 0; i < pAsset->head.numberComponents; i++) {
 			in >> pAsset->components[i];
-
-			string szFullName = assetName + '/' + pAsset->components[i].meta.componentName;
-			transform(szFullName.begin(), szFullName.end(), szFullName.begin(), ::tolower);
-			m_assetComponents[szFullName] = &pAsset->components[i];
 		}
-		infile.close();
+		if (pTrace) {
+			pTrace->Stamp(TRACE_DECODEDONE);
+		}
+		return true;
 	}
 
 	/* Find a component residing within an asset file */
@@ -441,12 +647,13 @@ namespace Filesystem {
 		if (pFile == nullptr) {
 			return;
 		}
+		AsyncFileTask task = { AsyncFileTask::Task_Open, pFile, callback };
+		task.trace.Begin("file open", pFile->GetFilePath());
 		if (fs_multithreaded->Bool()) {
-			AsyncFileTask task = { AsyncFileTask::Task_Open, pFile, callback };
 			qFileTasks.enqueue(task);
 		}
 		else {
-			pFile->DequeOpen(callback);
+			RunFileTask(task);
 		}
 	}
 
@@ -454,12 +661,13 @@ namespace Filesystem {
 		if (pFile == nullptr) {
 			return;
 		}
+		AsyncFileTask task = { AsyncFileTask::Task_Read, pFile, callback, data, dataSize };
+		task.trace.Begin("file read", pFile->GetFilePath());
 		if (fs_multithreaded->Bool()) {
-			AsyncFileTask task = { AsyncFileTask::Task_Read, pFile, callback, data, dataSize };
 			qFileTasks.enqueue(task);
 		}
 		else {
-			pFile->DequeRead(data, dataSize, callback);
+			RunFileTask(task);
 		}
 	}
 
@@ -467,12 +675,13 @@ namespace Filesystem {
 		if (pFile == nullptr) {
 			return;
 		}
+		AsyncFileTask task = { AsyncFileTask::Task_Write, pFile, callback, data, dataSize };
+		task.trace.Begin("file write", pFile->GetFilePath());
 		if (fs_multithreaded->Bool()) {
-			AsyncFileTask task = { AsyncFileTask::Task_Write, pFile, callback, data, dataSize };
 			qFileTasks.enqueue(task);
 		}
 		else {
-			pFile->DequeWrite(data, dataSize, callback);
+			RunFileTask(task);
 		}
 	}
 
@@ -480,12 +689,13 @@ namespace Filesystem {
 		if (pFile == nullptr) {
 			return;
 		}
+		AsyncFileTask task = { AsyncFileTask::Task_Close, pFile, callback };
+		task.trace.Begin("file close", pFile->GetFilePath());
 		if (fs_multithreaded->Bool()) {
-			AsyncFileTask task = { AsyncFileTask::Task_Close, pFile, callback };
 			qFileTasks.enqueue(task);
 		}
 		else {
-			pFile->DequeClose(callback);
+			RunFileTask(task);
 		}
 	}
 
@@ -493,12 +703,15 @@ namespace Filesystem {
 		if (pRes == nullptr) {
 			return;
 		}
+		char name[RESTRACE_NAMELEN];
+		Sys_snprintf(name, sizeof(name), "%s/%s", pRes->GetAssetName(), pRes->GetComponentName());
+		AsyncResourceTask task = { AsyncResourceTask::Task_Request, pRes, callback };
+		task.trace.Begin("resource", name);
 		if (fs_multithreaded->Bool()) {
-			AsyncResourceTask task = { AsyncResourceTask::Task_Request, pRes, callback };
 			qResourceTasks.enqueue(task);
 		}
 		else {
-			pRes->DequeRetrieve(callback);
+			RunResourceTask(task);
 		}
 	}
 
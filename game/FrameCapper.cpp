@@ -1,22 +1,97 @@
 #include "sys_local.h"
+#include <math.h>
+
+/*
+ * Frame pacing. Each frame has a deadline which is one frame length after the last one, so rounding
+ * doesn't accumulate and fractional-millisecond targets (144, 165, 240 fps) come out right.
+ * The pacer sleeps until it gets close to the deadline (sleeps are only good to a millisecond or so),
+ * then yields for the rest.
+ */
+
+uint64_t FrameCapper::ulPacedFrames = 0;
+uint64_t FrameCapper::ulLateFrames = 0;
+double FrameCapper::dErrorSum = 0.0;
+double FrameCapper::dErrorSquaredSum = 0.0;
+uint64_t FrameCapper::ulMaxError = 0;
 
 FrameCapper::FrameCapper() {
 	capCvar = Cvar::Get<int>("com_maxfps", "Maximum allowed FPS", (1 << CVAR_ARCHIVE), 180);
 	hitchWarningCvar = Cvar::Get<int>("com_hitch", "Hitch warning", (1 << CVAR_ARCHIVE), 100);
+	spinCvar = Cvar::Get<int>("com_pacerspin", "Microseconds before the end of a frame where the frame limiter stops sleeping and starts yielding", (1 << CVAR_ARCHIVE), 2000);
+	ulDeadline = 0;
 }
 
 void FrameCapper::StartFrame() {
 	capTimer.Start();
 }
 
+void FrameCapper::WaitUntil(uint64_t ulTarget) {
+	uint64_t ulSpin = spinCvar->Integer() > 0 ? (uint64_t)spinCvar->Integer() * 1000 : 0;
+	while (true) {
+		uint64_t ulNow = Timer::Nanoseconds();
+		if (ulNow >= ulTarget) {
+			return;
+		}
+		uint64_t ulRemaining = ulTarget - ulNow;
+		if (ulRemaining > ulSpin + 1000000) {
+			SDL_Delay((Uint32)((ulRemaining - ulSpin) / 1000000));
+		}
+		else {
+			this_thread::yield();
+		}
+	}
+}
+
 void FrameCapper::EndFrame() {
+	uint64_t ulFrameStart = Timer::Nanoseconds() - capTimer.GetNanoseconds();
 	unsigned long ulFrameTicks = capTimer.GetTicks();
-	unsigned long ulCap = (1000 / capCvar->Integer());
 	unsigned long ulHitchWarning = hitchWarningCvar->Integer();
-	if(ulFrameTicks < ulCap) {
-		SDL_Delay( ulCap - ulFrameTicks );
-	}
 	if(ulFrameTicks >= ulHitchWarning && ulHitchWarning > 0) {
 		R_Message(PRIORITY_WARNING, "hitch warning: %i ms frame time\n", ulFrameTicks);
+		Profiler::ReportHitch(ulFrameTicks);
+	}
+
+	// timedemo and stress run flat out
+	if (capCvar->Integer() <= 0 || Demo::IsPlaying() || Stress::IsRunning()) {
+		ulDeadline = 0;
+		return;
+	}
+	uint64_t ulFrameLength = 1000000000ULL / capCvar->Integer();
+	uint64_t ulNow = Timer::Nanoseconds();
+
+	// Start over from this frame if we've fallen more than a frame behind (or com_maxfps went up), so we don't race to catch up
+	ulDeadline += ulFrameLength;
+	if (ulDeadline + ulFrameLength < ulNow || ulDeadline > ulFrameStart + ulFrameLength * 2) {
+		ulDeadline = ulFrameStart + ulFrameLength;
 	}
-}
\ No newline at end of file
+
+	if (ulNow >= ulDeadline) {
+		ulLateFrames++;
+		return;
+	}
+	WaitUntil(ulDeadline);
+
+	uint64_t ulError = Timer::Nanoseconds() - ulDeadline;
+	ulPacedFrames++;
+	dErrorSum += (double)ulError;
+	dErrorSquaredSum += (double)ulError * (double)ulError;
+	if (ulError > ulMaxError) {
+		ulMaxError = ulError;
+	}
+}
+
+void FrameCapper::PrintPacingStats() {
+	R_Message(PRIORITY_MESSAGE, "%i frames paced, %i already over time\n", (int)ulPacedFrames, (int)ulLateFrames);
+	if (ulPacedFrames == 0) {
+		return;
+	}
+	double dMean = dErrorSum / ulPacedFrames;
+	double dVariance = dErrorSquaredSum / ulPacedFrames - dMean * dMean;
+	R_Message(PRIORITY_MESSAGE, "pacing error: mean %.1f us, stddev %.1f us, max %.1f us\n",
+		dMean / 1000.0, sqrt(dVariance > 0.0 ? dVariance : 0.0) / 1000.0, ulMaxError / 1000.0);
+}
+
+void FrameCapper::ResetPacingStats() {
+	ulPacedFrames = ulLateFrames = ulMaxError = 0;
+	dErrorSum = dErrorSquaredSum = 0.0;
+}
@@ -17,6 +17,7 @@ void InputManager::SendKeyDownEvent(SDL_Keysym key, char* text) {
 	if(it != thisFrameKeysDown.end())
 		return;
 	thisFrameKeysDown.push_back(k);
+	Demo::RecordKey(key, text, true);
 
 	// TODO: keycatchers
 	UI::KeyboardEvent(key, true, text);
@@ -26,6 +27,7 @@ bool bVMInputBlocked = false;
 void InputManager::SendKeyUpEvent(SDL_Keysym key, char* text) {
 	SDL_Scancode k = key.scancode;
 
+	Demo::RecordKey(key, text, false);
 	UI::KeyboardEvent(key, false, text);
 	if(RaptureGame::GetGameModule() != nullptr || RaptureGame::GetEditorModule() != nullptr) {
 		if(!bVMInputBlocked) {
@@ -36,6 +38,7 @@ void InputManager::SendKeyUpEvent(SDL_Keysym key, char* text) {
 
 void InputManager::InputFrame() {
 	SDL_PumpEvents();
+	Demo::ReplayInput();
 	for(auto it = thisFrameKeysDown.begin(); it != thisFrameKeysDown.end(); ++it)
 		ExecuteBind(binds[*it]);
 	thisFrameKeysDown.clear();
@@ -63,6 +66,7 @@ void InputManager::ExecuteBind(const string& bindStuff) {
 }
 
 void InputManager::SendMouseButtonEvent(unsigned int buttonId, unsigned char state, int x, int y) {
+	Demo::RecordMouseButton(buttonId, state, x, y);
 	if(state == SDL_PRESSED) {
 		UI::MouseButtonEvent(buttonId, true);
 		if(RaptureGame::GetGameModule() != nullptr || RaptureGame::GetEditorModule() != nullptr) {
@@ -79,6 +83,7 @@ void InputManager::SendMouseButtonEvent(unsigned int buttonId, unsigned char sta
 }
 
 void InputManager::SendMouseMoveEvent(int x, int y) {
+	Demo::RecordMouseMove(x, y);
 	if(RaptureGame::GetGameModule() != nullptr || RaptureGame::GetEditorModule() != nullptr) {
 		RaptureGame::GetImport()->passmousemove(x, y);
 	}
@@ -86,5 +91,6 @@ void InputManager::SendMouseMoveEvent(int x, int y) {
 }
 
 void InputManager::SendTextInputEvent(char* text) {
+	Demo::RecordTextInput(text);
 	UI::TextEvent(text);
 }
\ No newline at end of file
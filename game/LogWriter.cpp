@@ -0,0 +1,347 @@
+#include "sys_local.h"
+#include <BinaryLog.h>
+
+/*
+ * The LogWriter takes log output off of the calling thread.
+ * Any thread can push a record into a fixed-size ring without taking a lock; a background thread drains the ring,
+ * formats the records and writes them to the logfile in batches.
+ * If the ring fills up (the disk can't keep up), new records are dropped and counted rather than blocking the caller.
+ * In binary mode, records are the format string id plus the raw arguments (see BinaryLog.h), and nothing is formatted at all.
+ */
+
+// Creates the ring and starts the writer thread. The LogWriter does not own the file.
+LogWriter::LogWriter(File* ptFile, bool bBinary) :
+ptLogFile(ptFile),
+bBinaryLog(bBinary),
+ulEnqueuePos(0),
+ulDequeuePos(0),
+ulWritten(0),
+ulDropped(0),
+ulDroppedReported(0),
+bLastHadNewline(true),
+bRunning(true),
+uNextFormatID(0) {
+	if (bBinaryLog) {
+		uint32_t version = BLOG_VERSION;
+		File::WriteSync(ptLogFile, (void*)BLOG_HEADER, 4);
+		File::WriteSync(ptLogFile, &version, sizeof(version));
+	}
+	ptRecords = new LogRecord[LOG_RING_SIZE];
+	for (size_t i = 0; i < LOG_RING_SIZE; i++) {
+		ptRecords[i].ulSequence.store(i, memory_order_relaxed);
+	}
+	thWriter = thread(&LogWriter::WriterThread, this);
+}
+
+LogWriter::~LogWriter() {
+	Stop();
+	delete[] ptRecords;
+}
+
+// Writes out anything still in the ring and stops the writer thread.
+// Anything pushed after this just sits in the ring.
+void LogWriter::Stop() {
+	bRunning.store(false, memory_order_release);
+	if (thWriter.joinable()) {
+		thWriter.join();
+	}
+}
+
+// Claims the next record in the ring. Returns nullptr (and counts the drop) if the ring is full.
+LogWriter::LogRecord* LogWriter::Reserve(size_t& pos) {
+	pos = ulEnqueuePos.load(memory_order_relaxed);
+	LogRecord* pRecord;
+	for (;;) {
+		pRecord = &ptRecords[pos & (LOG_RING_SIZE - 1)];
+		size_t seq = pRecord->ulSequence.load(memory_order_acquire);
+		intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+		if (diff == 0) {
+			if (ulEnqueuePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+				break;
+			}
+		}
+		else if (diff < 0) {
+			ulDropped.fetch_add(1, memory_order_relaxed);
+			return nullptr;
+		}
+		else {
+			pos = ulEnqueuePos.load(memory_order_relaxed);
+		}
+	}
+	return pRecord;
+}
+
+// Hands a filled-in record over to the writer thread
+void LogWriter::Commit(LogRecord* pRecord, size_t pos) {
+	pRecord->ulSequence.store(pos + 1, memory_order_release);
+}
+
+// Pushes a text record into the ring. Safe to call from any thread.
+// Returns false if the ring is full.
+bool LogWriter::Push(int iPriority, const char* message) {
+	size_t pos;
+	LogRecord* pRecord = Reserve(pos);
+	if (pRecord == nullptr) {
+		return false;
+	}
+	pRecord->bBinary = false;
+	pRecord->iPriority = iPriority;
+	pRecord->uTicks = SDL_GetTicks();
+	strncpy(pRecord->szMessage, message, sizeof(pRecord->szMessage));
+	pRecord->szMessage[sizeof(pRecord->szMessage) - 1] = '\0';
+	Commit(pRecord, pos);
+	return true;
+}
+
+// Small helper for writing the binary records
+static bool BinaryLog_Write(char* buffer, size_t bufferSize, size_t& offset, const void* data, size_t dataSize) {
+	if (offset + dataSize > bufferSize) {
+		return false;
+	}
+	memcpy(buffer + offset, data, dataSize);
+	offset += dataSize;
+	return true;
+}
+
+// Looks up the id of a format string, making a new one if we haven't seen it before.
+// The first time we see a format, its definition gets queued ahead of the message. That happens under the lock
+// so that no other thread can queue a message using the id before the definition is in the ring.
+// Returns false if the definition couldn't be queued.
+bool LogWriter::FormatID(const char* fmt, uint32_t& id) {
+	lock_guard<mutex> lock(mFormats);
+	auto it = umFormatIDs.find(fmt);
+	if (it != umFormatIDs.end() && it->second.second == fmt) {
+		id = it->second.first;
+		return true;
+	}
+
+	size_t pos;
+	LogRecord* pRecord = Reserve(pos);
+	if (pRecord == nullptr) {
+		return false;	// try again next time
+	}
+	id = uNextFormatID++;
+	umFormatIDs[fmt] = make_pair(id, string(fmt));
+
+	uint8_t type = BLOG_RECORD_FORMAT;
+	size_t fmtLength = strlen(fmt);
+	if (fmtLength > sizeof(pRecord->szMessage) - 7) {
+		fmtLength = sizeof(pRecord->szMessage) - 7;
+	}
+	uint16_t length = (uint16_t)fmtLength;
+	size_t offset = 0;
+	BinaryLog_Write(pRecord->szMessage, sizeof(pRecord->szMessage), offset, &type, sizeof(type));
+	BinaryLog_Write(pRecord->szMessage, sizeof(pRecord->szMessage), offset, &id, sizeof(id));
+	BinaryLog_Write(pRecord->szMessage, sizeof(pRecord->szMessage), offset, &length, sizeof(length));
+	BinaryLog_Write(pRecord->szMessage, sizeof(pRecord->szMessage), offset, fmt, length);
+	pRecord->bBinary = true;
+	pRecord->usLength = (unsigned short)offset;
+	Commit(pRecord, pos);
+	return true;
+}
+
+// Pushes a binary record into the ring. Safe to call from any thread.
+// The arguments are copied out of the va_list as-is, the writer never formats anything.
+bool LogWriter::PushBinary(int iPriority, const char* fmt, va_list args) {
+	uint32_t id;
+	if (!FormatID(fmt, id)) {
+		return false;
+	}
+
+	size_t pos;
+	LogRecord* pRecord = Reserve(pos);
+	if (pRecord == nullptr) {
+		return false;
+	}
+
+	char* buffer = pRecord->szMessage;
+	const size_t bufferSize = sizeof(pRecord->szMessage);
+	const size_t headerSize = 1 + 1 + 4 + 4 + 2;
+	size_t offset = headerSize;
+
+	// Arguments first, then go back and fill in the header now that we know how large they are
+	const char* p = fmt;
+	binaryLogSpec_t spec;
+	bool bFull = false;
+	while (!bFull && BinaryLog_NextSpec(p, spec)) {
+		for (int i = 0; i < spec.numStarArgs && !bFull; i++) {
+			int64_t value = va_arg(args, int);
+			bFull = !BinaryLog_Write(buffer, bufferSize, offset, &value, sizeof(value));
+		}
+		if (bFull) {
+			break;
+		}
+		switch (spec.argType) {
+			case BLOG_ARG_INT:
+				{
+					int64_t value = va_arg(args, int);
+					bFull = !BinaryLog_Write(buffer, bufferSize, offset, &value, sizeof(value));
+				}
+				break;
+			case BLOG_ARG_LONGLONG:
+				{
+					int64_t value = va_arg(args, long long);
+					bFull = !BinaryLog_Write(buffer, bufferSize, offset, &value, sizeof(value));
+				}
+				break;
+			case BLOG_ARG_POINTER:
+				{
+					int64_t value = (int64_t)(intptr_t)va_arg(args, void*);
+					bFull = !BinaryLog_Write(buffer, bufferSize, offset, &value, sizeof(value));
+				}
+				break;
+			case BLOG_ARG_DOUBLE:
+				{
+					double value = va_arg(args, double);
+					bFull = !BinaryLog_Write(buffer, bufferSize, offset, &value, sizeof(value));
+				}
+				break;
+			case BLOG_ARG_STRING:
+				{
+					const char* value = va_arg(args, const char*);
+					if (value == nullptr) {
+						value = "(null)";
+					}
+					size_t length = strlen(value);
+					if (offset + sizeof(uint16_t) > bufferSize) {
+						bFull = true;
+						break;
+					}
+					if (length > bufferSize - offset - sizeof(uint16_t)) {
+						length = bufferSize - offset - sizeof(uint16_t);	// truncate rather than lose the whole message
+					}
+					uint16_t length16 = (uint16_t)length;
+					BinaryLog_Write(buffer, bufferSize, offset, &length16, sizeof(length16));
+					BinaryLog_Write(buffer, bufferSize, offset, value, length);
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	uint8_t type = BLOG_RECORD_MESSAGE;
+	uint8_t priority = (uint8_t)iPriority;
+	uint32_t ticks = SDL_GetTicks();
+	uint16_t argSize = (uint16_t)(offset - headerSize);
+	size_t headerOffset = 0;
+	BinaryLog_Write(buffer, bufferSize, headerOffset, &type, sizeof(type));
+	BinaryLog_Write(buffer, bufferSize, headerOffset, &priority, sizeof(priority));
+	BinaryLog_Write(buffer, bufferSize, headerOffset, &ticks, sizeof(ticks));
+	BinaryLog_Write(buffer, bufferSize, headerOffset, &id, sizeof(id));
+	BinaryLog_Write(buffer, bufferSize, headerOffset, &argSize, sizeof(argSize));
+
+	pRecord->bBinary = true;
+	pRecord->iPriority = iPriority;
+	pRecord->uTicks = ticks;
+	pRecord->usLength = (unsigned short)offset;
+	Commit(pRecord, pos);
+	return true;
+}
+
+// Blocks until everything that was pushed before this call has been written to disk.
+void LogWriter::Flush() {
+	if (this_thread::get_id() == thWriter.get_id()) {
+		return;
+	}
+	size_t target = ulEnqueuePos.load(memory_order_acquire);
+	while (ulWritten.load(memory_order_acquire) < target && bRunning.load(memory_order_acquire)) {
+		this_thread::sleep_for(chrono::milliseconds(1));
+	}
+}
+
+// Formats one record the same way the log has always looked
+void LogWriter::FormatRecord(const LogRecord& record, string& out) {
+	string in = record.szMessage;
+	bool bThisHasNewline = false;
+#ifdef WIN32
+	size_t pos = 0;
+	while ((pos = in.find('\n', pos)) != string::npos) {
+		in.replace(pos, 1, "\r\n");
+		pos += 2;
+		bThisHasNewline = true;
+	}
+#endif
+
+	if (bLastHadNewline) {
+		// Insert the time
+		char timestamp[32];
+		unsigned int ticks = record.uTicks;
+		sprintf(timestamp, "%02u:%02u:%02u ", ticks / 3600000, ticks / 60000, ticks / 1000);
+		out += timestamp;
+
+		// Insert the message type
+		switch (record.iPriority) {
+			default:
+			case PRIORITY_NOTE:
+				out += "[NOTE]\t\t";
+				break;
+			case PRIORITY_DEBUG:
+				out += "[DEBUG]\t\t";
+				break;
+			case PRIORITY_MESSAGE:
+				out += "[MESSAGE]\t";
+				break;
+			case PRIORITY_WARNING:
+				out += "[WARNING]\t";
+				break;
+			case PRIORITY_ERROR:
+				out += "[ERROR]\t";
+				break;
+			case PRIORITY_ERRFATAL:
+				out += "[FATAL]\t\t";
+				break;
+		}
+	}
+
+	// Lastly, insert the message itself
+	out += in;
+	bLastHadNewline = bThisHasNewline;
+}
+
+// Drains everything that is currently in the ring into one write. Returns the number of records written.
+size_t LogWriter::WriteBatch() {
+	string batch;
+	size_t numRecords = 0;
+	for (;;) {
+		LogRecord& record = ptRecords[ulDequeuePos & (LOG_RING_SIZE - 1)];
+		size_t seq = record.ulSequence.load(memory_order_acquire);
+		if (seq != ulDequeuePos + 1) {
+			break;	// empty, or the next record hasn't been filled in yet
+		}
+		if (record.bBinary) {
+			batch.append(record.szMessage, record.usLength);
+		}
+		else {
+			FormatRecord(record, batch);
+		}
+		record.ulSequence.store(ulDequeuePos + LOG_RING_SIZE, memory_order_release);
+		ulDequeuePos++;
+		numRecords++;
+	}
+
+	size_t dropped = ulDropped.load(memory_order_relaxed);
+	if (dropped != ulDroppedReported && !bBinaryLog) {
+		char note[64];
+		sprintf(note, "(%u log messages dropped)\n", (unsigned int)(dropped - ulDroppedReported));
+		batch += note;
+		ulDroppedReported = dropped;
+	}
+
+	if (batch.length() > 0) {
+		File::WriteSync(ptLogFile, (void*)batch.c_str(), batch.length());
+	}
+	ulWritten.fetch_add(numRecords, memory_order_release);
+	return numRecords;
+}
+
+// Runs on the writer thread until the LogWriter is destroyed
+void LogWriter::WriterThread() {
+	while (bRunning.load(memory_order_acquire)) {
+		if (WriteBatch() == 0) {
+			this_thread::sleep_for(chrono::milliseconds(LOG_WRITER_SLEEP));
+		}
+	}
+	// Pick up anything that came in while we were shutting down
+	while (WriteBatch() > 0);
+}
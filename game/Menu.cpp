@@ -8,7 +8,7 @@ void EXPORT_execCommand(const JSArray& args) {
 		return;
 	if(!args[0].IsString())
 		return;
-	Cmd::ProcessCommand(ToString(args[0].ToString()).c_str());
+	Cmd::AppendCommand(ToString(args[0].ToString()));
 }
 
 bool CvarGet_IsValid(const JSArray& args) {
@@ -27,105 +27,115 @@ JSValue EXPORT_getCvarString(const JSArray& args) {
 	if(!CvarGet_IsValid(args))
 		return JSValue::Null();
 	string cvarName = ToString(args[0].ToString());
-	Cvar::cvarType_e type = CvarSystem::GetCvarType(cvarName);
-	if(type != Cvar::CV_STRING) {
+	Cvar* cv = CvarSystem::FindCvar(cvarName);
+	if(cv == nullptr || cv->GetType() != Cvar::CV_STRING) {
 		R_Message(PRIORITY_WARNING, "JS warning: getCvarString: cvar %s is not string type\n", cvarName.c_str());
 		return JSValue::Null();
 	}
-	string value = CvarSystem::GetStringValue(cvarName.c_str());
-	return JSValue(WSLit(value.c_str()));
+	return JSValue(WSLit(cv->Read<char*>()));
 }
 
 JSValue EXPORT_getCvarInteger(const JSArray& args) {
 	if(!CvarGet_IsValid(args))
 		return JSValue::Null();
 	string cvarName = ToString(args[0].ToString());
-	Cvar::cvarType_e type = CvarSystem::GetCvarType(cvarName);
-	if(type != Cvar::CV_INTEGER) {
+	Cvar* cv = CvarSystem::FindCvar(cvarName);
+	if(cv == nullptr || cv->GetType() != Cvar::CV_INTEGER) {
 		R_Message(PRIORITY_WARNING, "JS warning: getCvarInteger: cvar %s is not integer type\n", cvarName.c_str());
 		return JSValue::Null();
 	}
-	return JSValue(CvarSystem::GetIntegerValue(cvarName.c_str()));
+	return JSValue(cv->Read<int>());
 }
 
 JSValue EXPORT_getCvarFloat(const JSArray& args) {
 	if(!CvarGet_IsValid(args))
 		return JSValue::Null();
 	string cvarName = ToString(args[0].ToString());
-	Cvar::cvarType_e type = CvarSystem::GetCvarType(cvarName);
-	if(type != Cvar::CV_FLOAT) {
+	Cvar* cv = CvarSystem::FindCvar(cvarName);
+	if(cv == nullptr || cv->GetType() != Cvar::CV_FLOAT) {
 		R_Message(PRIORITY_WARNING, "JS warning: getCvarFloat: cvar %s is not float type\n", cvarName.c_str());
 		return JSValue::Null();
 	}
-	return JSValue(CvarSystem::GetFloatValue(cvarName.c_str()));
+	return JSValue(cv->Read<float>());
 }
 
 JSValue EXPORT_getCvarBoolean(const JSArray& args) {
 	if(!CvarGet_IsValid(args))
 		return JSValue::Null();
 	string cvarName = ToString(args[0].ToString());
-	Cvar::cvarType_e type = CvarSystem::GetCvarType(cvarName);
-	if(type != Cvar::CV_BOOLEAN) {
+	Cvar* cv = CvarSystem::FindCvar(cvarName);
+	if(cv == nullptr || cv->GetType() != Cvar::CV_BOOLEAN) {
 		R_Message(PRIORITY_WARNING, "JS warning: getCvarBoolean: cvar %s is not boolean type\n", cvarName.c_str());
 		return JSValue::Null();
 	}
-	return JSValue(CvarSystem::GetBooleanValue(cvarName.c_str()));
+	return JSValue(cv->Read<bool>());
 }
 
-bool CvarSet_IsValid(const JSArray& args) {
+// Looks up the cvar named by the first argument once, so the setters can write straight to it
+Cvar* CvarSet_Find(const JSArray& args, Cvar::cvarType_e type, const char* szFunction) {
 	if(args.size() != 2) {
 		R_Message(PRIORITY_WARNING, "JS warning: setCvar using incorrect arguments\n");
-		return false;
+		return nullptr;
 	}
 	if(!args[0].IsString()) {
 		R_Message(PRIORITY_WARNING, "JS warning: setCvar: first arg is not string\n");
-		return false;
+		return nullptr;
 	}
-	if(!Cvar::Exists(ToString(args[0].ToString()))) {
+	string cvarName = ToString(args[0].ToString());
+	Cvar* cv = CvarSystem::FindCvar(cvarName);
+	if(cv == nullptr) {
 		R_Message(PRIORITY_WARNING, "JS warning: setCvar: cvar doesn't exist\n");
-		return false;
+		return nullptr;
 	}
-	return true;
+	if(cv->GetType() != type) {
+		R_Message(PRIORITY_WARNING, "JS warning: %s: cvar %s is %s type\n", szFunction, cvarName.c_str(), cv->TypeToString().c_str());
+		return nullptr;
+	}
+	return cv;
 }
 
 void EXPORT_setCvarString(const JSArray& args) {
-	if(!CvarSet_IsValid(args))
+	Cvar* cv = CvarSet_Find(args, Cvar::CV_STRING, "setCvarString");
+	if(cv == nullptr)
 		return;
 	if(!args[1].IsString()) {
 		R_Message(PRIORITY_WARNING, "JS warning: setCvarString: second arg is not string\n");
 		return;
 	}
-	CvarSystem::SetStringValue(ToString(args[0].ToString()), (char*)ToString(args[1].ToString()).c_str());
+	CvarSystem::SetStringValue(cv, (char*)ToString(args[1].ToString()).c_str());
 }
 
 void EXPORT_setCvarInteger(const JSArray& args) {
-	if(!CvarSet_IsValid(args))
+	Cvar* cv = CvarSet_Find(args, Cvar::CV_INTEGER, "setCvarInteger");
+	if(cv == nullptr)
 		return;
 	if(!args[1].IsInteger()) {
 		R_Message(PRIORITY_WARNING, "JS warning: setCvarInteger: second arg is not integer\n");
 		return;
 	}
-	CvarSystem::SetIntegerValue(ToString(args[0].ToString()), args[1].ToInteger());
+	CvarSystem::SetIntegerValue(cv, args[1].ToInteger());
 }
 
 void EXPORT_setCvarFloat(const JSArray& args) {
-	if(!CvarSet_IsValid(args))
+	Cvar* cv = CvarSet_Find(args, Cvar::CV_FLOAT, "setCvarFloat");
+	if(cv == nullptr)
 		return;
 	if(!args[1].IsNumber()) {
 		R_Message(PRIORITY_WARNING, "JS warning: setCvarFloat: second arg is not float\n");
 		return;
 	}
-	CvarSystem::SetFloatValue(ToString(args[0].ToString()), args[1].ToDouble());
+	CvarSystem::SetFloatValue(cv, (float)args[1].ToDouble());
 }
 
 void EXPORT_setCvarBoolean(const JSArray& args) {
-	if(!CvarSet_IsValid(args))
+	Cvar* cv = CvarSet_Find(args, Cvar::CV_BOOLEAN, "setCvarBoolean");
+	if(cv == nullptr)
 		return;
 	if(!args[1].IsBoolean()) {
 		R_Message(PRIORITY_WARNING, "JS warning: setCvarBoolean: second arg is not boolean\n");
 		return;
 	}
-	CvarSystem::SetBooleanValue(ToString(args[0].ToString()), args[1].ToBoolean());
+	CvarSystem::SetBooleanValue(cv, args[1].ToBoolean());
 }
 
 void EXPORT_echo(const JSArray& args) {
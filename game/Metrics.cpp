@@ -0,0 +1,230 @@
+#include "sys_local.h"
+#include <math.h>
+
+/*
+ * A registry of counters, gauges and histograms that subsystems publish into.
+ * Things that are cheaper to read than to keep up to date (zone usage, queue depths) register a sampler instead,
+ * which runs on the main thread right before the metrics get looked at.
+ * With metrics_dump_interval set, a snapshot of everything is appended to metrics.jsonl in the homepath as one JSON object per line.
+ */
+
+Metric::Metric(const string& _sName, metricType_e _type) : sName(_sName), type(_type), value(0), sum(0), maximum(0) {
+	for (int i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++) {
+		buckets[i].store(0);
+	}
+}
+
+void Metric::Record(int64_t sample) {
+	if (sample < 0) {
+		sample = 0;
+	}
+	int bucket = 0;
+	for (uint64_t bits = sample; bits != 0 && bucket < METRICS_HISTOGRAM_BUCKETS - 1; bits >>= 1) {
+		bucket++;
+	}
+	buckets[bucket].fetch_add(1, memory_order_relaxed);
+	sum.fetch_add(sample, memory_order_relaxed);
+	value.fetch_add(1, memory_order_relaxed);
+
+	int64_t previous = maximum.load(memory_order_relaxed);
+	while (sample > previous && !maximum.compare_exchange_weak(previous, sample, memory_order_relaxed)) {
+	}
+}
+
+namespace Metrics {
+	static mutex mRegistry;
+	static map<string, Metric*> mMetrics;	// sorted, so that snapshots always list things in the same order
+	static vector<metricSampler_t> vSamplers;
+
+	static Cvar* metrics_dump_interval = nullptr;
+	static uint64_t ulLastDump = 0;
+
+	static Metric* Register(const string& name, metricType_e type) {
+		lock_guard<mutex> lock(mRegistry);
+		auto it = mMetrics.find(name);
+		if (it != mMetrics.end()) {
+			if (it->second->type != type) {
+				R_Message(PRIORITY_WARNING, "metric %s was registered again with a different type\n", name.c_str());
+			}
+			return it->second;
+		}
+		Metric* pMetric = new Metric(name, type);
+		mMetrics[name] = pMetric;
+		return pMetric;
+	}
+
+	Metric* Counter(const string& name) {
+		return Register(name, METRIC_COUNTER);
+	}
+
+	Metric* Gauge(const string& name) {
+		return Register(name, METRIC_GAUGE);
+	}
+
+	Metric* Histogram(const string& name) {
+		return Register(name, METRIC_HISTOGRAM);
+	}
+
+	void AddSampler(metricSampler_t sampler) {
+		vSamplers.push_back(sampler);
+	}
+
+	// Every registered metric, in name order. The values are live; samplers aren't run.
+	void GetAll(vector<Metric*>& vOut) {
+		lock_guard<mutex> lock(mRegistry);
+		vOut.clear();
+		for (auto it = mMetrics.begin(); it != mMetrics.end(); ++it) {
+			vOut.push_back(it->second);
+		}
+	}
+
+	void Init() {
+		metrics_dump_interval = Cvar::Get<int>("metrics_dump_interval",
+			"Seconds between metrics snapshots written to " METRICS_SNAPSHOT_FILE " (0 = off)", (1 << CVAR_ARCHIVE), 0);
+	}
+
+	// Whoever cached a metric has to drop the pointer in their own shutdown, which runs before this
+	void Shutdown() {
+		lock_guard<mutex> lock(mRegistry);
+		for (auto it = mMetrics.begin(); it != mMetrics.end(); ++it) {
+			delete it->second;
+		}
+		mMetrics.clear();
+		vSamplers.clear();
+	}
+
+	static void RunSamplers() {
+		for (auto it = vSamplers.begin(); it != vSamplers.end(); ++it) {
+			(*it)();
+		}
+	}
+
+	// Upper edge of the bucket that the given fraction of samples falls into
+	static int64_t HistogramPercentile(Metric* pMetric, int64_t buckets[METRICS_HISTOGRAM_BUCKETS], int64_t count, float fFraction) {
+		int64_t target = (int64_t)ceil(count * fFraction);
+		int64_t seen = 0;
+		for (int i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++) {
+			seen += buckets[i];
+			if (seen >= target && seen > 0) {
+				int64_t edge = i == 0 ? 0 : (((int64_t)1 << i) - 1);
+				int64_t maximum = pMetric->maximum.load(memory_order_relaxed);
+				return edge < maximum ? edge : maximum;
+			}
+		}
+		return pMetric->maximum.load(memory_order_relaxed);
+	}
+
+	static void AppendName(string& out, const string& name) {
+		out += '"';
+		for (auto it = name.begin(); it != name.end(); ++it) {
+			if (*it == '"' || *it == '\\') {
+				out += '\\';
+			}
+			out += *it;
+		}
+		out += "\":";
+	}
+
+	// Histograms start over after being written, so that each line describes only the interval since the last one
+	static void AppendHistogram(string& out, Metric* pMetric) {
+		char buffer[256];
+		int64_t buckets[METRICS_HISTOGRAM_BUCKETS];
+		for (int i = 0; i < METRICS_HISTOGRAM_BUCKETS; i++) {
+			buckets[i] = pMetric->buckets[i].exchange(0, memory_order_relaxed);
+		}
+		int64_t count = pMetric->value.exchange(0, memory_order_relaxed);
+		int64_t sum = pMetric->sum.exchange(0, memory_order_relaxed);
+		Sys_snprintf(buffer, sizeof(buffer), "{\"count\":%lld,\"mean\":%.2f,\"p50\":%lld,\"p95\":%lld,\"p99\":%lld,\"max\":%lld}",
+			(long long)count, count ? (double)sum / count : 0.0,
+			(long long)HistogramPercentile(pMetric, buckets, count, 0.50f),
+			(long long)HistogramPercentile(pMetric, buckets, count, 0.95f),
+			(long long)HistogramPercentile(pMetric, buckets, count, 0.99f),
+			(long long)pMetric->maximum.exchange(0, memory_order_relaxed));
+		out += buffer;
+	}
+
+	void WriteSnapshot() {
+		RunSamplers();
+
+		char buffer[128];
+		string counters, gauges, histograms;
+		{
+			lock_guard<mutex> lock(mRegistry);
+			for (auto it = mMetrics.begin(); it != mMetrics.end(); ++it) {
+				Metric* pMetric = it->second;
+				switch (pMetric->type) {
+					case METRIC_COUNTER:
+					case METRIC_GAUGE:
+						{
+							string& out = pMetric->type == METRIC_COUNTER ? counters : gauges;
+							if (!out.empty()) {
+								out += ',';
+							}
+							AppendName(out, pMetric->sName);
+							Sys_snprintf(buffer, sizeof(buffer), "%lld", (long long)pMetric->value.load(memory_order_relaxed));
+							out += buffer;
+						}
+						break;
+					case METRIC_HISTOGRAM:
+						if (!histograms.empty()) {
+							histograms += ',';
+						}
+						AppendName(histograms, pMetric->sName);
+						AppendHistogram(histograms, pMetric);
+						break;
+				}
+			}
+		}
+
+		Sys_snprintf(buffer, sizeof(buffer), "{\"time\":%lld,\"uptime\":%.3f,\"frame\":%u,",
+			(long long)time(nullptr), Timer::Nanoseconds() / 1000000000.0, RaptureGame::GetFrameNumber());
+		string line = buffer;
+		line += "\"counters\":{" + counters + "},\"gauges\":{" + gauges + "},\"histograms\":{" + histograms + "}}\n";
+
+		File* ptFile = File::OpenSync(METRICS_SNAPSHOT_FILE, "ab");
+		if (ptFile == nullptr) {
+			R_Message(PRIORITY_WARNING, "could not open %s for writing\n", METRICS_SNAPSHOT_FILE);
+			return;
+		}
+		File::WriteSync(ptFile, (void*)line.c_str(), line.length());
+		File::CloseSync(ptFile);
+	}
+
+	// Called by the main thread at the start of every frame
+	void Frame() {
+		if (metrics_dump_interval == nullptr || metrics_dump_interval->Integer() <= 0) {
+			return;
+		}
+		uint64_t ulNow = Timer::Nanoseconds();
+		if (ulLastDump == 0) {
+			ulLastDump = ulNow;	// the first snapshot comes one interval after it was turned on
+			return;
+		}
+		if (ulNow - ulLastDump >= metrics_dump_interval->Integer() * 1000000000ULL) {
+			WriteSnapshot();
+			ulLastDump = ulNow;
+		}
+	}
+
+	// Histograms are only drained by snapshots, so printing leaves them alone
+	void Print() {
+		RunSamplers();
+
+		static const char* typeNames[] = { "counter", "gauge", "histogram" };
+		lock_guard<mutex> lock(mRegistry);
+		R_Message(PRIORITY_MESSAGE, "%-40s %-10s %16s\n", "Metric", "Type", "Value");
+		for (auto it = mMetrics.begin(); it != mMetrics.end(); ++it) {
+			Metric* pMetric = it->second;
+			if (pMetric->type == METRIC_HISTOGRAM) {
+				int64_t count = pMetric->value.load(memory_order_relaxed);
+				R_Message(PRIORITY_MESSAGE, "%-40s %-10s %16lld (mean %.2f, max %lld)\n", pMetric->sName.c_str(), typeNames[pMetric->type],
+					(long long)count, count ? (double)pMetric->sum.load(memory_order_relaxed) / count : 0.0,
+					(long long)pMetric->maximum.load(memory_order_relaxed));
+			}
+			else {
+				R_Message(PRIORITY_MESSAGE, "%-40s %-10s %16lld\n", pMetric->sName.c_str(), typeNames[pMetric->type],
+					(long long)pMetric->value.load(memory_order_relaxed));
+			}
+		}
+	}
+}
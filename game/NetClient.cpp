@@ -2,6 +2,10 @@
 
 namespace Network {
 	namespace Client {
+		// Every connection we make gets a new number, and the network thread tags what it reads with it.
+		// Anything still queued from an older connection (a packet read just before we disconnected) is thrown out.
+		static int connectionNum = 0;
+
 		/*
 			Clientside - Engine packet serialization and deserialization functions
 		*/
@@ -42,7 +46,7 @@ namespace Network {
 				packetSerializationFunc serialFunc = (packetSerializationFunc)callbacks[NIC_CLIENTSERIALIZE];
 				serialFunc(packet, myClientNum, extraData);
 			}
-			if (remoteSocket) {
+			if (bRemoteConnection) {
 				vPacketsAwaitingSend.push_back(make_pair(packet, myClientNum));
 			}
 			else {
@@ -52,6 +56,15 @@ namespace Network {
 
 		// Dispatches a single packet that's been sent to us from the server
 		void DispatchSinglePacket(Packet& packet) {
+			if (Demo::IsPlaying()) {
+				return;	// the demo has the packets
+			}
+			Demo::RecordPacket(packet);
+			DeliverPacket(packet);
+		}
+
+		// Hands a packet from the server to the engine and the gamecode. Demo playback comes in here directly.
+		void DeliverPacket(Packet& packet) {
 			if (dengineFuncs[packet.packetHead.type]) {
 				dengineFuncs[packet.packetHead.type](packet, myClientNum);
 			}
@@ -102,57 +115,40 @@ namespace Network {
 			Actions which are performed every frame.
 			This is significantly less complex than the server process.
 				0. If we're not connected to a server, skip to step #, otherwise...
-				1. Read/deserialize packets, perform logic on what was read
-				2. Write packets from the previous frame
-				3. Check whether we should disconnect from the server 
+				1. Deserialize the packets that the network thread read, perform logic on what was read
+				2. Hand packets from the previous frame to the network thread
+			The network thread decides when the server has gone away (see NetThread.cpp) and tells us so.
 		*/
 		// Run all of the client stuff
 		void Frame() {
-			uint64_t ticks = SDL_GetTicks();
+			Demo::ReplayPackets();
 
 			// Only do this stuff if we're on a remote server
-			if (remoteSocket) {
+			if (bRemoteConnection) {
 				// Read all packets from the server
-				while (remoteSocket->Select()) {
-					Packet packet;
-					if (!remoteSocket->ReadPacket(packet)) {
-						// Close the connection?
-						R_Message(PRIORITY_MESSAGE, "Connection lost.\n");
+				netMessage_t message;
+				while (Thread::ReceiveForClient(message)) {
+					if (message.clientNum != connectionNum) {
+						Thread::FreePacket(message.pPacket);
+						continue;
+					}
+					if (message.type == NETMSG_SERVERLOST) {
 						DisconnectFromRemote();
 						return;
 					}
-					else {
-						DispatchSinglePacket(packet);
-					}
+					serverTraffic.CountIn(*message.pPacket);
+					DispatchSinglePacket(*message.pPacket);
+					Thread::FreePacket(message.pPacket);
 				}
 
 				// Write packets to the server
 				for (auto& message : vPacketsAwaitingSend) {
-
-					if (remoteSocket == nullptr) {
-						Network::Server::DispatchSinglePacket(message.first, myClientNum);
-					}
-					else {
-						remoteSocket->SendPacket(message.first);
-					}
+					Thread::Post(NETMSG_SENDTOSERVER, -1, nullptr, &message.first);
+					serverTraffic.CountOut(message.first);
 				}
 
 				// Clear list of packets that need sent
 				vPacketsAwaitingSend.clear();
-
-				// Check for timeout
-				int msLastHeard = ticks - remoteSocket->lastHeardFrom;
-				int msLastSpoken = ticks - remoteSocket->lastSpoken;
-				if (msLastHeard > net_timeout->Integer()) {
-					// Drop due to timeout
-					R_Message(PRIORITY_MESSAGE, "No response from server in %i milliseconds, dropping...\n", msLastHeard);
-					DisconnectFromRemote();
-				}
-				else if (msLastHeard > net_timeout->Integer() / 2 && msLastSpoken > net_timeout->Integer() / 2) {
-					// Send a PING packet to make sure we're still alive
-					R_Message(PRIORITY_MESSAGE, "No server response in %i milliseconds, pinging...\n", msLastHeard);
-					QueuePacket(PACKET_PING, nullptr);
-				}
 			}
 
 			// Run gamecode frame
@@ -168,12 +164,16 @@ namespace Network {
 		// Don't call this directly, call JoinServer instead
 		bool ConnectToRemote(const char* hostname, int port) {
 			DisconnectFromRemote();
-			remoteSocket = new Socket(net_ipv6->Bool() ? AF_INET6 : AF_INET, SOCK_STREAM);
+			Socket* pSocket = Socket::Create(net_ipv6->Bool() ? AF_INET6 : AF_INET);
 
-			bool connected = remoteSocket->Connect(hostname, port);
-			if (!connected) {
-				delete remoteSocket;
-				remoteSocket = nullptr;
+			// Connecting happens here, so that we know right away if it failed; then the network thread takes it
+			bool connected = pSocket->Connect(hostname, port);
+			if (connected) {
+				Thread::Post(NETMSG_CONNECTED, ++connectionNum, pSocket, nullptr);
+				bRemoteConnection = true;
+			}
+			else {
+				delete pSocket;
 			}
 			currentNetState = Netstate_NeedAuth;
 			return connected;
@@ -208,9 +208,15 @@ namespace Network {
 				// Not connected in the first place
 				return;
 			}
-			if (remoteSocket != nullptr) {
-				delete remoteSocket;
-				remoteSocket = nullptr;
+			if (bRemoteConnection) {
+				Thread::Post(NETMSG_DISCONNECT, -1, nullptr, nullptr);
+				bRemoteConnection = false;
+
+				// Whatever's left is from the connection we just closed
+				netMessage_t message;
+				while (Thread::ReceiveForClient(message)) {
+					Thread::FreePacket(message.pPacket);
+				}
 			}
 			if (callbacks[NIC_EXIT]) {
 				callbacks[NIC_EXIT](nullptr);
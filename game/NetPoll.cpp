@@ -0,0 +1,130 @@
+#include "sys_local.h"
+
+// The engine only builds for Windows right now, so the epoll path has never been compiled, let alone run.
+// It stays out unless a Linux build asks for it with RAPTURE_EPOLL; otherwise every socket is polled the old way.
+#if defined(__linux__) && defined(RAPTURE_EPOLL)
+#define NETPOLL_EPOLL
+#endif
+
+#ifdef NETPOLL_EPOLL
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Keeps track of which of the server's sockets might have something waiting, so that a pass where nobody sent anything
+ * doesn't cost a select() per client. With NETPOLL_EPOLL, the listening socket, temporary connections and clients all go
+ * into one edge-triggered epoll set that the network thread waits on once a pass. An edge only comes once, so a socket
+ * stays ready until whoever reads it finds that Select has run dry and says so with Drained.
+ * Only the network thread touches any of this.
+ * Sockets that were never added (no epoll, or a UDP peer that shares its listener's descriptor) always count as ready,
+ * which is the same as polling them the old way.
+ */
+
+namespace Network {
+	namespace Poll {
+		static unordered_map<Socket*, bool> umSockets;	// everything that's been added, and whether it might be readable
+#ifdef NETPOLL_EPOLL
+		static int epollHandle = -1;
+#endif
+
+		void Init() {
+#ifdef NETPOLL_EPOLL
+			epollHandle = epoll_create1(EPOLL_CLOEXEC);
+			if (epollHandle < 0) {
+				R_Message(PRIORITY_WARNING, "epoll_create1 failed (%s), every socket will be polled individually\n", strerror(errno));
+			}
+#endif
+		}
+
+		void Shutdown() {
+#ifdef NETPOLL_EPOLL
+			if (epollHandle >= 0) {
+				close(epollHandle);
+				epollHandle = -1;
+			}
+#endif
+			umSockets.clear();
+		}
+
+		void Add(Socket* pSocket) {
+#ifdef NETPOLL_EPOLL
+			socket_t handle = pSocket->PollHandle();
+			if (epollHandle < 0 || handle == INVALID_SOCKET || umSockets.find(pSocket) != umSockets.end()) {
+				return;
+			}
+
+			epoll_event event;
+			event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+			event.data.ptr = pSocket;
+			if (epoll_ctl(epollHandle, EPOLL_CTL_ADD, handle, &event) != 0) {
+				R_Message(PRIORITY_WARNING, "epoll_ctl failed to add a socket (%s), it will be polled individually\n", strerror(errno));
+				return;
+			}
+			umSockets[pSocket] = true;	// anything that came in before it was added won't get an edge of its own
+#endif
+		}
+
+		// Called right before a socket is destroyed
+		void Remove(Socket* pSocket) {
+			auto it = umSockets.find(pSocket);
+			if (it == umSockets.end()) {
+				return;
+			}
+#ifdef NETPOLL_EPOLL
+			epoll_ctl(epollHandle, EPOLL_CTL_DEL, pSocket->PollHandle(), nullptr);
+#endif
+			umSockets.erase(it);
+		}
+
+		// Sockets that are still marked ready have something to read right now, so there's no waiting for the rest
+		static bool AnyReady() {
+			for (auto it = umSockets.begin(); it != umSockets.end(); ++it) {
+				if (it->second) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// Waits up to msTimeout for something to become readable, and marks whatever did.
+		// Without epoll (or with nothing in the set), this just sleeps.
+		void Wait(int msTimeout) {
+#ifdef NETPOLL_EPOLL
+			if (epollHandle >= 0 && !umSockets.empty()) {
+				epoll_event events[NETPOLL_MAXEVENTS];
+				int numEvents = epoll_wait(epollHandle, events, NETPOLL_MAXEVENTS, AnyReady() ? 0 : msTimeout);
+				while (numEvents > 0) {
+					for (int i = 0; i < numEvents; i++) {
+						auto it = umSockets.find((Socket*)events[i].data.ptr);
+						if (it != umSockets.end()) {
+							it->second = true;
+						}
+					}
+					if (numEvents < NETPOLL_MAXEVENTS) {
+						break;
+					}
+					numEvents = epoll_wait(epollHandle, events, NETPOLL_MAXEVENTS, 0);
+				}
+				return;
+			}
+#endif
+			if (msTimeout > 0) {
+				this_thread::sleep_for(chrono::milliseconds(msTimeout));
+			}
+		}
+
+		bool IsReady(Socket* pSocket) {
+			auto it = umSockets.find(pSocket);
+			return it == umSockets.end() || it->second;
+		}
+
+		// Select came back false, so there won't be anything more until the next edge
+		void Drained(Socket* pSocket) {
+			auto it = umSockets.find(pSocket);
+			if (it != umSockets.end()) {
+				it->second = false;
+			}
+		}
+	}
+}
@@ -0,0 +1,482 @@
+#include "sys_local.h"
+#include <concurrentqueue.h>
+
+/*
+ * The network thread owns every socket that the engine hosts or plays with: the local (listening) socket, temporary
+ * connections, the server's clients and the connection to a remote server. It accepts, reads, pings and times them out
+ * on its own, and trades whole packets with the game thread over lock-free queues, so that slow clients and big sends
+ * don't come out of the frame:
+ *	game -> network		qOutgoing, drained at the start of every pass
+ *	network -> server	qServerIncoming, drained by Server::Frame
+ *	network -> client	qClientIncoming, drained by Client::Frame
+ * Each queue has one thread putting messages in and one taking them out, so everything stays in order.
+ * Sends don't block this thread either; whatever a socket can't take yet is flushed on the next pass.
+ * Packets ride along as pointers into a pool, so a message is only a few words no matter how big its packet is.
+ * The game thread still makes the sockets (so that a connect can fail right away), but hands them over once they're made.
+ */
+
+namespace Network {
+	namespace Thread {
+		using namespace moodycamel;
+		static ConcurrentQueue<netMessage_t> qOutgoing(NET_QUEUE_CAPACITY);
+		static ConcurrentQueue<netMessage_t> qServerIncoming(NET_QUEUE_CAPACITY);
+		static ConcurrentQueue<netMessage_t> qClientIncoming(NET_QUEUE_CAPACITY);
+
+		// Leaked on purpose: packets can still be in flight when the statics go away
+		static ObjectPool<Packet>& packetPool = *new ObjectPool<Packet>("Packet", NET_QUEUE_CAPACITY);
+
+		static thread* pNetworkThread = nullptr;
+		static atomic<bool> bRunning(false);
+
+		// Listen requests are answered in order, so the game thread knows its answer is in once enough have come back
+		static int listenRequests = 0;				// only touched by the game thread
+		static atomic<int> listenReplies(0);
+		static atomic<bool> bListenSucceeded(false);
+
+		static Metric* pMetricOutgoing = nullptr;
+		static Metric* pMetricIncoming = nullptr;
+		static Metric* pMetricPassTime = nullptr;
+
+		// Everything from here on is only touched by the network thread
+		static Socket* pLocalSocket = nullptr;
+		static Socket* pRemoteSocket = nullptr;
+		static int remoteConnection = -1;	// what the client numbered pRemoteSocket; everything read from it is tagged with this
+		static map<int, Socket*> mClientSockets;
+		static vector<Socket*> vTemporaryConnections;
+		static int nextClientNum = 1;
+		static Packet scratchPacket;		// temporary connections are read into this, since nothing gets queued from them
+
+
+		/*
+			Queues
+		*/
+
+		static Packet* AllocPacket() {
+			return (Packet*)packetPool.AllocateObject(sizeof(Packet));
+		}
+
+		void FreePacket(Packet* pPacket) {
+			packetPool.Free(pPacket);
+		}
+
+		// Queues a packet that's already in the pool; the queue owns it from here on
+		static void EnqueuePooled(ConcurrentQueue<netMessage_t>& queue, netMessageType_e type, int clientNum, Packet* pPacket) {
+			netMessage_t message;
+			message.type = type;
+			message.clientNum = clientNum;
+			message.pSocket = nullptr;
+			message.pPacket = pPacket;
+			queue.enqueue(message);
+		}
+
+		// Only copies as much of the packet as is actually used
+		static void Enqueue(ConcurrentQueue<netMessage_t>& queue, netMessageType_e type, int clientNum, Socket* pSocket, const Packet* pPacket) {
+			netMessage_t message;
+			message.type = type;
+			message.clientNum = clientNum;
+			message.pSocket = pSocket;
+			message.pPacket = nullptr;
+			if (pPacket != nullptr) {
+				message.pPacket = AllocPacket();
+				message.pPacket->packetHead = pPacket->packetHead;
+				memcpy(message.pPacket->packetData, pPacket->packetData, pPacket->packetHead.packetSize);
+			}
+			queue.enqueue(message);
+		}
+
+		// Hands something to the network thread. Called by the game thread.
+		void Post(netMessageType_e type, int clientNum, Socket* pSocket, const Packet* pPacket) {
+			Enqueue(qOutgoing, type, clientNum, pSocket, pPacket);
+		}
+
+		// Hands pSocket over to be listened on, and waits until the network thread says whether that worked
+		bool Listen(Socket* pSocket) {
+			if (pNetworkThread == nullptr) {
+				R_Message(PRIORITY_ERROR, "Can't listen, the network thread isn't running\n");
+				delete pSocket;
+				return false;
+			}
+
+			int request = ++listenRequests;
+			Post(NETMSG_LISTEN, -1, pSocket, nullptr);
+			uint64_t ulStart = SDL_GetTicks();
+			while (listenReplies.load(memory_order_acquire) < request) {
+				if (SDL_GetTicks() - ulStart > NET_LISTEN_TIMEOUT) {
+					R_Message(PRIORITY_ERROR, "The network thread didn't start listening within %i milliseconds\n", NET_LISTEN_TIMEOUT);
+					return false;
+				}
+				this_thread::sleep_for(chrono::milliseconds(1));
+			}
+			return bListenSucceeded.load(memory_order_acquire);
+		}
+
+		bool ReceiveForServer(netMessage_t& message) {
+			return qServerIncoming.try_dequeue(message);
+		}
+
+		bool ReceiveForClient(netMessage_t& message) {
+			return qClientIncoming.try_dequeue(message);
+		}
+
+		static void SampleMetrics() {
+			pMetricOutgoing->Set(qOutgoing.size_approx());
+			pMetricIncoming->Set(qServerIncoming.size_approx() + qClientIncoming.size_approx());
+		}
+
+
+		/*
+			The network thread
+		*/
+
+		static void CloseSocket(Socket* pSocket) {
+			Poll::Remove(pSocket);
+			delete pSocket;
+		}
+
+		// A socket that couldn't listen is closed right away, instead of being polled for connections that can't come
+		static void StartLocalSocket(Socket* pSocket) {
+			if (pLocalSocket != nullptr) {
+				CloseSocket(pLocalSocket);
+			}
+			pLocalSocket = pSocket;
+			bool bListening = pLocalSocket->StartListening(net_port->AtomicInteger(), net_serverbacklog->AtomicInteger());
+			if (bListening) {
+				Poll::Add(pLocalSocket);
+			}
+			else {
+				CloseSocket(pLocalSocket);
+				pLocalSocket = nullptr;
+			}
+
+			bListenSucceeded.store(bListening, memory_order_release);
+			listenReplies.fetch_add(1, memory_order_release);
+		}
+
+		// Does whatever the game thread asked for since the last pass
+		static void ProcessOutgoing() {
+			netMessage_t message;
+			while (qOutgoing.try_dequeue(message)) {
+				switch (message.type) {
+					case NETMSG_LISTEN:
+						StartLocalSocket(message.pSocket);
+						break;
+					case NETMSG_CONNECTED:
+						if (pRemoteSocket != nullptr) {
+							CloseSocket(pRemoteSocket);
+						}
+						pRemoteSocket = message.pSocket;
+						remoteConnection = message.clientNum;
+						Poll::Add(pRemoteSocket);
+						break;
+					case NETMSG_DISCONNECT:
+						if (pRemoteSocket != nullptr) {
+							CloseSocket(pRemoteSocket);
+							pRemoteSocket = nullptr;
+						}
+						break;
+					case NETMSG_SENDTOCLIENT:
+						if (message.clientNum == -1) {
+							for (auto it = mClientSockets.begin(); it != mClientSockets.end(); ++it) {
+								it->second->SendPacket(*message.pPacket);
+							}
+						}
+						else {
+							// The client might have dropped since the packet was queued
+							auto found = mClientSockets.find(message.clientNum);
+							if (found != mClientSockets.end()) {
+								found->second->SendPacket(*message.pPacket);
+							}
+						}
+						break;
+					case NETMSG_SENDTOSERVER:
+						if (pRemoteSocket != nullptr) {
+							pRemoteSocket->SendPacket(*message.pPacket);
+						}
+						break;
+				}
+				FreePacket(message.pPacket);
+			}
+		}
+
+		// Check for new incoming temporary connections
+		static void CheckTemporaryConnections(uint64_t ticks) {
+			// vTemporaryConnections contains a list of sockets that are not validated as clients.
+			// When they are validated as clients (or time out) the sockets are destroyed.
+			// Here we are polling the local socket to see if there are any temporary connections awaiting acceptance
+			Packet genericPongPacket{ { PACKET_PONG, ticks, 0 }, { 0 } };
+			Packet outPacket{ { PACKET_PING, 0 }, { 0 } };
+
+			// Check for a new incoming temporary connection
+			if (pLocalSocket != nullptr && Poll::IsReady(pLocalSocket)) {
+				if (pLocalSocket->Select()) {
+					Socket* newConnection = pLocalSocket->CheckPendingConnections();
+					if (newConnection != nullptr) {
+						vTemporaryConnections.push_back(newConnection);
+						Poll::Add(newConnection);
+					}
+				}
+				else {
+					Poll::Drained(pLocalSocket);
+				}
+			}
+
+			// Iterate through each temporary connection
+			for (auto it = vTemporaryConnections.begin(); it != vTemporaryConnections.end();) {
+				Socket* pSocket = *it;
+				bool bNewClient = false;
+				bool bDeadSocket = false;
+				int msLastHeard;
+
+				while (!bNewClient && Poll::IsReady(pSocket)) {
+					if (!pSocket->Select()) {
+						Poll::Drained(pSocket);
+						break;
+					}
+
+					if (!pSocket->ReadPacket(scratchPacket)) {
+						bDeadSocket = true;
+						break;
+					}
+
+					switch (scratchPacket.packetHead.type) {
+						case PACKET_PING:
+							pSocket->SendPacket(genericPongPacket);
+							break;
+						case PACKET_CLIENTATTEMPT:
+						{
+							if (true) {	// FIXME
+								//
+								// <<<CLIENT CONNECTED>>
+								//
+								outPacket.packetHead.sendTime = 0; // FIXME
+								outPacket.packetHead.type = PACKET_CLIENTACCEPT;
+								outPacket.packetHead.packetSize = 0; // FIXME
+
+								mClientSockets[nextClientNum] = pSocket;
+								Enqueue(qServerIncoming, NETMSG_CLIENTCONNECTED, nextClientNum, nullptr, nullptr);
+
+								R_Message(PRIORITY_MESSAGE, "ClientAccept: %i\n", nextClientNum++);
+								bNewClient = true;
+							}
+							else {
+								//
+								// <<<CLIENT BLOCKED>>>
+								//
+								outPacket.packetHead.sendTime = 0; // FIXME
+								outPacket.packetHead.type = PACKET_CLIENTDENIED;
+								outPacket.packetHead.packetSize = 0; // FIXME
+								R_Message(PRIORITY_MESSAGE, "ClientDenied --\n");
+							}
+							pSocket->SendPacket(outPacket);
+						}
+						break;
+					}
+				}
+
+				if (!bDeadSocket && !bNewClient && !pSocket->FlushSends()) {
+					bDeadSocket = true;
+				}
+
+				if (bDeadSocket || bNewClient) {
+					// If it's not readable, then it died
+					// If it's a new client then we should erase it too (it stays in the poll, as a client now)
+					it = vTemporaryConnections.erase(it);
+					if (bDeadSocket) {
+						CloseSocket(pSocket);
+					}
+					continue;
+				}
+
+				// Check temporary connection for timeout
+				msLastHeard = ticks - pSocket->lastHeardFrom;
+				if (msLastHeard > net_timeout->AtomicInteger()) {
+					R_Message(PRIORITY_MESSAGE, "Closing temporary connection due to timeout\n");
+					it = vTemporaryConnections.erase(it);
+					CloseSocket(pSocket);
+				}
+				else {
+					it++;
+				}
+			}
+		}
+
+		// Reads whatever the clients sent, and drops the ones that closed or have been quiet for too long
+		static void ReadClients(uint64_t ticks) {
+			int msTimeout = net_timeout->AtomicInteger();
+			for (auto it = mClientSockets.begin(); it != mClientSockets.end();) {
+				int clientNum = it->first;
+				Socket* pSocket = it->second;
+				bool bClientDropped = false;
+
+				// Read packets, if there are any
+				while (Poll::IsReady(pSocket)) {
+					if (!pSocket->Select()) {
+						Poll::Drained(pSocket);
+						break;
+					}
+
+					// Read straight into a pooled packet, so that queueing it doesn't copy anything
+					Packet* pPacket = AllocPacket();
+					if (!pSocket->ReadPacket(*pPacket)) {
+						FreePacket(pPacket);
+						R_Message(PRIORITY_MESSAGE, "Client %i dropped.\n", clientNum);
+						bClientDropped = true;
+						break;
+					}
+					EnqueuePooled(qServerIncoming, NETMSG_CLIENTPACKET, clientNum, pPacket);
+				}
+
+				// See if we need to drop the client for timeout
+				if (!bClientDropped) {
+					int msReceivedDifference = ticks - pSocket->lastHeardFrom;
+					int msSentDifference = ticks - pSocket->lastSpoken;
+					if (msReceivedDifference > msTimeout) {
+						R_Message(PRIORITY_MESSAGE, "Dropped %i due to timeout.\n", clientNum);
+						bClientDropped = true;
+					}
+					else if (msReceivedDifference > msTimeout / 2 && msSentDifference >= msTimeout / 2) {
+						// Pings go out from here, rather than through the gamecode, so a busy game thread can't hold them up
+						R_Message(PRIORITY_MESSAGE, "Haven't heard anything from %i in a while, pinging...\n", clientNum);
+						Packet pingPacket{ { PACKET_PING, ticks, 0 }, { 0 } };
+						pSocket->SendPacket(pingPacket);
+					}
+				}
+
+				// Whatever didn't go out on the last pass; a client that lets too much pile up is as good as gone
+				if (!bClientDropped && !pSocket->FlushSends()) {
+					R_Message(PRIORITY_MESSAGE, "Dropped %i, it isn't keeping up with what we send.\n", clientNum);
+					bClientDropped = true;
+				}
+
+				// Remove the client from client list if they dropped
+				if (bClientDropped) {
+					Enqueue(qServerIncoming, NETMSG_CLIENTDROPPED, clientNum, nullptr, nullptr);
+					it = mClientSockets.erase(it);
+					CloseSocket(pSocket);
+				}
+				else {
+					++it;
+				}
+			}
+		}
+
+		// Reads whatever the remote server sent, and gives up on it if it closed or has been quiet for too long
+		static void ReadRemote(uint64_t ticks) {
+			if (pRemoteSocket == nullptr) {
+				return;
+			}
+
+			// Always selected, even when the poll has nothing for it, since a UDP socket resends from Select
+			bool bLost = false;
+			while (pRemoteSocket->Select()) {
+				Packet* pPacket = AllocPacket();
+				if (!pRemoteSocket->ReadPacket(*pPacket)) {
+					FreePacket(pPacket);
+					R_Message(PRIORITY_MESSAGE, "Connection lost.\n");
+					bLost = true;
+					break;
+				}
+				EnqueuePooled(qClientIncoming, NETMSG_SERVERPACKET, remoteConnection, pPacket);
+			}
+
+			// Check for timeout
+			if (!bLost) {
+				Poll::Drained(pRemoteSocket);
+				int msTimeout = net_timeout->AtomicInteger();
+				int msLastHeard = ticks - pRemoteSocket->lastHeardFrom;
+				int msLastSpoken = ticks - pRemoteSocket->lastSpoken;
+				if (msLastHeard > msTimeout) {
+					R_Message(PRIORITY_MESSAGE, "No response from server in %i milliseconds, dropping...\n", msLastHeard);
+					bLost = true;
+				}
+				else if (msLastHeard > msTimeout / 2 && msLastSpoken > msTimeout / 2) {
+					// Send a PING packet to make sure we're still alive
+					R_Message(PRIORITY_MESSAGE, "No server response in %i milliseconds, pinging...\n", msLastHeard);
+					Packet pingPacket{ { PACKET_PING, ticks, 0 }, { 0 } };
+					pRemoteSocket->SendPacket(pingPacket);
+				}
+			}
+			if (!bLost && !pRemoteSocket->FlushSends()) {
+				R_Message(PRIORITY_MESSAGE, "Couldn't send to the server, dropping...\n");
+				bLost = true;
+			}
+
+			if (bLost) {
+				Enqueue(qClientIncoming, NETMSG_SERVERLOST, remoteConnection, nullptr, nullptr);
+				CloseSocket(pRemoteSocket);
+				pRemoteSocket = nullptr;
+			}
+		}
+
+		static void CloseAll() {
+			for (auto it = vTemporaryConnections.begin(); it != vTemporaryConnections.end(); ++it) {
+				CloseSocket(*it);
+			}
+			vTemporaryConnections.clear();
+			for (auto it = mClientSockets.begin(); it != mClientSockets.end(); ++it) {
+				CloseSocket(it->second);
+			}
+			mClientSockets.clear();
+			if (pRemoteSocket != nullptr) {
+				CloseSocket(pRemoteSocket);
+				pRemoteSocket = nullptr;
+			}
+			if (pLocalSocket != nullptr) {
+				CloseSocket(pLocalSocket);
+				pLocalSocket = nullptr;
+			}
+		}
+
+		/* What the network thread is running */
+		static void NetworkThread() {
+			Profiler::SetThreadName("Network");
+			while (bRunning.load(memory_order_acquire)) {
+				uint64_t ulStart = Timer::Nanoseconds();
+				uint64_t ticks = SDL_GetTicks();
+
+				ProcessOutgoing();
+				CheckTemporaryConnections(ticks);
+				ReadClients(ticks);
+				ReadRemote(ticks);
+				pMetricPassTime->Record((Timer::Nanoseconds() - ulStart) / 1000);
+
+				// Sleeps until something comes in, or for net_threadsleep at most (so that packets from the game go out)
+				Poll::Wait(net_threadsleep->AtomicInteger());
+			}
+
+			// Send off anything that was still waiting, then close everything
+			ProcessOutgoing();
+			CloseAll();
+			Profiler::ExitThread();
+		}
+
+		void Init() {
+			pMetricOutgoing = Metrics::Gauge("net.queue.outgoing");
+			pMetricIncoming = Metrics::Gauge("net.queue.incoming");
+			pMetricPassTime = Metrics::Histogram("net.thread.pass_us");
+			Metrics::AddSampler(SampleMetrics);
+
+			bRunning.store(true, memory_order_release);
+			pNetworkThread = new thread(NetworkThread);
+		}
+
+		void Shutdown() {
+			if (pNetworkThread == nullptr) {
+				return;
+			}
+			bRunning.store(false, memory_order_release);
+			pNetworkThread->join();
+			delete pNetworkThread;
+			pNetworkThread = nullptr;
+
+			// Nobody is going to read these now
+			netMessage_t message;
+			while (qServerIncoming.try_dequeue(message)) {
+				FreePacket(message.pPacket);
+			}
+			while (qClientIncoming.try_dequeue(message)) {
+				FreePacket(message.pPacket);
+			}
+		}
+	}
+}
@@ -8,22 +8,105 @@ namespace Network {
 	Cvar*				net_netmode = nullptr;
 	Cvar*				net_timeout = nullptr;
 	Cvar*				net_ipv6 = nullptr;
+	Cvar*				net_transport = nullptr;
+	Cvar*				net_threadsleep = nullptr;
 
-	Socket*				localSocket = nullptr;
-	map<int, Socket*>	mOtherConnectedClients;
-	Socket*				remoteSocket = nullptr;
+	set<int>			sOtherConnectedClients;
+	bool				bRemoteConnection = false;
 	vector<packetMsg>	vPacketsAwaitingSend;
 	Netstate_e			currentNetState = Netstate_NoConnect;
-	vector<Socket*>		vTemporaryConnections;
 
 	int			numConnectedClients = 1;
 	int			myClientNum = 0;				// Client 0 is always the host
 	int			lastFreeClientNum = 1;
 	networkCallbackFunction	callbacks[NIC_MAX] {nullptr};
 
+	// The channel that each packet type goes over, when it goes over UDP
+	static const netChannel_e defaultPacketChannels[PACKET_MAX] = {
+		CHANNEL_RELIABLE_UNORDERED,		// PACKET_PING
+		CHANNEL_RELIABLE_UNORDERED,		// PACKET_PONG
+		CHANNEL_RELIABLE_ORDERED,		// PACKET_DROP
+		CHANNEL_RELIABLE_ORDERED,		// PACKET_CLIENTATTEMPT
+		CHANNEL_RELIABLE_ORDERED,		// PACKET_CLIENTACCEPT
+		CHANNEL_RELIABLE_ORDERED,		// PACKET_CLIENTDENIED
+		CHANNEL_RELIABLE_UNORDERED,		// PACKET_INFOREQUEST
+		CHANNEL_RELIABLE_UNORDERED,		// PACKET_INFOREQUESTED
+		CHANNEL_RELIABLE_ORDERED,		// PACKET_SENDCHAT
+		CHANNEL_RELIABLE_ORDERED,		// PACKET_RECVCHAT
+	};
+	// Gamecode changes these on the game thread, the network thread reads them when it sends
+	static atomic<uint8_t> packetChannels[PACKET_MAX];
+
+	/* Metrics */
+	trafficMetrics_t	serverTraffic;
+	static map<int, size_t>				mClientTrafficSlots;	// client number -> index into vClientTraffic
+	static vector<trafficMetrics_t>		vClientTraffic;
+	static vector<size_t>				vFreeTrafficSlots;
+	static Metric*		pMetricClients = nullptr;
+
+	// Size of a packet on the wire; the header fields are sent one by one, so padding doesn't count
+	static int64_t WireSize(const Packet& packet) {
+		return sizeof(packet.packetHead.type) + sizeof(packet.packetHead.sendTime) + sizeof(packet.packetHead.packetSize)
+			+ packet.packetHead.packetSize;
+	}
+
+	void trafficMetrics_t::CountIn(const Packet& packet) {
+		pPacketsIn->Add(1);
+		pBytesIn->Add(WireSize(packet));
+	}
+
+	void trafficMetrics_t::CountOut(const Packet& packet) {
+		pPacketsOut->Add(1);
+		pBytesOut->Add(WireSize(packet));
+	}
+
+	static trafficMetrics_t RegisterTraffic(const string& prefix) {
+		trafficMetrics_t traffic;
+		traffic.pPacketsIn = Metrics::Counter(prefix + ".packets_in");
+		traffic.pBytesIn = Metrics::Counter(prefix + ".bytes_in");
+		traffic.pPacketsOut = Metrics::Counter(prefix + ".packets_out");
+		traffic.pBytesOut = Metrics::Counter(prefix + ".bytes_out");
+		return traffic;
+	}
+
+	// Client numbers are never reused, so the counters go by slot instead: a client takes over the slot of one
+	// that has dropped (its totals carry on from there), and new counters only get made when every slot is taken.
+	trafficMetrics_t& ClientTraffic(int clientNum) {
+		auto it = mClientTrafficSlots.find(clientNum);
+		if (it != mClientTrafficSlots.end()) {
+			return vClientTraffic[it->second];
+		}
+		size_t slot;
+		if (!vFreeTrafficSlots.empty()) {
+			slot = vFreeTrafficSlots.back();
+			vFreeTrafficSlots.pop_back();
+		}
+		else {
+			char prefix[32];
+			slot = vClientTraffic.size();
+			Sys_snprintf(prefix, sizeof(prefix), "net.client%i", (int)slot);
+			vClientTraffic.push_back(RegisterTraffic(prefix));
+		}
+		mClientTrafficSlots[clientNum] = slot;
+		return vClientTraffic[slot];
+	}
+
+	void ReleaseClientTraffic(int clientNum) {
+		auto it = mClientTrafficSlots.find(clientNum);
+		if (it == mClientTrafficSlots.end()) {
+			return;
+		}
+		vFreeTrafficSlots.push_back(it->second);
+		mClientTrafficSlots.erase(it);
+	}
+
+	static void SampleMetrics() {
+		pMetricClients->Set(numConnectedClients);
+	}
+
 	void Netmode_Callback(int newValue) {
 		/*if (newValue == Netmode_Red) {
-			mOtherConnectedClients.clear();
+			sOtherConnectedClients.clear();
 			numConnectedClients = 1;
 		}*/
 	}
@@ -31,28 +114,56 @@ namespace Network {
 	// Initialize the network
 	void Init() {
 		Zone::NewTag("network");
-		net_port = Cvar::Get<int>("net_port", "Port used for networking (TCP)", (1 << CVAR_ARCHIVE), RAPTURE_DEFAULT_PORT);
+		net_port = Cvar::Get<int>("net_port", "Port used for networking (TCP or UDP, see net_transport)", (1 << CVAR_ARCHIVE), RAPTURE_DEFAULT_PORT);
 		net_serverbacklog
 			= Cvar::Get<int>("net_serverbacklog", "Maximum number of waiting connections for the server", (1 << CVAR_ARCHIVE), RAPTURE_DEFAULT_BACKLOG);
 		net_maxclients = Cvar::Get<int>("net_maxclients", "Maximum number of clients allowed on server", (1 << CVAR_ROM) | (1 << CVAR_ARCHIVE), RAPTURE_DEFAULT_MAXCLIENTS);
 		net_netmode = Cvar::Get<int>("net_netmode", "Current netmode", 0, Netmode_Red);
 		net_timeout = Cvar::Get<int>("net_timeout", "Timeout duration, in milliseconds", 0, 90000);
 		net_ipv6 = Cvar::Get<bool>("net_ipv6", "Whether to use IPv6 addresses", (1 << CVAR_ARCHIVE), false);
+		net_transport = Cvar::Get<char*>("net_transport", "Transport that connections use (tcp or udp); takes effect on the next connect or server start", (1 << CVAR_ARCHIVE), "tcp");
+		net_threadsleep = Cvar::Get<int>("net_threadsleep", "Longest the network thread waits for something to happen, in milliseconds", (1 << CVAR_ARCHIVE), 1);
 
 		net_netmode->AddCallback(Netmode_Callback);
+		for (int i = 0; i < PACKET_MAX; i++) {
+			packetChannels[i].store(defaultPacketChannels[i], memory_order_relaxed);
+		}
 		Sys_InitSockets();
+		Poll::Init();
 
-		// Create a local socket so we can serve as the host later
-		localSocket = new Socket(net_ipv6->Bool() ? AF_INET6 : AF_INET, SOCK_STREAM);
+		serverTraffic = RegisterTraffic("net.server");
+		pMetricClients = Metrics::Gauge("net.clients");
+		Metrics::AddSampler(SampleMetrics);
+
+		// Sockets for hosting and for connecting to other servers are made when they're needed, and handed to this thread
+		Thread::Init();
 	}
 
 	// Shut down the network, delete the local socket, disconnect any clients, etc.
 	void Shutdown() {
-		delete localSocket;
-
+		Thread::Shutdown();
+		Poll::Shutdown();
 		Sys_ExitSockets();
 	}
 
+	// SOCK_DGRAM if net_transport asks for UDP, otherwise SOCK_STREAM
+	int TransportSocketType() {
+		return !stricmp(net_transport->String(), "udp") ? SOCK_DGRAM : SOCK_STREAM;
+	}
+
+	netChannel_e PacketChannel(uint32_t packetType) {
+		return packetType < PACKET_MAX ? (netChannel_e)packetChannels[packetType].load(memory_order_relaxed) : CHANNEL_RELIABLE_ORDERED;
+	}
+
+	// Lets gamecode put packets that are replaced by the next one (such as game state) on CHANNEL_UNRELIABLE_SEQUENCED
+	void SetPacketChannel(packetType_e packetType, netChannel_e channel) {
+		if (packetType >= PACKET_MAX || channel >= CHANNEL_MAX) {
+			R_Message(PRIORITY_WARNING, "SetPacketChannel: bad packet type %i or channel %i\n", packetType, channel);
+			return;
+		}
+		packetChannels[packetType].store((uint8_t)channel, memory_order_relaxed);
+	}
+
 	// Determine if the local server is full.
 	bool LocalServerFull() {
 		return numConnectedClients >= net_maxclients->Integer();
@@ -0,0 +1,140 @@
+#include "sys_local.h"
+#include <math.h>
+
+/*
+ * Keeps the last PERF_WINDOW frame times, along with how long each phase of RaptureGame::RunLoop took,
+ * and summarizes them as average/percentiles/max. Only the main thread touches any of this.
+ */
+
+namespace PerfStats {
+	static const char* phaseNames[PERF_MAX] = {
+		"Input",
+		"UI::Update",
+		"Cmd::ExecuteBuffer",
+		"Video::ClearFrame",
+		"Server::Frame",
+		"Client::Frame",
+		"UI::Render",
+		"Video::RenderFrame",
+	};
+
+	// Milliseconds, in a ring that wraps around at PERF_WINDOW
+	static float fFrameTimes[PERF_WINDOW];
+	static float fPhaseTimes[PERF_MAX][PERF_WINDOW];
+	static unsigned int uHead = 0;
+	static unsigned int uCount = 0;
+
+	static uint64_t ulLastBoundary = 0;
+	static uint64_t ulCurrentPhases[PERF_MAX];	// nanoseconds spent in each phase this frame
+
+	static CvarRef<int> com_hitch = CVAR_REF(int, "com_hitch");
+
+	const char* PhaseName(perfPhase_e phase) {
+		return phaseNames[phase];
+	}
+
+	void AddPhaseTime(perfPhase_e phase, uint64_t ulNanoseconds) {
+		ulCurrentPhases[phase] += ulNanoseconds;
+	}
+
+	// Called at the start of every frame; the time since the last call is the length of the frame, pacing included
+	void FrameBoundary() {
+		uint64_t ulNow = Timer::Nanoseconds();
+		if (ulLastBoundary != 0) {
+			fFrameTimes[uHead] = (ulNow - ulLastBoundary) / 1000000.0f;
+			for (int i = 0; i < PERF_MAX; i++) {
+				fPhaseTimes[i][uHead] = ulCurrentPhases[i] / 1000000.0f;
+			}
+			uHead = (uHead + 1) % PERF_WINDOW;
+			if (uCount < PERF_WINDOW) {
+				uCount++;
+			}
+		}
+		memset(ulCurrentPhases, 0, sizeof(ulCurrentPhases));
+		ulLastBoundary = ulNow;
+	}
+
+	void Reset() {
+		uHead = uCount = 0;
+		ulLastBoundary = 0;
+		memset(ulCurrentPhases, 0, sizeof(ulCurrentPhases));
+	}
+
+	// Nearest-rank percentile. Reorders the samples.
+	static float Percentile(float* fSorted, unsigned int uNumSamples, float fPercent) {
+		unsigned int uRank = (unsigned int)ceil(fPercent * uNumSamples / 100.0f);
+		if (uRank > 0) {
+			uRank--;
+		}
+		if (uRank >= uNumSamples) {
+			uRank = uNumSamples - 1;
+		}
+		nth_element(fSorted, fSorted + uRank, fSorted + uNumSamples);
+		return fSorted[uRank];
+	}
+
+	// Works on any run of samples, not just the window (timedemo uses it for the whole demo). Reorders the samples.
+	void SummarizeSamples(float* fSamples, unsigned int uNumSamples, frameStats_t& stats) {
+		memset(&stats, 0, sizeof(stats));
+		stats.numFrames = uNumSamples;
+		if (uNumSamples == 0) {
+			return;
+		}
+
+		float fHitch = (float)com_hitch.Value();
+		double dTotal = 0.0;
+		for (unsigned int i = 0; i < uNumSamples; i++) {
+			dTotal += fSamples[i];
+			if (fSamples[i] > stats.fMax) {
+				stats.fMax = fSamples[i];
+			}
+			if (fHitch > 0.0f && fSamples[i] >= fHitch) {
+				stats.numHitches++;
+			}
+		}
+		stats.fAverage = (float)(dTotal / uNumSamples);
+		stats.fP50 = Percentile(fSamples, uNumSamples, 50.0f);
+		stats.fP95 = Percentile(fSamples, uNumSamples, 95.0f);
+		stats.fP99 = Percentile(fSamples, uNumSamples, 99.0f);
+	}
+
+	static void Summarize(const float* fSamples, frameStats_t& stats) {
+		float fScratch[PERF_WINDOW];
+		memcpy(fScratch, fSamples, uCount * sizeof(float));
+		SummarizeSamples(fScratch, uCount, stats);
+	}
+
+	// The most recently finished frame, in milliseconds. False until a whole frame has gone by.
+	bool GetLastFrame(float* fFrameTime, float fPhases[PERF_MAX]) {
+		if (uCount == 0) {
+			return false;
+		}
+		unsigned int uLast = (uHead + PERF_WINDOW - 1) % PERF_WINDOW;
+		*fFrameTime = fFrameTimes[uLast];
+		for (int i = 0; i < PERF_MAX; i++) {
+			fPhases[i] = fPhaseTimes[i][uLast];
+		}
+		return true;
+	}
+
+	void GetFrameStats(frameStats_t* stats) {
+		Summarize(fFrameTimes, *stats);
+	}
+
+	void Print() {
+		frameStats_t stats;
+		GetFrameStats(&stats);
+		if (stats.numFrames == 0) {
+			R_Message(PRIORITY_MESSAGE, "no frames recorded yet\n");
+			return;
+		}
+		R_Message(PRIORITY_MESSAGE, "\nlast %i frames (%.1f fps), %i at or over com_hitch\n", stats.numFrames, 1000.0f / stats.fAverage, stats.numHitches);
+		R_Message(PRIORITY_MESSAGE, "%-20s %8s %8s %8s %8s %8s\n", "Phase (ms)", "Avg", "p50", "p95", "p99", "Max");
+		R_Message(PRIORITY_MESSAGE, "%-20s %8s %8s %8s %8s %8s\n", "----------", "---", "---", "---", "---", "---");
+		R_Message(PRIORITY_MESSAGE, "%-20s %8.3f %8.3f %8.3f %8.3f %8.3f\n", "Frame", stats.fAverage, stats.fP50, stats.fP95, stats.fP99, stats.fMax);
+		for (int i = 0; i < PERF_MAX; i++) {
+			Summarize(fPhaseTimes[i], stats);
+			R_Message(PRIORITY_MESSAGE, "%-20s %8.3f %8.3f %8.3f %8.3f %8.3f\n", phaseNames[i], stats.fAverage, stats.fP50, stats.fP95, stats.fP99, stats.fMax);
+		}
+	}
+}
@@ -0,0 +1,121 @@
+#include "sys_local.h"
+#include <new>
+
+/*
+ * Memory pools hand out fixed-size slots carved from larger slabs.
+ * Freed slots go onto a free list and get reused by the next allocation, so objects which are
+ * created for every request (files, resources, sockets) never touch the heap once the pool is warm.
+ */
+
+// All pools register themselves here so that meminfo can list them
+vector<MemoryPool*>& MemoryPool::GetPoolList() {
+	static vector<MemoryPool*> vPools;
+	return vPools;
+}
+
+// Creates a new pool. No memory gets allocated until the first slot is requested.
+MemoryPool::MemoryPool(const char* name, size_t objectSize, size_t slotsPerSlab) {
+	szName = name;
+	ulSlotSize = (objectSize + CACHE_LINE_SIZE - 1) & ~(CACHE_LINE_SIZE - 1);
+	if (ulSlotSize < sizeof(FreeSlot)) {
+		ulSlotSize = CACHE_LINE_SIZE;
+	}
+	ulSlotsPerSlab = slotsPerSlab > 0 ? slotsPerSlab : 1;
+	pFreeList = nullptr;
+	ulInUse = ulPeakInUse = ulTotalAllocs = 0;
+	GetPoolList().push_back(this);
+}
+
+MemoryPool::~MemoryPool() {
+	vector<MemoryPool*>& vPools = GetPoolList();
+	auto it = find(vPools.begin(), vPools.end(), this);
+	if (it != vPools.end()) {
+		vPools.erase(it);
+	}
+	for (auto it = vSlabs.begin(); it != vSlabs.end(); ++it) {
+		free(*it);
+	}
+	vSlabs.clear();
+	pFreeList = nullptr;
+}
+
+// Allocates a new slab and threads all of its slots onto the free list
+void MemoryPool::AllocateSlab() {
+	void* pSlab = malloc(ulSlotSize * ulSlotsPerSlab + CACHE_LINE_SIZE);
+	if (pSlab == nullptr) {
+		R_Message(PRIORITY_ERRFATAL, "MemoryPool: out of memory allocating slab for pool '%s'\n", szName);
+		return;
+	}
+	vSlabs.push_back(pSlab);
+
+	// Round up to the first cache line boundary within the slab
+	uintptr_t aligned = ((uintptr_t)pSlab + CACHE_LINE_SIZE - 1) & ~((uintptr_t)CACHE_LINE_SIZE - 1);
+	unsigned char* pSlot = (unsigned char*)aligned;
+	for (size_t i = 0; i < ulSlotsPerSlab; i++) {
+		FreeSlot* pFree = (FreeSlot*)(pSlot + i * ulSlotSize);
+		pFree->pNext = pFreeList;
+		pFreeList = pFree;
+	}
+}
+
+// Grabs a slot off of the free list, allocating a new slab if we've run out
+void* MemoryPool::Allocate() {
+	lock_guard<mutex> lock(mut);
+	if (pFreeList == nullptr) {
+		AllocateSlab();
+		if (pFreeList == nullptr) {
+			return nullptr;
+		}
+	}
+	FreeSlot* pSlot = pFreeList;
+	pFreeList = pSlot->pNext;
+
+	ulInUse++;
+	ulTotalAllocs++;
+	if (ulInUse > ulPeakInUse) {
+		ulPeakInUse = ulInUse;
+	}
+	return pSlot;
+}
+
+// Used by class-level operator new, which must never hand back nullptr.
+// A derived class larger than the slot would overflow into its neighbour, so that gets refused as well.
+void* MemoryPool::AllocateObject(size_t size) {
+	if (size > ulSlotSize) {
+		R_Message(PRIORITY_ERROR, "MemoryPool: %i byte object does not fit in %i byte slots of pool '%s'\n", size, ulSlotSize, szName);
+		throw bad_alloc();
+	}
+	void* memory = Allocate();
+	if (memory == nullptr) {
+		throw bad_alloc();
+	}
+	return memory;
+}
+
+// Returns a slot to the free list. Slabs are never released until the pool is destroyed.
+// Pools which back class-level operator new should be heap allocated and leaked, so that
+// an object deleted during static destruction doesn't land in a pool that's already gone.
+void MemoryPool::Free(void* memory) {
+	if (memory == nullptr) {
+		return;
+	}
+	lock_guard<mutex> lock(mut);
+	FreeSlot* pSlot = (FreeSlot*)memory;
+	pSlot->pNext = pFreeList;
+	pFreeList = pSlot;
+	ulInUse--;
+}
+
+// Prints the occupancy of every pool
+void MemoryPool::PrintPoolUsage() {
+	vector<MemoryPool*>& vPools = GetPoolList();
+	R_Message(PRIORITY_MESSAGE, "\n%-16s %10s %10s %10s %10s %10s %14s\n", "Pool", "Slot (b)", "Slabs", "Capacity", "In Use", "Peak", "Total Allocs");
+	R_Message(PRIORITY_MESSAGE, "%-16s %10s %10s %10s %10s %10s %14s\n", "----", "--------", "-----", "--------", "------", "----", "------------");
+	for (auto it = vPools.begin(); it != vPools.end(); ++it) {
+		MemoryPool* pPool = *it;
+		lock_guard<mutex> lock(pPool->mut);
+		R_Message(PRIORITY_MESSAGE, "%-16s %10i %10i %10i %10i %10i %14i\n", pPool->szName, pPool->ulSlotSize,
+			pPool->vSlabs.size(), pPool->vSlabs.size() * pPool->ulSlotsPerSlab,
+			pPool->ulInUse, pPool->ulPeakInUse, pPool->ulTotalAllocs);
+	}
+}
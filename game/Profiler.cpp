@@ -0,0 +1,431 @@
+#include "sys_local.h"
+#include <deque>
+#include <unordered_set>
+
+/*
+ * The profiler records nested timing zones from every thread that opens one, and writes a
+ * captured run of frames out as Chrome trace-event JSON (load it in chrome://tracing).
+ * Zones cost a single relaxed load when nothing is being recorded.
+ *
+ * With com_hitchtrace set, it also works as a flight recorder: zones, metric counters (allocations, file and
+ * network traffic, draws) and finished resource requests from the last few seconds are always kept, and the
+ * first frame that goes over com_hitch has all of it written out to a trace file.
+ */
+
+#ifdef _MSC_VER
+#define PROFILE_THREADLOCAL	__declspec(thread)	// VS2013 doesn't have thread_local
+#else
+#define PROFILE_THREADLOCAL	__thread
+#endif
+
+namespace Profiler {
+	struct OpenZone {
+		const char* szName;
+		uint64_t ulStart;
+	};
+
+	// Each thread writes into its own buffer. The lock is only contended while a capture is being written out.
+	// Buffers of threads that have exited get handed to the next new thread, so resizing a thread pool doesn't add more.
+	struct ThreadBuffer {
+		mutex mut;
+		string sName;
+		int iThreadID;
+		bool bInUse;
+		OpenZone openZones[PROFILE_MAX_DEPTH];
+		int iDepth;
+		deque<ProfileEvent> vEvents;	// in the order that the zones ended
+	};
+
+	// A metric counter's change over one frame
+	struct CounterSample {
+		const char* szName;
+		uint64_t ulTime;
+		int64_t value;
+	};
+
+	static PROFILE_THREADLOCAL ThreadBuffer* ptThreadBuffer = nullptr;
+
+	static mutex mThreads;
+	static vector<ThreadBuffer*> vThreads;
+
+	static atomic<bool> bCapturing(false);
+	static atomic<bool> bRecording(false);	// zones are being kept, for a capture or for hitch traces
+	static int iFramesRequested = 0;	// frames for the next capture, only touched by the main thread
+	static int iFramesLeft = 0;
+	static uint64_t ulFrameStart = 0;
+	static unsigned int uCaptureFrame = 0;
+	static string sCaptureFile;
+
+	// Hitch recorder, only touched by the main thread
+	static Cvar* com_hitchtrace = nullptr;
+	static deque<CounterSample> dCounters;
+	static map<Metric*, int64_t> mLastCounterValues;
+	static vector<Metric*> vMetrics;
+	static bool bHitchPending = false;
+	static unsigned long ulHitchTicks = 0;
+	static uint64_t ulLastHitchTrace = 0;
+
+	// Zone names from the game module point into its DLL, which can be unloaded (that can be the hitch itself)
+	// while the recorder still holds events naming them. Those names get copied here and live until exit.
+	static mutex mInternedNames;
+	static unordered_set<string> sInternedNames;
+	static unordered_map<const char*, const char*> umInternedByAddress;
+
+	uint64_t Nanoseconds() {
+		return Timer::Nanoseconds();
+	}
+
+	static ThreadBuffer* GetThreadBuffer() {
+		if (ptThreadBuffer == nullptr) {
+			lock_guard<mutex> lock(mThreads);
+			for (auto it = vThreads.begin(); it != vThreads.end(); ++it) {
+				if (!(*it)->bInUse) {
+					ptThreadBuffer = *it;
+					break;
+				}
+			}
+			if (ptThreadBuffer == nullptr) {
+				ptThreadBuffer = new ThreadBuffer();
+				ptThreadBuffer->iThreadID = vThreads.size();
+				vThreads.push_back(ptThreadBuffer);
+			}
+			ptThreadBuffer->bInUse = true;
+			ptThreadBuffer->iDepth = 0;
+			lock_guard<mutex> bufferLock(ptThreadBuffer->mut);
+			ptThreadBuffer->sName.clear();
+		}
+		return ptThreadBuffer;
+	}
+
+	// Called by a thread right before it exits. Its events stay in the buffer until they're written or trimmed.
+	void ExitThread() {
+		if (ptThreadBuffer == nullptr) {
+			return;
+		}
+		lock_guard<mutex> lock(mThreads);
+		ptThreadBuffer->bInUse = false;
+		ptThreadBuffer = nullptr;
+	}
+
+	// Gives the calling thread a name in the trace
+	void SetThreadName(const char* name) {
+		ThreadBuffer* ptBuffer = GetThreadBuffer();
+		lock_guard<mutex> lock(ptBuffer->mut);
+		ptBuffer->sName = name;
+	}
+
+	void BeginZone(const char* name) {
+		if (!bRecording.load(memory_order_relaxed)) {
+			return;
+		}
+		ThreadBuffer* ptBuffer = GetThreadBuffer();
+		if (ptBuffer->iDepth >= PROFILE_MAX_DEPTH) {
+			ptBuffer->iDepth++;	// still count it so that the matching EndZone lines up
+			return;
+		}
+		OpenZone& zone = ptBuffer->openZones[ptBuffer->iDepth++];
+		zone.szName = name;
+		zone.ulStart = Nanoseconds();
+	}
+
+	static const char* InternName(const char* name) {
+		lock_guard<mutex> lock(mInternedNames);
+		auto it = umInternedByAddress.find(name);
+		if (it != umInternedByAddress.end() && !strcmp(it->second, name)) {
+			return it->second;	// a reloaded DLL can put a different name at the same address
+		}
+		const char* szInterned = sInternedNames.insert(name).first->c_str();
+		umInternedByAddress[name] = szInterned;
+		return szInterned;
+	}
+
+	// Modcode zones (trap->ProfileBeginZone)
+	void VMBeginZone(const char* name) {
+		if (!bRecording.load(memory_order_relaxed)) {
+			return;
+		}
+		BeginZone(InternName(name));
+	}
+
+	// Zones that were opened before a capture started never got pushed, so an EndZone on an empty stack is ignored
+	void EndZone() {
+		ThreadBuffer* ptBuffer = ptThreadBuffer;
+		if (ptBuffer == nullptr || ptBuffer->iDepth <= 0) {
+			return;
+		}
+		ptBuffer->iDepth--;
+		if (ptBuffer->iDepth >= PROFILE_MAX_DEPTH || !bRecording.load(memory_order_relaxed)) {
+			return;
+		}
+		OpenZone& zone = ptBuffer->openZones[ptBuffer->iDepth];
+		ProfileEvent event;
+		event.szName = zone.szName;
+		event.ulStart = zone.ulStart;
+		event.ulDuration = Nanoseconds() - zone.ulStart;
+		lock_guard<mutex> lock(ptBuffer->mut);
+		ptBuffer->vEvents.push_back(event);
+	}
+
+	bool IsCapturing() {
+		return bCapturing.load(memory_order_relaxed);
+	}
+
+	void Init() {
+		com_hitchtrace = Cvar::Get<int>("com_hitchtrace",
+			"Seconds of profiling history to keep; the first frame over com_hitch writes it out as a trace (0 = off)", (1 << CVAR_ARCHIVE), 0);
+	}
+
+	static uint64_t HitchWindow() {
+		if (com_hitchtrace == nullptr || com_hitchtrace->Integer() <= 0) {
+			return 0;
+		}
+		return (uint64_t)com_hitchtrace->Integer() * 1000000000ULL;
+	}
+
+	// Called by FrameCapper when a frame goes over com_hitch. The trace is written once the frame has been closed off.
+	void ReportHitch(unsigned long ulFrameTicks) {
+		if (HitchWindow() == 0 || bHitchPending) {
+			return;
+		}
+		bHitchPending = true;
+		ulHitchTicks = ulFrameTicks;
+	}
+
+	// Capture starts at the beginning of the next frame
+	void StartCapture(int numFrames, const char* filename) {
+		if (bCapturing.load() || iFramesRequested > 0) {
+			R_Message(PRIORITY_WARNING, "a profile capture is already running\n");
+			return;
+		}
+		iFramesRequested = numFrames > PROFILE_MAX_FRAMES ? PROFILE_MAX_FRAMES : numFrames;
+		sCaptureFile = filename;
+	}
+
+	static void AppendEscaped(string& out, const char* text) {
+		for (const char* p = text; *p; p++) {
+			if (*p == '"' || *p == '\\') {
+				out += '\\';
+			}
+			out += *p;
+		}
+	}
+
+	// ts and dur are in microseconds; the fractional part keeps the nanoseconds
+	static void AppendEvent(string& out, const ProfileEvent& event, int iThreadID) {
+		char buffer[128];
+		out += "{\"name\":\"";
+		AppendEscaped(out, event.szName);
+		Sys_snprintf(buffer, sizeof(buffer), "\",\"ph\":\"X\",\"pid\":0,\"tid\":%i,\"ts\":%.3f,\"dur\":%.3f},\n",
+			iThreadID, event.ulStart / 1000.0, event.ulDuration / 1000.0);
+		out += buffer;
+	}
+
+	static void AppendThreadName(string& out, int iThreadID, const char* name) {
+		char buffer[128];
+		Sys_snprintf(buffer, sizeof(buffer), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%i,\"args\":{\"name\":\"", iThreadID);
+		out += buffer;
+		AppendEscaped(out, name);
+		out += "\"}},\n";
+	}
+
+	static void AppendCounter(string& out, const CounterSample& sample) {
+		char buffer[128];
+		out += "{\"name\":\"";
+		AppendEscaped(out, sample.szName);
+		Sys_snprintf(buffer, sizeof(buffer), "\",\"ph\":\"C\",\"pid\":0,\"ts\":%.3f,\"args\":{\"value\":%lld}},\n",
+			sample.ulTime / 1000.0, (long long)sample.value);
+		out += buffer;
+	}
+
+	// Async slices, since requests overlap each other. Begin and end share an id, and the stages nest inside the request.
+	static void AppendAsyncSlice(string& out, const char* name, unsigned int uID, uint64_t ulStart, uint64_t ulEnd) {
+		char buffer[128];
+		for (int i = 0; i < 2; i++) {
+			out += "{\"name\":\"";
+			AppendEscaped(out, name);
+			Sys_snprintf(buffer, sizeof(buffer), "\",\"cat\":\"request\",\"ph\":\"%c\",\"id\":%u,\"pid\":0,\"ts\":%.3f},\n",
+				i == 0 ? 'b' : 'e', uID, (i == 0 ? ulStart : ulEnd) / 1000.0);
+			out += buffer;
+		}
+	}
+
+	static void AppendRequests(string& out, uint64_t ulSince) {
+		static const char* stageNames[TRACE_MAX - 1] = { "queue", "io", "decode", "callback" };
+		vector<requestTrace_t> vRequests;
+		ResTrace::GetFinished(ulSince, vRequests);
+		unsigned int uID = 0;
+		for (auto it = vRequests.begin(); it != vRequests.end(); ++it, uID++) {
+			char name[RESTRACE_NAMELEN + 32];
+			Sys_snprintf(name, sizeof(name), "%s %s", it->szKind, it->szName);
+			AppendAsyncSlice(out, name, uID, it->ulStamps[TRACE_ENQUEUE], it->ulStamps[TRACE_CALLBACKDONE]);
+			for (int i = 0; i < TRACE_MAX - 1; i++) {
+				if (it->ulStamps[i + 1] > it->ulStamps[i]) {
+					AppendAsyncSlice(out, stageNames[i], uID, it->ulStamps[i], it->ulStamps[i + 1]);
+				}
+			}
+		}
+	}
+
+	// Writes out everything that has ended since ulSince. A capture takes the events with it; a hitch trace leaves them for the next one.
+	static void WriteTrace(const string& filename, uint64_t ulSince, bool bClear, const char* description) {
+		string out = "{\"traceEvents\":[\n";
+		size_t numEvents = 0;
+		{
+			lock_guard<mutex> lock(mThreads);
+			for (auto it = vThreads.begin(); it != vThreads.end(); ++it) {
+				ThreadBuffer* ptBuffer = *it;
+				lock_guard<mutex> bufferLock(ptBuffer->mut);
+				if (!ptBuffer->sName.empty()) {
+					AppendThreadName(out, ptBuffer->iThreadID, ptBuffer->sName.c_str());
+				}
+				for (auto jt = ptBuffer->vEvents.begin(); jt != ptBuffer->vEvents.end(); ++jt) {
+					if (jt->ulStart + jt->ulDuration >= ulSince) {
+						AppendEvent(out, *jt, ptBuffer->iThreadID);
+						numEvents++;
+					}
+				}
+				if (bClear) {
+					ptBuffer->vEvents.clear();
+				}
+			}
+		}
+		for (auto it = dCounters.begin(); it != dCounters.end(); ++it) {
+			if (it->ulTime >= ulSince) {
+				AppendCounter(out, *it);
+			}
+		}
+		if (bClear) {
+			dCounters.clear();
+		}
+		AppendRequests(out, ulSince);
+		if (out[out.length() - 2] == ',') {
+			out.erase(out.length() - 2, 1);
+		}
+		out += "]}\n";
+
+		File* ptFile = File::OpenSync(filename.c_str(), "wb");
+		if (ptFile == nullptr) {
+			R_Message(PRIORITY_WARNING, "could not open %s for writing\n", filename.c_str());
+			return;
+		}
+		File::WriteSync(ptFile, (void*)out.c_str(), out.length());
+		File::CloseSync(ptFile);
+		R_Message(PRIORITY_MESSAGE, "wrote %i profile events %s to %s\n", numEvents, description, filename.c_str());
+	}
+
+	static void WriteCapture() {
+		char description[64];
+		Sys_snprintf(description, sizeof(description), "over %u frames", uCaptureFrame);
+		WriteTrace(sCaptureFile, 0, true, description);
+	}
+
+	// Counters go into the trace as how much they went up during each frame
+	static void SampleCounters(uint64_t ulNow) {
+		Metrics::GetAll(vMetrics);
+		for (auto it = vMetrics.begin(); it != vMetrics.end(); ++it) {
+			Metric* pMetric = *it;
+			if (pMetric->type != METRIC_COUNTER) {
+				continue;
+			}
+			int64_t value = pMetric->value.load(memory_order_relaxed);
+			auto last = mLastCounterValues.find(pMetric);
+			if (last != mLastCounterValues.end()) {
+				CounterSample sample = { pMetric->sName.c_str(), ulNow, value - last->second };
+				dCounters.push_back(sample);
+			}
+			mLastCounterValues[pMetric] = value;
+		}
+	}
+
+	// Throws out whatever is older than the hitch window, unless a capture needs it
+	static void TrimHistory(uint64_t ulOldest) {
+		{
+			lock_guard<mutex> lock(mThreads);
+			for (auto it = vThreads.begin(); it != vThreads.end(); ++it) {
+				lock_guard<mutex> bufferLock((*it)->mut);
+				deque<ProfileEvent>& dEvents = (*it)->vEvents;
+				while (!dEvents.empty() && dEvents.front().ulStart + dEvents.front().ulDuration < ulOldest) {
+					dEvents.pop_front();
+				}
+			}
+		}
+		while (!dCounters.empty() && dCounters.front().ulTime < ulOldest) {
+			dCounters.pop_front();
+		}
+	}
+
+	static void WriteHitchTrace(uint64_t ulNow, uint64_t ulWindow) {
+		char filename[64];
+		char description[64];
+		Sys_snprintf(filename, sizeof(filename), "hitch_%u.json", RaptureGame::GetFrameNumber());
+		Sys_snprintf(description, sizeof(description), "leading up to a %lu ms frame", ulHitchTicks);
+		WriteTrace(filename, ulNow > ulWindow ? ulNow - ulWindow : 0, false, description);
+		ulLastHitchTrace = ulNow;
+	}
+
+	// Called by the main thread at the start of every frame. Starts and stops captures, keeps the hitch recorder going
+	// and records the frame itself as a zone.
+	void FrameBoundary() {
+		uint64_t ulNow = Nanoseconds();
+		uint64_t ulHitchWindow = HitchWindow();
+		if (bRecording.load(memory_order_relaxed)) {
+			ThreadBuffer* ptBuffer = GetThreadBuffer();
+			ProfileEvent event;
+			event.szName = "Frame";
+			event.ulStart = ulFrameStart;
+			event.ulDuration = ulNow - ulFrameStart;
+			{
+				lock_guard<mutex> lock(ptBuffer->mut);
+				ptBuffer->vEvents.push_back(event);
+			}
+			SampleCounters(ulNow);
+		}
+
+		// Only one hitch trace per window, so that a run of slow frames (a level load) doesn't write one each
+		if (bHitchPending) {
+			bHitchPending = false;
+			if (ulHitchWindow > 0 && !bCapturing.load(memory_order_relaxed) && (ulLastHitchTrace == 0 || ulNow - ulLastHitchTrace >= ulHitchWindow)) {
+				WriteHitchTrace(ulNow, ulHitchWindow);
+			}
+		}
+
+		if (bCapturing.load(memory_order_relaxed)) {
+			uCaptureFrame++;
+			if (--iFramesLeft <= 0) {
+				bCapturing.store(false);
+				bRecording.store(ulHitchWindow > 0);
+				WriteCapture();
+				ulFrameStart = Nanoseconds();
+				return;
+			}
+		}
+		else if (iFramesRequested > 0) {
+			{
+				lock_guard<mutex> lock(mThreads);
+				for (auto it = vThreads.begin(); it != vThreads.end(); ++it) {
+					lock_guard<mutex> bufferLock((*it)->mut);
+					(*it)->vEvents.clear();
+				}
+			}
+			dCounters.clear();
+			iFramesLeft = iFramesRequested;
+			iFramesRequested = 0;
+			uCaptureFrame = 0;
+			bCapturing.store(true);
+			bRecording.store(true);
+			R_Message(PRIORITY_MESSAGE, "capturing %i frames...\n", iFramesLeft);
+		}
+		else {
+			bool bWasRecording = bRecording.exchange(ulHitchWindow > 0);
+			if (ulHitchWindow > 0) {
+				TrimHistory(ulNow > ulHitchWindow ? ulNow - ulHitchWindow : 0);
+			}
+			else if (bWasRecording) {
+				// com_hitchtrace was just turned off
+				TrimHistory(ulNow);
+				mLastCounterValues.clear();
+			}
+		}
+		ulFrameStart = ulNow;
+	}
+}
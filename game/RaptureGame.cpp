@@ -8,6 +8,10 @@ int RaptureGame::RaptureInputCallback(void *notUsed, SDL_Event* e) {
 		// DONT send input...
 		return 1;
 	}
+	if (Demo::IsPlaying() && e->type != SDL_QUIT && e->type != SDL_APP_TERMINATING) {
+		// The demo is providing the input
+		return 1;
+	}
 	switch(e->type) {
 		case SDL_APP_TERMINATING:
 		case SDL_QUIT:
@@ -68,8 +72,15 @@ RaptureGame::RaptureGame(int argc, char **argv) {
 	editor = nullptr;
 	uGameFlags = 0;
 
+	Profiler::SetThreadName("Main");
 	ptDispatch = new Dispatch(0, 0, 0);
 
+	for (int i = 1; i < argc; i++) {
+		if (!stricmp(argv[i], "-headless")) {
+			bHeadless = true;
+		}
+	}
+
 	Sys_PrintSDLVersion();
 
 	// init cmds
@@ -80,6 +91,13 @@ RaptureGame::RaptureGame(int argc, char **argv) {
 
 	// Init the cvar system (so we can assign preliminary cvars in the commandline)
 	CvarSystem::Initialize();
+	Zone::InitBudgets();
+
+	// Init metrics, zone usage gets sampled into them
+	Metrics::Init();
+	Metrics::AddSampler(Zone::PublishMetrics);
+	Profiler::Init();
+	Stress::Init();
 
 	// Init filesystem
 	Filesystem::Init();
@@ -88,11 +106,14 @@ RaptureGame::RaptureGame(int argc, char **argv) {
 	ptDispatch->Setup();
 
 	// Read from the config
-	Cmd::ProcessCommand("exec raptureconfig.cfg");
+	Cmd::AppendCommand("exec raptureconfig.cfg");
 
 	// Actually read the arguments
 	HandleCommandline(argc, argv);
 
+	// The renderer needs these to be set before it starts up, so don't wait for the first frame
+	Cmd::FlushBuffer();
+
 	// Init the renderer
 	if (!Video::Init()) {
 		return;
@@ -112,6 +133,9 @@ RaptureGame::RaptureGame(int argc, char **argv) {
 
 /* Called after the main loop has finished and we are ready to shut down */
 RaptureGame::~RaptureGame() {
+	Demo::Shutdown();
+	Stress::Shutdown();
+
 	if(game) {
 		trap->saveandexit();
 		delete game;
@@ -121,44 +145,92 @@ RaptureGame::~RaptureGame() {
 		delete editor;
 	}
 
+	// The network thread reads cvars, logs, and allocates, so it has to be gone before any of that is torn down
+	Network::Shutdown();
 	DeleteInput();
 	CvarSystem::Destroy();
 	delete ptDispatch;
 	Filesystem::Exit();
 	Zone::Shutdown();
 	Video::Shutdown();
-	Network::Shutdown();
+	Metrics::Shutdown();
 }
 
+bool RaptureGame::bHeadless = false;
+
 /* Run every frame */
+unsigned int RaptureGame::uFrameNumber = 0;
 void RaptureGame::RunLoop() {
+	uFrameNumber++;
+	Profiler::FrameBoundary();
+	PerfStats::FrameBoundary();
+	Metrics::Frame();
+	Zone::RunEvictions();
+	Demo::Frame();
+	Stress::Frame();
 
 	// Do input
-	Input->InputFrame();
-	UI::Update();
+	{
+		PERF_PHASE(PERF_INPUT);
+		Input->InputFrame();
+	}
+	{
+		PERF_PHASE(PERF_UIUPDATE);
+		UI::Update();
+	}
 
-	Video::ClearFrame();
+	// Run any commands that have been buffered since last frame
+	{
+		PERF_PHASE(PERF_COMMANDS);
+		Cmd::ExecuteBuffer();
+	}
+
+	{
+		PERF_PHASE(PERF_CLEARFRAME);
+		Video::ClearFrame();
+	}
 
 	// Do gamecode
-	Network::Server::Frame();
-	Network::Client::Frame();
+	{
+		PERF_PHASE(PERF_SERVER);
+		Network::Server::Frame();
+	}
+	{
+		PERF_PHASE(PERF_CLIENT);
+		Network::Client::Frame();
+	}
+	Stress::Run();
 
 	// Do rendering
-	UI::Render();
-	Video::RenderFrame();
+	{
+		PERF_PHASE(PERF_UIRENDER);
+		UI::Render();
+	}
+	{
+		PERF_PHASE(PERF_RENDERFRAME);
+		Video::RenderFrame();
+	}
 }
 
 /* Deal with the commandline arguments */
+// Switches that get handled before the command line is run. Anything else starting with '-' is a value (+set com_hitch -1).
+static bool IsEngineSwitch(const char* arg) {
+	return !stricmp(arg, "-headless");
+}
+
 void RaptureGame::HandleCommandline(int argc, char** argv) {
 	if(argc <= 1) return;
 	string ss = "";
 	for(int i = 1; i < argc; i++) {
+		if(IsEngineSwitch(argv[i])) {
+			continue;
+		}
 		ss += argv[i];
 	}
 	vector<string> s;
 	split(ss, '+', s);
 	for(auto it = s.begin(); it != s.end(); ++it) {
-		Cmd::ProcessCommand(it->c_str());
+		Cmd::AppendCommand(*it);
 	}
 }
 
@@ -170,7 +242,7 @@ GameModule* RaptureGame::CreateGameModule(const char* bundle) {
 	imp.printf = R_Message;
 	imp.error = R_Error;
 
-	imp.GetTicks = reinterpret_cast<int(*)()>(SDL_GetTicks);
+	imp.GetTicks = reinterpret_cast<int(*)()>(Demo::Ticks);
 	imp.GetCurrentTimeDate = TimeDate::GetCurrent;
 	imp.SubtractTimeDate = TimeDate::Subtract;
 	imp.AddTimeDate = TimeDate::Add;
@@ -224,6 +296,7 @@ GameModule* RaptureGame::CreateGameModule(const char* bundle) {
 	imp.RegisterCvarFloat = static_cast<Cvar*(*)(const char*, const char*, int, float)>(CvarSystem::RegisterCvar);
 	imp.RegisterCvarInt = static_cast<Cvar*(*)(const char*, const char*, int, int)>(CvarSystem::RegisterCvar);
 	imp.RegisterCvarStr = static_cast<Cvar*(*)(const char*, const char*, int, char*)>(CvarSystem::RegisterCvar);
+	imp.CvarGeneration = CvarSystem::GetGenerationCounter();
 	imp.RegisterStaticMenu = UI::RegisterStaticMenu;
 	imp.KillStaticMenu = UI::KillStaticMenu;
 
@@ -232,6 +305,7 @@ GameModule* RaptureGame::CreateGameModule(const char* bundle) {
 
 	imp.SendServerPacket = Network::Server::QueuePacket;
 	imp.SendClientPacket = Network::Client::QueuePacket;
+	imp.SetPacketChannel = Network::SetPacketChannel;
 
 	imp.RunJavaScript = UI::RunJavaScript;
 	imp.AddJSCallback = UI::AddJavaScriptCallback;
@@ -243,12 +317,19 @@ GameModule* RaptureGame::CreateGameModule(const char* bundle) {
 
 	imp.IsConsoleOpen = UI::IsConsoleOpen;
 
+	imp.ProfileBeginZone = Profiler::VMBeginZone;
+	imp.ProfileEndZone = Profiler::EndZone;
+	imp.GetFrameStats = PerfStats::GetFrameStats;
+
 	imp.Zone_Alloc = Zone::VMAlloc;
 	imp.Zone_FastFree = Zone::VMFastFree;
 	imp.Zone_Free = Zone::Free;
 	imp.Zone_FreeAll = Zone::VMFreeAll;
 	imp.Zone_NewTag = Zone::NewTag;
 	imp.Zone_Realloc = Zone::Realloc;
+	imp.Zone_AllocAligned = Zone::VMAllocAligned;
+	imp.Zone_AddEvictionCallback = Zone::VMAddEvictionCallback;
+	imp.Zone_RemoveEvictionCallback = Zone::VMRemoveEvictionCallback;
 
 	imp.FadeFromBlack = Video::FadeFromBlack;
 	
@@ -346,7 +427,7 @@ void RaptureGame::StartGameFromFile(const char* szSaveGameName, bool bMultiplaye
 	}
 
 	MainMenu::DestroySingleton();
-	if (Console::GetSingleton()->IsOpen()) {
+	if (UI::IsConsoleOpen()) {
 		Console::GetSingleton()->Hide();
 	}
 
@@ -354,8 +435,8 @@ void RaptureGame::StartGameFromFile(const char* szSaveGameName, bool bMultiplaye
 	if (game == nullptr) {
 		return;
 	}
-	if (bMultiplayer) {
-		Network::Server::StartLocalServer();
+	if (bMultiplayer && !Network::Server::StartLocalServer()) {
+		R_Message(PRIORITY_WARNING, "Couldn't start the local server; nobody else will be able to join this game.\n");
 	}
 	trap->startserverfromsave(szSaveGameName);
 	trap->startclientfromsave(szSaveGameName);
@@ -368,7 +449,7 @@ void RaptureGame::JoinRemoteGame(const char* szFileName, const char* szHostName)
 		return;
 	}
 
-	if (Console::GetSingleton()->IsOpen()) {
+	if (UI::IsConsoleOpen()) {
 		Console::GetSingleton()->Hide();
 	}
 	MainMenu::DestroySingleton();
@@ -391,7 +472,7 @@ void RaptureGame::StartEditor() {
 		return;
 	}
 
-	if (Console::GetSingleton()->IsOpen()) {
+	if (UI::IsConsoleOpen()) {
 		Console::GetSingleton()->Hide();
 	}
 	MainMenu::DestroySingleton();
@@ -403,7 +484,7 @@ void RaptureGame::StartEditor() {
 }
 
 void RaptureGame::SaveAndExit() {
-	if (Console::GetSingleton()->IsOpen()) {
+	if (UI::IsConsoleOpen()) {
 		Console::GetSingleton()->Hide();
 	}
 
@@ -411,8 +492,10 @@ void RaptureGame::SaveAndExit() {
 		trap->saveandexit();
 	}
 	Network::Client::DisconnectFromRemote();
-	R_Message(PRIORITY_MESSAGE, "creating main menu webview\n");
-	MainMenu::GetSingleton();
+	if (!bHeadless) {
+		R_Message(PRIORITY_MESSAGE, "creating main menu webview\n");
+		MainMenu::GetSingleton();
+	}
 
 	uGameFlags = ~((1 << Rapture_GameLoaded) | (1 < Rapture_EditorLoaded));
 }
@@ -0,0 +1,115 @@
+#include "sys_local.h"
+
+/*
+ * Every Resource and File request through the filesystem gets stamped as it is queued, picked up by a worker,
+ * done with its I/O, done decoding and done with its callback. Finished requests go into a ring that restrace reads,
+ * so a slow load can be broken down into time spent waiting in the queue, on the disk, in cereal and in the callback.
+ */
+
+void requestTrace_t::Begin(const char* kind, const char* name) {
+	szKind = kind;
+	strncpy(szName, name, sizeof(szName) - 1);
+	szName[sizeof(szName) - 1] = '\0';
+	memset(ulStamps, 0, sizeof(ulStamps));
+	ulStamps[TRACE_ENQUEUE] = Timer::Nanoseconds();
+}
+
+void requestTrace_t::Stamp(traceStage_e stage) {
+	ulStamps[stage] = Timer::Nanoseconds();
+}
+
+namespace ResTrace {
+	static const char* stageNames[TRACE_MAX - 1] = {
+		"Queue",
+		"I/O",
+		"Decode",
+		"Callback",
+	};
+
+	static mutex mHistory;
+	static requestTrace_t history[RESTRACE_HISTORY];
+	static unsigned int uHead = 0;
+	static unsigned int uCount = 0;
+
+	// Called by whichever thread finished the request
+	void Submit(requestTrace_t& trace) {
+		if (trace.ulStamps[TRACE_CALLBACKDONE] == 0) {
+			trace.Stamp(TRACE_CALLBACKDONE);
+		}
+		for (int i = TRACE_DEQUEUE; i < TRACE_MAX; i++) {
+			if (trace.ulStamps[i] == 0) {
+				trace.ulStamps[i] = trace.ulStamps[i - 1];
+			}
+		}
+
+		lock_guard<mutex> lock(mHistory);
+		history[uHead] = trace;
+		uHead = (uHead + 1) % RESTRACE_HISTORY;
+		if (uCount < RESTRACE_HISTORY) {
+			uCount++;
+		}
+	}
+
+	// Requests that finished at or after ulSince, oldest first
+	void GetFinished(uint64_t ulSince, vector<requestTrace_t>& vOut) {
+		lock_guard<mutex> lock(mHistory);
+		vOut.clear();
+		for (unsigned int i = uCount; i > 0; i--) {
+			const requestTrace_t& trace = history[(uHead + RESTRACE_HISTORY - i) % RESTRACE_HISTORY];
+			if (trace.ulStamps[TRACE_CALLBACKDONE] >= ulSince) {
+				vOut.push_back(trace);
+			}
+		}
+	}
+
+	static float StageTime(const requestTrace_t& trace, int stage) {
+		return (trace.ulStamps[stage + 1] - trace.ulStamps[stage]) / 1000000.0f;
+	}
+
+	static float TotalTime(const requestTrace_t& trace) {
+		return (trace.ulStamps[TRACE_CALLBACKDONE] - trace.ulStamps[TRACE_ENQUEUE]) / 1000000.0f;
+	}
+
+	static bool SlowerThan(const requestTrace_t& a, const requestTrace_t& b) {
+		return TotalTime(a) > TotalTime(b);
+	}
+
+	void Print(int seconds, int numSlowest) {
+		uint64_t ulNow = Timer::Nanoseconds();
+		uint64_t ulWindow = (uint64_t)seconds * 1000000000ULL;
+		vector<requestTrace_t> vRecent;
+		GetFinished(ulNow > ulWindow ? ulNow - ulWindow : 0, vRecent);
+		if (vRecent.empty()) {
+			R_Message(PRIORITY_MESSAGE, "no resource or file requests finished in the last %i seconds\n", seconds);
+			return;
+		}
+
+		double dStageTotals[TRACE_MAX - 1] = { 0.0 };
+		double dTotal = 0.0;
+		for (auto it = vRecent.begin(); it != vRecent.end(); ++it) {
+			for (int i = 0; i < TRACE_MAX - 1; i++) {
+				dStageTotals[i] += StageTime(*it, i);
+			}
+			dTotal += TotalTime(*it);
+		}
+
+		R_Message(PRIORITY_MESSAGE, "\n%i requests finished in the last %i seconds\n", vRecent.size(), seconds);
+		R_Message(PRIORITY_MESSAGE, "%-10s %12s %8s\n", "Stage", "Total (ms)", "Share");
+		R_Message(PRIORITY_MESSAGE, "%-10s %12s %8s\n", "-----", "----------", "-----");
+		for (int i = 0; i < TRACE_MAX - 1; i++) {
+			R_Message(PRIORITY_MESSAGE, "%-10s %12.3f %7.1f%%\n", stageNames[i], dStageTotals[i], dTotal > 0.0 ? dStageTotals[i] * 100.0 / dTotal : 0.0);
+		}
+
+		sort(vRecent.begin(), vRecent.end(), SlowerThan);
+		if (numSlowest > (int)vRecent.size()) {
+			numSlowest = vRecent.size();
+		}
+		R_Message(PRIORITY_MESSAGE, "\nslowest %i (ms):\n", numSlowest);
+		R_Message(PRIORITY_MESSAGE, "%9s %9s %9s %9s %9s  %-12s %s\n", "Total", stageNames[0], stageNames[1], stageNames[2], stageNames[3], "Kind", "Name");
+		for (int i = 0; i < numSlowest; i++) {
+			const requestTrace_t& trace = vRecent[i];
+			R_Message(PRIORITY_MESSAGE, "%9.3f %9.3f %9.3f %9.3f %9.3f  %-12s %s\n", TotalTime(trace),
+				StageTime(trace, 0), StageTime(trace, 1), StageTime(trace, 2), StageTime(trace, 3), trace.szKind, trace.szName);
+		}
+	}
+}
@@ -4,9 +4,22 @@ string assetURI = "asset://";
 
 extern unordered_map<string, AssetComponent*> m_assetComponents;
 
+// Leaked on purpose, resources can outlive static destruction
+static ObjectPool<Resource>& resourcePool = *new ObjectPool<Resource>("Resource", 64);
+
+void* Resource::operator new(size_t size) {
+	return resourcePool.AllocateObject(size);
+}
+
+void Resource::operator delete(void* ptr) {
+	resourcePool.Free(ptr);
+}
+
 Resource::Resource() {
 	szAssetFile = szComponent = "";
 	bRetrieved = false;
+	bBad = false;
+	bHoldsAsset = false;
 	component = nullptr;
 }
 
@@ -48,7 +61,13 @@ Resource* Resource::ResourceSync(const char* asset, const char* component) {
 	Resource* pRes = new Resource();
 	pRes->szAssetFile = asset;
 	pRes->szComponent = component;
-	pRes->DequeRetrieve(nullptr);
+
+	char name[RESTRACE_NAMELEN];
+	requestTrace_t trace;
+	Sys_snprintf(name, sizeof(name), "%s/%s", asset, component);
+	trace.Begin("resource sync", name);
+	pRes->DequeRetrieve(nullptr, &trace);
+	ResTrace::Submit(trace);
 	return pRes;
 }
 
@@ -72,30 +91,40 @@ Resource* Resource::ResourceSyncURI(const char* uri) {
 }
 
 void Resource::FreeResource(Resource* pResource) {
+	if (pResource != nullptr && pResource->bHoldsAsset) {
+		Filesystem::ReleaseRaptureAsset(pResource->szAssetFile);
+	}
 	delete pResource;
 }
 
-void Resource::DequeRetrieve(assetRequestCallback callback) {
+void Resource::DequeRetrieve(assetRequestCallback callback, requestTrace_t* pTrace) {
 	bool found = true;
 	string fullStr = szAssetFile + '/' + szComponent;
 	transform(fullStr.begin(), fullStr.end(), fullStr.begin(), ::tolower);
+
+	// The cache lock is dropped while the asset file loads, so that other threads can keep retrieving
+	unique_lock<recursive_mutex> lock(Filesystem::assetCacheMutex);
 	if (m_assetComponents.find(fullStr) == m_assetComponents.end()) {
 		// The asset file hasn't been opened
+		lock.unlock();
+		if (Filesystem::pMetricCacheMisses) {
+			Filesystem::pMetricCacheMisses->Add(1);
+		}
 		RaptureAsset* rap = (RaptureAsset*)Zone::Alloc(sizeof(RaptureAsset), "files");
-		Filesystem::LoadRaptureAsset(&rap, szAssetFile);
+		if (!Filesystem::LoadRaptureAsset(&rap, szAssetFile, pTrace)) {
+			Zone::FastFree(rap, "files");
+			this->bBad = true;
+			return;
+		}
 
 		// Toss all of the components from the asset file into the asset components map
-		for (int i = 0; i < rap->head.numberComponents; i++) {
-			AssetComponent* pComp = &rap->components[i];
-			string compName = szAssetFile + '/' + pComp->meta.componentName;
-			transform(compName.begin(), compName.end(), compName.begin(), ::tolower);
-			m_assetComponents[compName] = pComp;
-		}
+		lock.lock();
+		Filesystem::CacheRaptureAsset(rap, szAssetFile);
 
 		// Try and find it again
 		auto it = m_assetComponents.find(fullStr);
 		if (it == m_assetComponents.end()) {
-			R_Message(PRIORITY_WARNING, "Component %s not found in asset %s\n", szComponent.c_str(), rap->head.assetName);
+			R_Message(PRIORITY_WARNING, "Component %s not found in asset %s\n", szComponent.c_str(), szAssetFile.c_str());
 			this->bBad = true;
 			found = false;
 		}
@@ -106,11 +135,21 @@ void Resource::DequeRetrieve(assetRequestCallback callback) {
 	else {
 		component = m_assetComponents[fullStr];
 		found = true;
+		if (Filesystem::pMetricCacheHits) {
+			Filesystem::pMetricCacheHits->Add(1);
+		}
 	}
 
 	if (!found) {
 		return;
 	}
+
+	// Keep the asset resident until this resource is freed
+	if (!bHoldsAsset) {
+		Filesystem::AcquireRaptureAsset(szAssetFile);
+		bHoldsAsset = true;
+	}
+	lock.unlock();
 	if (callback) {
 		callback(component);
 	}
@@ -7,12 +7,98 @@
 #define INET_PORTLEN	16
 #define INET_MAXWAIT	50			// How many milliseconds the game should wait to receive data
 
-/* Non-static member functions */
+#ifdef _WIN32
+#define INET_WOULDBLOCK	WSAEWOULDBLOCK
+#else
+#define INET_WOULDBLOCK	EWOULDBLOCK
+#endif
+
+// Never destroyed, sockets closed late at exit still return their slot here
+static ObjectPool<TCPSocket>& socketPool = *new ObjectPool<TCPSocket>("TCPSocket", RAPTURE_DEFAULT_MAXCLIENTS);
+
+/* Socket */
+
+Socket::Socket(int af_, int type_) : internalSocket(INVALID_SOCKET), af(af_), type(type_), lastHeardFrom(0), lastSpoken(0) {
+}
+
+// Makes a socket for whichever transport net_transport asks for
+Socket* Socket::Create(int af) {
+	if (Network::TransportSocketType() == SOCK_DGRAM) {
+		return new UDPSocket(af);
+	}
+	return new TCPSocket(af);
+}
+
+bool Socket::SetNonBlocking() {
+	unsigned long ulMode = 1;
+
+	// Enable non-blocking recv and write
+	ioctlsocket(internalSocket, FIONBIO, &ulMode);
+	if (ulMode != 1) {
+		R_Message(PRIORITY_ERROR, "Couldn't establish non-blocking socket\n");
+		return false;
+	}
+
+	return true;
+}
+
+// Looks up a hostname and fills out the address to reach it on the given port, in our address family
+bool Socket::Resolve(const char* hostname, unsigned short port, sockaddr_storage& address, int& addressSize) {
+	addrinfo hints{ af == AF_INET6 ? AI_V4MAPPED : 0, af, type, 0, 0, nullptr, nullptr, nullptr };
+	addrinfo* results;
+	char szPort[INET_PORTLEN] {0};
+	char ipBuffer[INET6_ADDRSTRLEN] {0};
+
+	std::sprintf(szPort, "%i", port);
+
+	// Convert the IP address into a valid IPv6 address
+	int dwReturn = getaddrinfo(hostname, szPort, &hints, &results);
+	if (dwReturn != 0) {
+		R_Message(PRIORITY_ERROR, "Could not resolve hostname %s (reason: %s)\n", hostname, gai_strerror(dwReturn));
+		return false;
+	}
+
+	memset(&address, 0, sizeof(address));
+	switch (af) {
+		case AF_INET6:
+		{
+			sockaddr_in6* in6 = (sockaddr_in6*)results->ai_addr;
+			inet_ntop(af, &in6->sin6_addr, ipBuffer, sizeof(ipBuffer));
+			in6->sin6_port = htons(port);
+			in6->sin6_family = AF_INET6;
+			addressSize = sizeof(sockaddr_in6);
+		}
+		break;
+		case AF_INET:
+		{
+			sockaddr_in* in4 = (sockaddr_in*)results->ai_addr;
+			inet_ntop(af, &in4->sin_addr, ipBuffer, sizeof(ipBuffer));
+			in4->sin_port = htons(port);
+			in4->sin_family = AF_INET;
+			addressSize = sizeof(sockaddr_in);
+		}
+		break;
+	}
+	memcpy(&address, results->ai_addr, addressSize);
+	freeaddrinfo(results);
+
+	R_Message(PRIORITY_MESSAGE, "%s resolved to %s\n", hostname, ipBuffer);
+	return true;
+}
+
+/* TCPSocket */
+
+// TCP sockets come out of a pool, since the server creates one for every incoming connection
+void* TCPSocket::operator new(size_t size) {
+	return socketPool.AllocateObject(size);
+}
+
+void TCPSocket::operator delete(void* ptr) {
+	socketPool.Free(ptr);
+}
 
-// Creates a new socket object with family and type
-Socket::Socket(int af_, int type_) {
-	af = af_;
-	type = type_;
+// Creates a new socket object with family
+TCPSocket::TCPSocket(int af_) : Socket(af_, SOCK_STREAM), bSendFailed(false) {
 	internalSocket = socket(af, type, IPPROTO_TCP);
 	if (internalSocket < 0 && af == AF_INET6) {
 		// retry using IPv4
@@ -32,18 +118,10 @@ Socket::Socket(int af_, int type_) {
 	}
 }
 
-// Creates a new socket object from another socket object (copy constructor)
-Socket::Socket(Socket& other) {
-	af = other.af;
-	type = other.type;
-	internalSocket = other.internalSocket;
-}
-
 // Creates a new socket from an internal socket and some information on the address.
-Socket::Socket(addrinfo& connectingClientInfo, socket_t socket) {
-	af = connectingClientInfo.ai_family;
-	type = connectingClientInfo.ai_socktype;
+TCPSocket::TCPSocket(addrinfo& connectingClientInfo, socket_t socket) : Socket(connectingClientInfo.ai_family, connectingClientInfo.ai_socktype), bSendFailed(false) {
 	internalSocket = socket;
+	SetNonBlocking();	// Windows carries this over from the listening socket, but not everything does
 
 	// Set some extra options
 	int yes = 1;
@@ -56,26 +134,13 @@ Socket::Socket(addrinfo& connectingClientInfo, socket_t socket) {
 	}
 }
 
-Socket::~Socket() {
+TCPSocket::~TCPSocket() {
 	Disconnect();
 	closesocket(internalSocket);
 }
 
-bool Socket::SetNonBlocking() {
-	unsigned long ulMode = 1;
-
-	// Enable non-blocking recv and write
-	ioctlsocket(internalSocket, FIONBIO, &ulMode);
-	if (ulMode != 1) {
-		R_Message(PRIORITY_ERROR, "Couldn't establish non-blocking socket\n");
-		return false;
-	}
-
-	return true;
-}
-
 // Binds the socket and starts listening
-bool Socket::StartListening(unsigned short port, uint32_t backlog) {
+bool TCPSocket::StartListening(unsigned short port, uint32_t backlog) {
 	addrinfo hints;
 	addrinfo* value;
 
@@ -104,7 +169,7 @@ bool Socket::StartListening(unsigned short port, uint32_t backlog) {
 }
 
 // Check for any pending connections on this line. Returns a newly created socket if we found a connection.
-Socket* Socket::CheckPendingConnections() {
+Socket* TCPSocket::CheckPendingConnections() {
 	sockaddr_storage clientInfo;
 	int sockSize = sizeof(clientInfo);
 	sockaddr* genericClientInfo = (sockaddr*)&clientInfo;
@@ -143,38 +208,33 @@ Socket* Socket::CheckPendingConnections() {
 	}
 
 	lastHeardFrom = SDL_GetTicks();
-	return new Socket(connectingInfo, value);
+	return new TCPSocket(connectingInfo, value);
 }
 
-// Sends an entire chunk of data across the network, without fragmentation
-bool Socket::SendEntireData(void* data, size_t dataSize) {
+// Sends as much of the backlog as the connection will take right now.
+// One slow client only grows its own backlog; past NET_TCP_SENDBACKLOG it's considered gone.
+bool TCPSocket::FlushSends() {
 	size_t sent = 0;
-	while (sent < dataSize) {
-		int numSent = send(internalSocket, (const char*)data + sent, dataSize - sent, 0);
+	while (!bSendFailed && sent < vSendBacklog.size()) {
+		int numSent = send(internalSocket, &vSendBacklog[sent], vSendBacklog.size() - sent, 0);
 		if (numSent < 0) {
 			int errorNum;
 			const char* errMsg = Sys_SocketError(errorNum);
-			R_Message(PRIORITY_ERROR, "Socket::SendEntireData: %s (error code %i)\n", errMsg, errorNum);
-			return false;
+			if (errorNum == INET_WOULDBLOCK) {
+				break;	// full up, the rest goes next time
+			}
+			R_Message(PRIORITY_ERROR, "Socket::FlushSends: %s (error code %i)\n", errMsg, errorNum);
+			bSendFailed = true;
+			break;
 		}
 		sent += numSent;
 	}
-	return true;
-}
-
-// Send a packet header across the network
-bool Socket::SendPacketHeader(PacketHeader& head) {
-#ifdef BIG_ENDIAN
-	static_assert(true, "Big endian systems don't deserialize!");
-#endif
-	bool sent = SendEntireData(&head.type, sizeof(head.type));
-	sent &= SendEntireData(&head.sendTime, sizeof(head.sendTime));
-	sent &= SendEntireData(&head.packetSize, sizeof(head.packetSize));
-	return sent;
+	vSendBacklog.erase(vSendBacklog.begin(), vSendBacklog.begin() + sent);
+	return !bSendFailed;
 }
 
 // Receive a packet header from the network
-bool Socket::RecvPacketHeader(PacketHeader& head) {
+bool TCPSocket::RecvPacketHeader(PacketHeader& head) {
 #ifdef BIG_ENDIAN
 	static_assert(true, "Big endian systems don't deserialize!");
 #endif
@@ -185,26 +245,39 @@ bool Socket::RecvPacketHeader(PacketHeader& head) {
 }
 
 // Send a packet across the network.
-// Guaranteed delivery (no fragmentation), does not block.
-bool Socket::SendPacket(Packet& outgoing) {
-	bool sent = SendPacketHeader(outgoing.packetHead);
-	if (!sent) {
-		R_Message(PRIORITY_WARNING, "Failed to send packet header (packet type: %i)\n", outgoing.packetHead.type);
+// Guaranteed delivery (no fragmentation), does not block: anything that doesn't go out now waits in the backlog.
+bool TCPSocket::SendPacket(Packet& outgoing) {
+#ifdef BIG_ENDIAN
+	static_assert(true, "Big endian systems don't deserialize!");
+#endif
+	PacketHeader& head = outgoing.packetHead;
+	size_t ulHeaderSize = sizeof(head.type) + sizeof(head.sendTime) + sizeof(head.packetSize);
+	size_t ulOffset = vSendBacklog.size();
+	if (bSendFailed) {
 		return false;
 	}
-	if (outgoing.packetHead.packetSize > 0) {
-		sent = SendEntireData(outgoing.packetData, outgoing.packetHead.packetSize);
-		if (!sent) {
-			R_Message(PRIORITY_WARNING, "Failed to send packet data (packet type: %i)\n", outgoing.packetHead.type);
-			return false;
-		}
+	if (ulOffset + ulHeaderSize + head.packetSize > NET_TCP_SENDBACKLOG) {
+		R_Message(PRIORITY_WARNING, "Send backlog full, giving up on the connection (packet type: %i)\n", head.type);
+		bSendFailed = true;
+		return false;
 	}
+
+	vSendBacklog.resize(ulOffset + ulHeaderSize + head.packetSize);
+	char* pOut = &vSendBacklog[ulOffset];
+	memcpy(pOut, &head.type, sizeof(head.type));
+	pOut += sizeof(head.type);
+	memcpy(pOut, &head.sendTime, sizeof(head.sendTime));
+	pOut += sizeof(head.sendTime);
+	memcpy(pOut, &head.packetSize, sizeof(head.packetSize));
+	pOut += sizeof(head.packetSize);
+	memcpy(pOut, outgoing.packetData, head.packetSize);
+
 	lastSpoken = SDL_GetTicks();
-	return true;
+	return FlushSends();
 }
 
 // Read an entire block of memory from a socket, without fragmentation.
-bool Socket::ReadEntireData(void* data, size_t dataSize) {
+bool TCPSocket::ReadEntireData(void* data, size_t dataSize) {
 	size_t received = 0;
 	uint64_t startSendTime = SDL_GetTicks();
 	uint64_t currentTime = startSendTime;
@@ -239,7 +312,7 @@ bool Socket::ReadEntireData(void* data, size_t dataSize) {
 }
 
 template<typename T>
-T Socket::Read() {
+T TCPSocket::Read() {
 #ifdef BIG_ENDIAN
 	static_assert(true, "Big endian systems don't deserialize!");
 #endif
@@ -257,7 +330,7 @@ T Socket::Read() {
 }
 
 template<typename T>
-void Socket::Write(T in) {
+void TCPSocket::Write(T in) {
 #ifdef BIG_ENDIAN
 	static_assert(true, "Big endian systems doesn't serialize!");
 #endif
@@ -274,7 +347,7 @@ void Socket::Write(T in) {
 
 // Read a packet from a socket.
 // Guaranteed delivery (no fragmentation), may block.
-bool Socket::ReadPacket(Packet& incomingPacket) {
+bool TCPSocket::ReadPacket(Packet& incomingPacket) {
 	bool read;
 
 	memset(&incomingPacket, 0, sizeof(incomingPacket));
@@ -286,61 +359,23 @@ bool Socket::ReadPacket(Packet& incomingPacket) {
 }
 
 // Connect this socket to a hostname and port.
-// Not necessary unless the af/type constructor or the copy constructor are used.
 // Also establishes this socket as being nonblocking.
-bool Socket::Connect(const char* hostname, unsigned short port) {
+bool TCPSocket::Connect(const char* hostname, unsigned short port) {
 	// First we need to resolve the hostname before we can bind the socket
-	addrinfo hints{ af == AF_INET6 ? AI_V4MAPPED : 0, af, 0, IPPROTO_TCP, 0, nullptr, nullptr, nullptr };
-	addrinfo* results;
-	char szPort[INET_PORTLEN] {0};
-	char ipBuffer[INET6_ADDRSTRLEN] {0};
-
-	std::sprintf(szPort, "%i", port);
-
-	// Convert the IP address into a valid IPv6 address
-	int dwReturn = getaddrinfo(hostname, szPort, &hints, &results);
-	if (dwReturn != 0) {
-		R_Message(PRIORITY_ERROR, "Could not resolve hostname %s (reason: %s)\n", hostname, gai_strerror(dwReturn));
+	sockaddr_storage address;
+	int addressSize;
+	if (!Resolve(hostname, port, address, addressSize)) {
 		return false;
 	}
 
-	// Create the sockaddr fields necessary for the connection
-	SOCKADDR_STORAGE* in;
-	size_t addrSize;
-	switch (af) {
-		case AF_INET6:
-		{
-			sockaddr_in6* in6 = (sockaddr_in6*)results->ai_addr;
-			inet_ntop(af, &in6->sin6_addr, ipBuffer, sizeof(ipBuffer));
-			in6->sin6_port = htons(port);
-			in6->sin6_family = AF_INET6;
-			in = (SOCKADDR_STORAGE*)in6;
-			addrSize = sizeof(sockaddr_in6);
-		}
-		break;
-		case AF_INET:
-		{
-			sockaddr_in* in4 = (sockaddr_in*)results->ai_addr;
-			inet_ntop(af, &in4->sin_addr, ipBuffer, sizeof(ipBuffer));
-			in4->sin_port = htons(port);
-			in4->sin_family = AF_INET;
-			in = (SOCKADDR_STORAGE*)in4;
-			addrSize = sizeof(sockaddr_in);
-		}
-		break;
-	}
-
-	R_Message(PRIORITY_MESSAGE, "%s resolved to %s\n", hostname, ipBuffer);
-
 	// Finally actually connect to the remote (in blocking mode)
-	if (connect(internalSocket, (sockaddr*)in, addrSize) != 0) {
+	if (connect(internalSocket, (sockaddr*)&address, addressSize) != 0) {
 		int errorCode;
 		const char* errorMsg = Sys_SocketError(errorCode);
 		R_Message(PRIORITY_ERROR, "Socket::Connect failed (%i: %s)\n", errorCode, errorMsg);
 		return false;
 	}
 
-	freeaddrinfo(results);
 	// Set us as non-blocking
 	if (!SetNonBlocking()) {
 		return false;
@@ -353,13 +388,11 @@ bool Socket::Connect(const char* hostname, unsigned short port) {
 
 // Disconnects a socket.
 // Called automatically on destroyed.
-void Socket::Disconnect() {
+void TCPSocket::Disconnect() {
 	shutdown(internalSocket, SD_SEND);
 }
 
-/* Static member functions */
-
-bool Socket::Select() {
+bool TCPSocket::Select() {
 	fd_set readSet{ 0 };
 	timeval timeout{ 0, 0 };
 	
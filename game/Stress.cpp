@@ -0,0 +1,518 @@
+#include "sys_local.h"
+#include <math.h>
+#include <set>
+
+/*
+ * Synthetic load for finding where things fall off a cliff. stress <mode> <count> ramps from no load at all up to count in steps,
+ * runs each step for stress_frames frames and prints a line with the frame times and throughput, so that the lines make a curve.
+ * The load goes through the same calls that the game makes:
+ *	sprites		count copies of stress_material, drawn with Video::DrawMaterial
+ *	entities	count moving objects that get updated and drawn with Video::DrawMaterialAbs. Entities themselves live in
+ *				gamex86, so this stands in for the engine's side of them.
+ *	text		count different strings in stress_font, rendered with Video::RenderSolidText (TextManager in the renderer)
+ *	clients		count loopback connections to the local server over net_transport, which each send a packet every frame
+ *				that the server answers. This needs a server that's listening, so start a multiplayer game first.
+ *				One more connection never joins, and keeps pinging the server instead. The network thread answers those
+ *				pings by itself and stamps the answer with its own clock, so the Ping column is how long it took to get to
+ *				a socket under the load (to the millisecond), and the frame times beside it show whether any of that load
+ *				reached the frame.
+ * Frame pacing is off while it runs, same as with timedemo.
+ */
+
+namespace Stress {
+	enum stressMode_e {
+		STRESS_SPRITES,
+		STRESS_ENTITIES,
+		STRESS_TEXT,
+		STRESS_CLIENTS,
+		STRESS_MAX
+	};
+
+	enum stressState_e {
+		STRESS_IDLE,
+		STRESS_PREPARING,	// waiting on the font to load or on clients to get accepted
+		STRESS_WARMUP,
+		STRESS_MEASURING,
+	};
+
+	struct stressEntity_t {
+		float x, y;			// pixels
+		float vx, vy;		// pixels per second
+		int size;
+	};
+
+	struct stressClient_t {
+		Socket* pSocket;
+		bool bAccepted;
+	};
+
+	// One point on the curve
+	struct stressResult_t {
+		int count;
+		frameStats_t frame;
+		float fLoad;		// average milliseconds spent in Run
+		float fPhase;		// average milliseconds in the phase that the load mostly lands in
+		float fPing;		// average milliseconds for a ping to come back, or -1 if there weren't any
+	};
+
+	static const char* modeNames[STRESS_MAX] = {
+		"sprites",
+		"entities",
+		"text",
+		"clients",
+	};
+
+	static perfPhase_e modePhases[STRESS_MAX] = {
+		PERF_RENDERFRAME,
+		PERF_RENDERFRAME,
+		PERF_RENDERFRAME,
+		PERF_SERVER,
+	};
+
+	static Cvar* stress_material = nullptr;
+	static Cvar* stress_font = nullptr;
+	static Cvar* stress_frames = nullptr;
+
+	static stressMode_e mode = STRESS_SPRITES;
+	static stressState_e state = STRESS_IDLE;
+	static int maxCount = 0;
+	static int numSteps = 0;
+	static int step = 0;
+	static int count = 0;
+	static int numFrames = 0;
+	static Uint32 uPrepareStart = 0;
+
+	static Material* pMaterial = nullptr;
+	static Font* pFont = nullptr;
+	static vector<stressEntity_t> vEntities;
+	static vector<string> vStrings;
+	static vector<stressClient_t> vClients;
+	static set<int> sOtherClients;		// clients that were on the server before stress started
+	static Packet clientPacket;
+	static Socket* pProbe = nullptr;	// the connection that pings
+	static Packet probePacket;
+	static bool bPingOut = false;
+	static uint64_t ulPingSent = 0;		// ticks
+
+	// Milliseconds, for the step that's being measured
+	static uint64_t ulLastRun = 0;
+	static float fLastLoad = 0.0f;
+	static vector<float> vFrameTimes;
+	static vector<float> vLoadTimes;
+	static vector<float> vPhaseTimes;
+	static vector<float> vPingTimes;
+	static vector<stressResult_t> vResults;
+
+	void Init() {
+		stress_material = Cvar::Get<char*>("stress_material", "Material (asset/component) drawn by stress sprites and stress entities", 0, "");
+		stress_font = Cvar::Get<char*>("stress_font", "Font (asset/component) rendered by stress text", 0, "fonts/consolas");
+		stress_frames = Cvar::Get<int>("stress_frames", "Frames that each step of a stress run is measured for", 0, 120);
+	}
+
+	bool IsRunning() {
+		return state != STRESS_IDLE;
+	}
+
+	static void FontRegistered(const char* handleName, Font* font) {
+		if (font != nullptr) {
+			pFont = font;
+		}
+	}
+
+	/*
+		Setting up each step
+	*/
+
+	static void DrainClient(stressClient_t& client) {
+		while (client.pSocket->Select()) {
+			Packet packet;
+			if (!client.pSocket->ReadPacket(packet)) {
+				break;
+			}
+			if (packet.packetHead.type == PACKET_CLIENTACCEPT) {
+				client.bAccepted = true;
+			}
+		}
+	}
+
+	static Socket* ConnectToLocalServer() {
+		Socket* pSocket = Socket::Create(Network::net_ipv6->Bool() ? AF_INET6 : AF_INET);
+		if (!pSocket->Connect("localhost", Network::net_port->Integer())) {
+			delete pSocket;
+			R_Message(PRIORITY_WARNING, "stress clients couldn't connect to the local server (start a multiplayer game first)\n");
+			Shutdown();
+			return nullptr;
+		}
+		return pSocket;
+	}
+
+	// Opens at most one connection per frame, since that's as fast as the server accepts them
+	static bool PrepareClients() {
+		if (pProbe == nullptr) {
+			pProbe = ConnectToLocalServer();
+			bPingOut = false;
+			if (pProbe == nullptr) {
+				return false;
+			}
+		}
+		if ((int)vClients.size() < count) {
+			stressClient_t client;
+			client.pSocket = ConnectToLocalServer();
+			client.bAccepted = false;
+			if (client.pSocket == nullptr) {
+				return false;
+			}
+			Packet attempt{ { PACKET_CLIENTATTEMPT, SDL_GetTicks(), 0 }, { 0 } };
+			client.pSocket->SendPacket(attempt);
+			vClients.push_back(client);
+		}
+
+		bool bReady = (int)vClients.size() >= count;
+		for (auto it = vClients.begin(); it != vClients.end(); ++it) {
+			DrainClient(*it);
+			if (!it->bAccepted) {
+				bReady = false;
+			}
+		}
+		return bReady;
+	}
+
+	// Gets the load for the current count together. False if it isn't all there yet.
+	static bool Prepare() {
+		switch (mode) {
+			case STRESS_ENTITIES:
+				while ((int)vEntities.size() < count) {
+					stressEntity_t entity;
+					entity.size = 8 + rand() % 24;
+					entity.x = (float)(rand() % (Video::GetWidth() > entity.size ? Video::GetWidth() - entity.size : 1));
+					entity.y = (float)(rand() % (Video::GetHeight() > entity.size ? Video::GetHeight() - entity.size : 1));
+					entity.vx = (float)(rand() % 400 - 200);
+					entity.vy = (float)(rand() % 400 - 200);
+					vEntities.push_back(entity);
+				}
+				return true;
+			case STRESS_TEXT:
+				while ((int)vStrings.size() < count) {
+					char buffer[64];
+					Sys_snprintf(buffer, sizeof(buffer), "stress %i: the quick brown fox", (int)vStrings.size());
+					vStrings.push_back(buffer);
+				}
+				if (pFont == nullptr) {
+					// Asking again is cheap, and the callback gets the font once it's done loading
+					Video::RegisterFontAsync(stress_font->String(), FontRegistered);
+				}
+				return pFont != nullptr;
+			case STRESS_CLIENTS:
+				return PrepareClients();
+			default:
+				return true;
+		}
+	}
+
+	/*
+		Reporting
+	*/
+
+	static void PrintHeader() {
+		R_Message(PRIORITY_MESSAGE, "%8s %8s %12s %8s %8s %8s %8s %8s %20s %10s %8s\n",
+			"Count", "FPS", "Items/s", "Avg", "p50", "p99", "Max", "Load", PerfStats::PhaseName(modePhases[mode]), "us/item", "Ping");
+		R_Message(PRIORITY_MESSAGE, "%8s %8s %12s %8s %8s %8s %8s %8s %20s %10s %8s\n",
+			"-----", "---", "-------", "---", "---", "---", "---", "----", "-----", "-------", "----");
+	}
+
+	// us/item is what each item added since the step before costs, which is where a cliff shows up
+	static void PrintResult(size_t index) {
+		const stressResult_t& result = vResults[index];
+		float fFPS = result.frame.fAverage > 0.0f ? 1000.0f / result.frame.fAverage : 0.0f;
+		char szMarginal[32] = "-";
+		bool bCliff = false;
+		if (index > 0 && result.count > vResults[index - 1].count) {
+			const stressResult_t& previous = vResults[index - 1];
+			float fMarginal = (result.frame.fAverage - previous.frame.fAverage) * 1000.0f / (result.count - previous.count);
+			Sys_snprintf(szMarginal, sizeof(szMarginal), "%.3f", fMarginal);
+			if (index > 1 && previous.count > vResults[index - 2].count) {
+				float fPreviousMarginal = (previous.frame.fAverage - vResults[index - 2].frame.fAverage) * 1000.0f
+					/ (previous.count - vResults[index - 2].count);
+				bCliff = fPreviousMarginal > 0.0f && fMarginal > fPreviousMarginal * 2.0f;
+			}
+		}
+		char szPing[32] = "-";
+		if (result.fPing >= 0.0f) {
+			Sys_snprintf(szPing, sizeof(szPing), "%.3f", result.fPing);
+		}
+		R_Message(PRIORITY_MESSAGE, "%8i %8.1f %12.0f %8.3f %8.3f %8.3f %8.3f %8.3f %20.3f %10s %8s%s\n",
+			result.count, fFPS, result.count * fFPS, result.frame.fAverage, result.frame.fP50, result.frame.fP99, result.frame.fMax,
+			result.fLoad, result.fPhase, szMarginal, szPing, bCliff ? "  <-- cliff" : "");
+	}
+
+	static float Average(const vector<float>& vSamples) {
+		double dTotal = 0.0;
+		for (auto it = vSamples.begin(); it != vSamples.end(); ++it) {
+			dTotal += *it;
+		}
+		return vSamples.empty() ? 0.0f : (float)(dTotal / vSamples.size());
+	}
+
+	static void FinishStep() {
+		stressResult_t result;
+		result.count = count;
+		result.fLoad = Average(vLoadTimes);
+		result.fPhase = Average(vPhaseTimes);
+		result.fPing = vPingTimes.empty() ? -1.0f : Average(vPingTimes);
+		PerfStats::SummarizeSamples(vFrameTimes.empty() ? nullptr : &vFrameTimes[0], vFrameTimes.size(), result.frame);
+		vResults.push_back(result);
+		PrintResult(vResults.size() - 1);
+
+		if (++step > numSteps) {
+			R_Message(PRIORITY_MESSAGE, "stress %s finished\n", modeNames[mode]);
+			Shutdown();
+			return;
+		}
+		count = (int)((int64_t)maxCount * step / numSteps);
+		state = STRESS_PREPARING;
+		uPrepareStart = SDL_GetTicks();
+	}
+
+	/*
+		Starting and stopping
+	*/
+
+	void Start(const char* szMode, int _count, int _numSteps) {
+		if (state != STRESS_IDLE) {
+			R_Message(PRIORITY_WARNING, "stress %s is already running (stress stop ends it)\n", modeNames[mode]);
+			return;
+		}
+		int i;
+		for (i = 0; i < STRESS_MAX; i++) {
+			if (!stricmp(szMode, modeNames[i])) {
+				break;
+			}
+		}
+		if (i == STRESS_MAX) {
+			R_Message(PRIORITY_WARNING, "unknown stress mode %s\n", szMode);
+			return;
+		}
+		mode = (stressMode_e)i;
+
+		if (mode == STRESS_SPRITES || mode == STRESS_ENTITIES) {
+			pMaterial = stress_material->String()[0] ? Video::RegisterMaterial(stress_material->String()) : nullptr;
+			if (pMaterial == nullptr) {
+				R_Message(PRIORITY_WARNING, "stress %s needs stress_material set to a material\n", modeNames[mode]);
+				return;
+			}
+		}
+		if (mode == STRESS_CLIENTS) {
+			sOtherClients.clear();
+			for (auto it = Network::sOtherConnectedClients.begin(); it != Network::sOtherConnectedClients.end(); ++it) {
+				sOtherClients.insert(*it);
+			}
+			clientPacket.packetHead.type = PACKET_INFOREQUEST;
+			clientPacket.packetHead.packetSize = STRESS_PACKET_SIZE;
+			memset(clientPacket.packetData, 0x5A, STRESS_PACKET_SIZE);
+			probePacket.packetHead.type = PACKET_PING;
+			probePacket.packetHead.packetSize = 0;
+		}
+
+		maxCount = _count;
+		numSteps = _numSteps;
+		step = 0;
+		count = 0;		// the first step is the engine by itself
+		vResults.clear();
+		state = STRESS_PREPARING;
+		uPrepareStart = SDL_GetTicks();
+
+		R_Message(PRIORITY_MESSAGE, "\nstress %s: ramping up to %i in %i steps of %i frames (times in ms)\n", modeNames[mode], maxCount, numSteps,
+			stress_frames->Integer());
+		PrintHeader();
+	}
+
+	// Throws away the load without printing anything
+	void Shutdown() {
+		for (auto it = vClients.begin(); it != vClients.end(); ++it) {
+			delete it->pSocket;
+		}
+		vClients.clear();
+		if (pProbe != nullptr) {
+			delete pProbe;
+			pProbe = nullptr;
+		}
+		bPingOut = false;
+		vPingTimes.clear();
+		vEntities.clear();
+		vStrings.clear();
+		vFrameTimes.clear();
+		vLoadTimes.clear();
+		vPhaseTimes.clear();
+		pMaterial = nullptr;
+		pFont = nullptr;
+		state = STRESS_IDLE;
+	}
+
+	void Stop() {
+		if (state == STRESS_IDLE) {
+			R_Message(PRIORITY_WARNING, "stress isn't running\n");
+			return;
+		}
+		R_Message(PRIORITY_MESSAGE, "stress %s stopped after %i of %i steps\n", modeNames[mode], step, numSteps);
+		Shutdown();
+	}
+
+	/*
+		Every frame
+	*/
+
+	// Called by the main thread at the start of every frame, right after PerfStats::FrameBoundary
+	void Frame() {
+		switch (state) {
+			case STRESS_PREPARING:
+				if (Prepare()) {
+					state = STRESS_WARMUP;
+					numFrames = 0;
+				}
+				else if (state != STRESS_IDLE && SDL_GetTicks() - uPrepareStart > STRESS_READY_TIMEOUT) {
+					R_Message(PRIORITY_WARNING, "stress %s gave up waiting for %s\n", modeNames[mode], mode == STRESS_TEXT ? "the font" : "clients");
+					Shutdown();
+				}
+				break;
+			case STRESS_WARMUP:
+				if (++numFrames >= STRESS_WARMUP_FRAMES) {
+					state = STRESS_MEASURING;
+					numFrames = 0;
+					vFrameTimes.clear();
+					vLoadTimes.clear();
+					vPhaseTimes.clear();
+					vPingTimes.clear();
+				}
+				break;
+			case STRESS_MEASURING:
+				{
+					// PerfStats has just finished timing the last frame, which ran the load
+					float fFrameTime, fPhases[PERF_MAX];
+					if (PerfStats::GetLastFrame(&fFrameTime, fPhases)) {
+						vFrameTimes.push_back(fFrameTime);
+						vLoadTimes.push_back(fLastLoad);
+						vPhaseTimes.push_back(fPhases[modePhases[mode]]);
+					}
+					if (numFrames++ >= stress_frames->Integer() - 1) {
+						FinishStep();
+					}
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	static void DrawSprites() {
+		int columns = (int)ceil(sqrt((double)count));
+		float fSize = 100.0f / columns;
+		for (int i = 0; i < count; i++) {
+			Video::DrawMaterial(pMaterial, (i % columns) * fSize, (i / columns) * fSize, fSize, fSize);
+		}
+	}
+
+	static void UpdateEntities(float fSeconds) {
+		int width = Video::GetWidth();
+		int height = Video::GetHeight();
+		for (auto it = vEntities.begin(); it != vEntities.end(); ++it) {
+			it->x += it->vx * fSeconds;
+			it->y += it->vy * fSeconds;
+			if (it->x < 0.0f || it->x + it->size > width) {
+				it->vx = -it->vx;
+				it->x = it->x < 0.0f ? 0.0f : (float)(width - it->size);
+			}
+			if (it->y < 0.0f || it->y + it->size > height) {
+				it->vy = -it->vy;
+				it->y = it->y < 0.0f ? 0.0f : (float)(height - it->size);
+			}
+			Video::DrawMaterialAbs(pMaterial, (int)it->x, (int)it->y, it->size, it->size);
+		}
+	}
+
+	static void RenderText() {
+		int width = Video::GetWidth();
+		int height = Video::GetHeight();
+		int x = 0, y = 0;
+		for (auto it = vStrings.begin(); it != vStrings.end(); ++it) {
+			Video::RenderSolidText(pFont, it->c_str(), x, y, 255, 255, 255);
+			y += 16;
+			if (y >= height) {
+				y = 0;
+				x = (x + 240) % (width > 240 ? width : 240);
+			}
+		}
+	}
+
+	// Keeps one ping out at a time. One that got lost is given up on after STRESS_READY_TIMEOUT.
+	// The pong's send time is when the network thread answered, so our own frame doesn't count against it.
+	static void Ping() {
+		while (pProbe->Select()) {
+			if (!pProbe->ReadPacket(probePacket)) {
+				break;
+			}
+			if (probePacket.packetHead.type == PACKET_PONG && bPingOut) {
+				// A pass that started just before the ping went out is stamped a little before it, too
+				uint64_t ulAnswered = probePacket.packetHead.sendTime;
+				vPingTimes.push_back(ulAnswered > ulPingSent ? (float)(ulAnswered - ulPingSent) : 0.0f);
+				bPingOut = false;
+			}
+		}
+
+		uint64_t ticks = SDL_GetTicks();
+		if (!bPingOut || ticks - ulPingSent > STRESS_READY_TIMEOUT) {
+			probePacket.packetHead.type = PACKET_PING;
+			probePacket.packetHead.sendTime = ticks;
+			probePacket.packetHead.packetSize = 0;
+			pProbe->SendPacket(probePacket);
+			ulPingSent = ticks;
+			bPingOut = true;
+		}
+	}
+
+	// Every stress client sends a packet, and the server answers every one of them
+	static void ExchangePackets() {
+		for (auto it = vClients.begin(); it != vClients.end(); ++it) {
+			clientPacket.packetHead.sendTime = SDL_GetTicks();
+			it->pSocket->SendPacket(clientPacket);
+			DrainClient(*it);
+		}
+		for (auto it = Network::sOtherConnectedClients.begin(); it != Network::sOtherConnectedClients.end(); ++it) {
+			if (sOtherClients.find(*it) == sOtherClients.end()) {
+				Network::Server::QueuePacket(PACKET_INFOREQUESTED, *it, nullptr);
+			}
+		}
+	}
+
+	// Called by the main thread after the server and client have run, so that anything drawn lands in this frame
+	void Run() {
+		if (state != STRESS_WARMUP && state != STRESS_MEASURING) {
+			ulLastRun = 0;
+			return;
+		}
+
+		PROFILE_ZONE("Stress::Run");
+		uint64_t ulStart = Timer::Nanoseconds();
+		switch (mode) {
+			case STRESS_SPRITES:
+				DrawSprites();
+				break;
+			case STRESS_ENTITIES:
+				{
+					float fSeconds = ulLastRun != 0 ? (ulStart - ulLastRun) / 1000000000.0f : 0.0f;
+					UpdateEntities(fSeconds > 0.1f ? 0.1f : fSeconds);
+				}
+				break;
+			case STRESS_TEXT:
+				RenderText();
+				break;
+			case STRESS_CLIENTS:
+				ExchangePackets();
+				Ping();
+				break;
+			default:
+				break;
+		}
+		ulLastRun = ulStart;
+		fLastLoad = (Timer::Nanoseconds() - ulStart) / 1000000.0f;
+	}
+}
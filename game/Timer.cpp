@@ -1,6 +1,22 @@
 #include "sys_local.h"
 
 // Based off of LazyFoo' LTimer implementation
+// Runs off of the performance counter, so that frame pacing and profiling can work with fractions of a millisecond
+
+static uint64_t ulCounterFrequency = SDL_GetPerformanceFrequency();
+static uint64_t ulCounterStart = SDL_GetPerformanceCounter();
+
+// Converts performance counter ticks to nanoseconds. Split into whole seconds first so that the multiply can't overflow.
+static uint64_t CounterToNanoseconds(uint64_t ulCounter) {
+	uint64_t ulSeconds = ulCounter / ulCounterFrequency;
+	uint64_t ulRemainder = ulCounter % ulCounterFrequency;
+	return ulSeconds * 1000000000ULL + (ulRemainder * 1000000000ULL) / ulCounterFrequency;
+}
+
+// Nanoseconds since startup
+uint64_t Timer::Nanoseconds() {
+	return CounterToNanoseconds(SDL_GetPerformanceCounter() - ulCounterStart);
+}
 
 Timer::Timer() {
 	sTimerName = "<unnamed timer>";
@@ -8,21 +24,21 @@ Timer::Timer() {
 }
 
 Timer::Timer(const string& sName) {
-	Timer();
 	sTimerName = sName;
+	Stop();
 }
 
 void Timer::Start() {
 	bIsStarted = true;
 	bIsPaused = false;
 
-	ulStartTicks = SDL_GetTicks();
-	ulPausedTicks = 0;
+	ulStartCounter = SDL_GetPerformanceCounter();
+	ulPausedCounter = 0;
 }
 
 void Timer::Stop() {
 	bIsStarted = bIsPaused = false;
-	ulStartTicks = ulPausedTicks = 0;
+	ulStartCounter = ulPausedCounter = 0;
 }
 
 void Timer::Pause() {
@@ -35,8 +51,8 @@ void Timer::Pause() {
 	}
 
 	bIsPaused = true;
-	ulPausedTicks = SDL_GetTicks() - ulStartTicks;
-	ulStartTicks = 0;
+	ulPausedCounter = SDL_GetPerformanceCounter() - ulStartCounter;
+	ulStartCounter = 0;
 }
 
 void Timer::Unpause() {
@@ -49,17 +65,25 @@ void Timer::Unpause() {
 	}
 
 	bIsPaused = false;
-	ulStartTicks = SDL_GetTicks() - ulPausedTicks;
-	ulPausedTicks = 0;
+	ulStartCounter = SDL_GetPerformanceCounter() - ulPausedCounter;
+	ulPausedCounter = 0;
 }
 
-unsigned long Timer::GetTicks() {
+uint64_t Timer::GetNanoseconds() {
 	if(bIsStarted) {
 		if(bIsPaused) {
-			return ulPausedTicks;
+			return CounterToNanoseconds(ulPausedCounter);
 		} else {
-			return SDL_GetTicks() - ulStartTicks;
+			return CounterToNanoseconds(SDL_GetPerformanceCounter() - ulStartCounter);
 		}
 	}
 	return 0;
-}
\ No newline at end of file
+}
+
+uint64_t Timer::GetMicroseconds() {
+	return GetNanoseconds() / 1000;
+}
+
+unsigned long Timer::GetTicks() {
+	return (unsigned long)(GetNanoseconds() / 1000000);
+}
@@ -0,0 +1,648 @@
+#include "sys_local.h"
+#include <math.h>
+#ifdef _WIN32
+#include <WinSock2.h>
+#include <Ws2TcpIp.h>
+#endif
+
+/*
+ * Connections over UDP. Every datagram starts with a header that acks whatever we've heard from the other side:
+ *	uint8_t		protocol (RAPTURE_NETPROTOCOL)
+ *	uint8_t		flags (UDP_FLAG_*)
+ *	uint16_t	sequence number of this datagram
+ *	uint16_t	newest sequence number heard from the other side (with UDP_FLAG_ACKS)
+ *	uint32_t	bit n set if the one n + 1 before that was heard too
+ * With UDP_FLAG_MESSAGE, one packet follows:
+ *	uint8_t		channel
+ *	uint16_t	message id, which counts up separately on each channel
+ *	uint32_t	packet type
+ *	uint64_t	send time
+ *	uint32_t	size, char[] data
+ *
+ * When a datagram gets acked, so does the message in it. Reliable messages that haven't been acked within the retransmit
+ * timeout (worked out from the smoothed RTT and its variance as in RFC 6298, doubling with every resend) go out again
+ * in a new datagram. Something that came in gets a bare ack if there was nothing going the other way to carry it.
+ * Closing a connection sends UDP_FLAG_DISCONNECT, so that the other end sees it drop the same way that a TCP socket would.
+ */
+
+#define UDP_FLAG_MESSAGE		1
+#define UDP_FLAG_DISCONNECT		2
+#define UDP_FLAG_ACKS			4
+
+#define UDP_HEADER_SIZE			10
+
+static ObjectPool<UDPSocket>& udpSocketPool = *new ObjectPool<UDPSocket>("UDPSocket", RAPTURE_DEFAULT_MAXCLIENTS);
+
+static Metric* pMetricRetransmits = nullptr;
+static Metric* pMetricStale = nullptr;
+static Metric* pMetricDuplicates = nullptr;
+static Metric* pMetricRTT = nullptr;
+
+// True if sequence a comes after b, allowing for wraparound
+static bool SequenceNewer(uint16_t a, uint16_t b) {
+	return (int16_t)(a - b) > 0;
+}
+
+template<typename T>
+static void Put(vector<char>& out, T value) {
+	out.insert(out.end(), (const char*)&value, (const char*)&value + sizeof(T));
+}
+
+template<typename T>
+static bool Get(const char*& data, const char* end, T& value) {
+	if (end - data < (ptrdiff_t)sizeof(T)) {
+		return false;
+	}
+	memcpy(&value, data, sizeof(T));
+	data += sizeof(T);
+	return true;
+}
+
+// Enough of an address to tell peers apart
+static string AddressKey(const sockaddr_storage& address) {
+	switch (address.ss_family) {
+		case AF_INET6:
+		{
+			const sockaddr_in6* in6 = (const sockaddr_in6*)&address;
+			return string((const char*)&in6->sin6_port, sizeof(in6->sin6_port)) + string((const char*)&in6->sin6_addr, sizeof(in6->sin6_addr));
+		}
+		case AF_INET:
+		{
+			const sockaddr_in* in4 = (const sockaddr_in*)&address;
+			return string((const char*)&in4->sin_port, sizeof(in4->sin_port)) + string((const char*)&in4->sin_addr, sizeof(in4->sin_addr));
+		}
+	}
+	return string();
+}
+
+/* Construction */
+
+// UDP sockets come out of a pool too, since the server makes one for every address it hears from
+void* UDPSocket::operator new(size_t size) {
+	return udpSocketPool.AllocateObject(size);
+}
+
+void UDPSocket::operator delete(void* ptr) {
+	udpSocketPool.Free(ptr);
+}
+
+UDPSocket::UDPSocket(int af_) : Socket(af_, SOCK_DGRAM), pListener(nullptr) {
+	internalSocket = socket(af, type, IPPROTO_UDP);
+	if (internalSocket == INVALID_SOCKET && af == AF_INET6) {
+		// retry using IPv4
+		af = AF_INET;
+		internalSocket = socket(af, type, IPPROTO_UDP);
+	}
+
+	int yes = 1;
+	int no = 0;
+	setsockopt(internalSocket, SOL_SOCKET, SO_REUSEADDR, (const char*)&yes, sizeof(yes));
+	if (af == AF_INET6) {
+		setsockopt(internalSocket, IPPROTO_IPV6, IPV6_V6ONLY, (const char*)&no, sizeof(no));
+	}
+	Reset();
+}
+
+// A peer of a listening socket, which goes through the listener's socket
+UDPSocket::UDPSocket(UDPSocket* listener, const sockaddr_storage& address, int addressSize) : Socket(listener->af, SOCK_DGRAM), pListener(listener) {
+	Reset();
+	remoteAddress = address;
+	remoteAddressSize = addressSize;
+	lastHeardFrom = ulCreated = SDL_GetTicks();
+}
+
+void UDPSocket::Reset() {
+	if (pMetricRetransmits == nullptr) {
+		pMetricRetransmits = Metrics::Counter("net.udp.retransmits");
+		pMetricStale = Metrics::Counter("net.udp.stale");
+		pMetricDuplicates = Metrics::Counter("net.udp.duplicates");
+		pMetricRTT = Metrics::Histogram("net.udp.rtt_us");
+	}
+
+	memset(&remoteAddress, 0, sizeof(remoteAddress));
+	remoteAddressSize = 0;
+	bClosed = false;
+	ulMaxPeers = 0;
+	ulCreated = 0;
+	localSequence = 0;
+	remoteSequence = 0;
+	receivedBits = 0;
+	bReceivedAny = false;
+	bAckPending = false;
+	memset(sentDatagrams, 0, sizeof(sentDatagrams));
+	fSmoothedRTT = fRTTVariance = 0.0f;
+	bHaveRTT = false;
+	for (int i = 0; i < CHANNEL_MAX; i++) {
+		channel_t& channel = channels[i];
+		channel.nextSendId = channel.nextReceiveId = 0;
+		channel.bReceivedAny = false;
+		memset(channel.bReceived, 0, sizeof(channel.bReceived));
+		channel.mEarly.clear();
+		channel.vUnacked.clear();
+		channel.vWaiting.clear();
+	}
+	vInbox.clear();
+}
+
+UDPSocket::~UDPSocket() {
+	Disconnect();
+	if (pListener != nullptr) {
+		pListener->RemovePeer(this);
+		return;		// the socket belongs to the listener
+	}
+
+	// Peers that were never handed out have nobody else to delete them; the rest just lose their connection
+	while (!vPendingPeers.empty()) {
+		UDPSocket* pPeer = vPendingPeers.front();
+		vPendingPeers.pop_front();
+		mPeers.erase(AddressKey(pPeer->remoteAddress));
+		pPeer->pListener = nullptr;
+		delete pPeer;
+	}
+	for (auto it = mPeers.begin(); it != mPeers.end(); ++it) {
+		it->second->pListener = nullptr;
+		it->second->bClosed = true;
+	}
+	mPeers.clear();
+	if (internalSocket != INVALID_SOCKET) {
+		closesocket(internalSocket);
+	}
+}
+
+void UDPSocket::RemovePeer(UDPSocket* peer) {
+	mPeers.erase(AddressKey(peer->remoteAddress));
+	auto it = find(vPendingPeers.begin(), vPendingPeers.end(), peer);
+	if (it != vPendingPeers.end()) {
+		vPendingPeers.erase(it);
+	}
+}
+
+// A peer that hasn't acked anything we've sent never proved that it's at the address it came from (spoofed, or a scan).
+// Those get dropped after a few seconds instead of holding a slot for all of net_timeout.
+void UDPSocket::ExpireHalfOpenPeers() {
+	uint64_t ticks = SDL_GetTicks();
+	vector<UDPSocket*> vExpired;
+	for (auto it = mPeers.begin(); it != mPeers.end(); ++it) {
+		UDPSocket* pPeer = it->second;
+		if (!pPeer->bHaveRTT && !pPeer->bClosed && ticks - pPeer->ulCreated > NET_UDP_HALFOPEN_TIMEOUT) {
+			vExpired.push_back(pPeer);
+		}
+	}
+	for (auto it = vExpired.begin(); it != vExpired.end(); ++it) {
+		UDPSocket* pPeer = *it;
+		pPeer->bClosed = true;	// no goodbye, that would just bounce off of whoever got spoofed
+		if (find(vPendingPeers.begin(), vPendingPeers.end(), pPeer) != vPendingPeers.end()) {
+			delete pPeer;		// nobody else has it yet
+		}
+		// Handed out ones read as closed, and whoever has them closes them
+	}
+}
+
+socket_t UDPSocket::Handle() {
+	return pListener != nullptr ? pListener->internalSocket : internalSocket;
+}
+
+/* Connecting */
+
+// Binds the socket. Anybody that sends us a message becomes a pending connection, until there are backlog more of them
+// than net_maxclients.
+bool UDPSocket::StartListening(unsigned short port, uint32_t backlog) {
+	addrinfo hints;
+	addrinfo* value;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = af;
+	hints.ai_socktype = type;
+	hints.ai_flags = AI_PASSIVE;
+
+	char szPort[16] = { 0 };
+	sprintf(szPort, "%i", port);
+
+	if (getaddrinfo(nullptr, szPort, &hints, &value) != 0) {
+		R_Message(PRIORITY_ERROR, "Failed to look up a UDP address for port %s\n", szPort);
+		return false;
+	}
+	int code = ::bind(internalSocket, value->ai_addr, value->ai_addrlen);
+	freeaddrinfo(value);
+	if (code != 0) {
+		R_Message(PRIORITY_ERROR, "Failed to bind UDP socket on port %s (code %i)\n", szPort, code);
+		return false;
+	}
+
+	if (!SetNonBlocking()) {
+		return false;
+	}
+	ulMaxPeers = backlog + (Network::net_maxclients != nullptr ? Network::net_maxclients->AtomicInteger() : RAPTURE_DEFAULT_MAXCLIENTS);
+
+	R_Message(PRIORITY_MESSAGE, "Now listening on port %i (UDP)\n", port);
+	return true;
+}
+
+// Nothing goes over the wire here; the server finds out about us with the first message that we send
+bool UDPSocket::Connect(const char* hostname, unsigned short port) {
+	if (!Resolve(hostname, port, remoteAddress, remoteAddressSize)) {
+		return false;
+	}
+
+	// Bind to any port, so that reads work before anything has been sent
+	sockaddr_storage localAddress;
+	memset(&localAddress, 0, sizeof(localAddress));
+	localAddress.ss_family = af;
+	if (::bind(internalSocket, (sockaddr*)&localAddress, af == AF_INET6 ? sizeof(sockaddr_in6) : sizeof(sockaddr_in)) != 0) {
+		int errorCode;
+		const char* errorMsg = Sys_SocketError(errorCode);
+		R_Message(PRIORITY_ERROR, "UDPSocket::Connect failed to bind (%i: %s)\n", errorCode, errorMsg);
+		remoteAddressSize = 0;
+		return false;
+	}
+
+	if (!SetNonBlocking()) {
+		return false;
+	}
+
+	lastHeardFrom = SDL_GetTicks();
+	return true;
+}
+
+// Tells the other side that we're going away. Called automatically on destroyed.
+void UDPSocket::Disconnect() {
+	if (remoteAddressSize > 0 && !bClosed) {
+		SendDatagram(UDP_FLAG_DISCONNECT, -1, 0, nullptr);
+	}
+}
+
+Socket* UDPSocket::CheckPendingConnections() {
+	if (vPendingPeers.empty()) {
+		return nullptr;
+	}
+	UDPSocket* pPeer = vPendingPeers.front();
+	vPendingPeers.pop_front();
+
+	char ipBuffer[INET6_ADDRSTRLEN] = { 0 };
+	if (pPeer->remoteAddress.ss_family == AF_INET6) {
+		inet_ntop(AF_INET6, &((sockaddr_in6*)&pPeer->remoteAddress)->sin6_addr, ipBuffer, sizeof(ipBuffer));
+	}
+	else {
+		inet_ntop(AF_INET, &((sockaddr_in*)&pPeer->remoteAddress)->sin_addr, ipBuffer, sizeof(ipBuffer));
+	}
+	R_Message(PRIORITY_MESSAGE, "Pending connection: %s (UDP)\n", ipBuffer);
+	return pPeer;
+}
+
+/* Sending */
+
+bool UDPSocket::SendDatagram(uint8_t flags, int channel, uint16_t messageId, const vector<char>* message) {
+	socket_t handle = Handle();
+	if (handle == INVALID_SOCKET || remoteAddressSize == 0) {
+		return false;
+	}
+
+	if (bReceivedAny) {
+		flags |= UDP_FLAG_ACKS;
+	}
+	vector<char> vDatagram;
+	vDatagram.reserve(UDP_HEADER_SIZE + 3 + (message != nullptr ? message->size() : 0));
+	Put<uint8_t>(vDatagram, RAPTURE_NETPROTOCOL);
+	Put<uint8_t>(vDatagram, flags);
+	Put<uint16_t>(vDatagram, localSequence);
+	Put<uint16_t>(vDatagram, remoteSequence);
+	Put<uint32_t>(vDatagram, receivedBits);
+	if (message != nullptr) {
+		Put<uint8_t>(vDatagram, (uint8_t)channel);
+		Put<uint16_t>(vDatagram, messageId);
+		vDatagram.insert(vDatagram.end(), message->begin(), message->end());
+	}
+
+	sentDatagram_t& sent = sentDatagrams[localSequence % NET_UDP_SENTHISTORY];
+	sent.sequence = localSequence;
+	sent.bUsed = true;
+	sent.bAcked = false;
+	sent.ulSent = Timer::Nanoseconds();
+	sent.channel = message != nullptr ? channel : -1;
+	sent.messageId = messageId;
+	localSequence++;
+	bAckPending = false;
+
+	int numSent = sendto(handle, &vDatagram[0], vDatagram.size(), 0, (sockaddr*)&remoteAddress, remoteAddressSize);
+	if (numSent < 0) {
+		int errorNum;
+		const char* errMsg = Sys_SocketError(errorNum);
+		R_Message(PRIORITY_WARNING, "UDPSocket::SendDatagram: %s (error code %i)\n", errMsg, errorNum);
+		return false;
+	}
+	return true;
+}
+
+// Puts reliable messages on the wire for as long as they fit in the window
+void UDPSocket::SendWaiting(int channelNum) {
+	channel_t& channel = channels[channelNum];
+	while (!channel.vWaiting.empty()) {
+		// The window is counted from the oldest message still in flight, so that the other end can always tell old from new
+		if (!channel.vUnacked.empty()
+			&& (uint16_t)(channel.vWaiting.front().messageId - channel.vUnacked.front().messageId) >= NET_UDP_RELIABLEWINDOW) {
+			break;
+		}
+		channel.vUnacked.push_back(move(channel.vWaiting.front()));
+		channel.vWaiting.pop_front();
+
+		outgoingMessage_t& message = channel.vUnacked.back();
+		message.ulLastSent = Timer::Nanoseconds();
+		message.numSends = 1;
+		SendDatagram(UDP_FLAG_MESSAGE, channelNum, message.messageId, &message.vData);
+	}
+}
+
+bool UDPSocket::SendPacket(Packet& outgoing) {
+	if (remoteAddressSize == 0 || bClosed) {
+		return false;
+	}
+
+	int channelNum = Network::PacketChannel(outgoing.packetHead.type);
+	channel_t& channel = channels[channelNum];
+	outgoingMessage_t message;
+	message.messageId = channel.nextSendId++;
+	message.ulLastSent = 0;
+	message.numSends = 0;
+	message.vData.reserve(16 + outgoing.packetHead.packetSize);
+	Put<uint32_t>(message.vData, outgoing.packetHead.type);
+	Put<uint64_t>(message.vData, outgoing.packetHead.sendTime);
+	Put<uint32_t>(message.vData, (uint32_t)outgoing.packetHead.packetSize);
+	message.vData.insert(message.vData.end(), outgoing.packetData, outgoing.packetData + outgoing.packetHead.packetSize);
+
+	lastSpoken = SDL_GetTicks();
+	if (channelNum == CHANNEL_UNRELIABLE_SEQUENCED) {
+		return SendDatagram(UDP_FLAG_MESSAGE, channelNum, message.messageId, &message.vData);
+	}
+	channel.vWaiting.push_back(move(message));
+	SendWaiting(channelNum);
+	return true;
+}
+
+uint64_t UDPSocket::RetransmitTimeout(int numSends) {
+	float fTimeout = bHaveRTT ? fSmoothedRTT + 4.0f * fRTTVariance : (float)NET_UDP_INITIAL_RTO;
+	uint64_t ulTimeout = fTimeout < NET_UDP_MIN_RTO ? NET_UDP_MIN_RTO : (uint64_t)fTimeout;
+	for (int i = 1; i < numSends && ulTimeout < NET_UDP_MAX_RTO; i++) {
+		ulTimeout *= 2;
+	}
+	return ulTimeout > NET_UDP_MAX_RTO ? NET_UDP_MAX_RTO : ulTimeout;
+}
+
+// Resends reliable messages that have gone unacked for too long, and acks what came in if nothing else did
+void UDPSocket::Update() {
+	if (remoteAddressSize == 0 || bClosed) {
+		return;
+	}
+
+	uint64_t ulNow = Timer::Nanoseconds();
+	for (int i = 0; i < CHANNEL_MAX; i++) {
+		if (i == CHANNEL_UNRELIABLE_SEQUENCED) {
+			continue;
+		}
+		for (auto it = channels[i].vUnacked.begin(); it != channels[i].vUnacked.end(); ++it) {
+			if (ulNow - it->ulLastSent >= RetransmitTimeout(it->numSends) * 1000000ULL) {
+				it->ulLastSent = ulNow;
+				it->numSends++;
+				pMetricRetransmits->Add(1);
+				SendDatagram(UDP_FLAG_MESSAGE, i, it->messageId, &it->vData);
+			}
+		}
+	}
+
+	if (bAckPending) {
+		SendDatagram(0, -1, 0, nullptr);
+	}
+}
+
+/* Receiving */
+
+void UDPSocket::ProcessAck(uint16_t sequence) {
+	sentDatagram_t& sent = sentDatagrams[sequence % NET_UDP_SENTHISTORY];
+	if (!sent.bUsed || sent.bAcked || sent.sequence != sequence) {
+		return;
+	}
+	sent.bAcked = true;
+
+	// Every datagram (resends included) has its own send time, so each ack is a clean sample
+	float fSample = (Timer::Nanoseconds() - sent.ulSent) / 1000000.0f;
+	pMetricRTT->Record((int64_t)(fSample * 1000.0f));
+	if (!bHaveRTT) {
+		fSmoothedRTT = fSample;
+		fRTTVariance = fSample / 2.0f;
+		bHaveRTT = true;
+	}
+	else {
+		fRTTVariance = 0.75f * fRTTVariance + 0.25f * fabs(fSmoothedRTT - fSample);
+		fSmoothedRTT = 0.875f * fSmoothedRTT + 0.125f * fSample;
+	}
+
+	if (sent.channel < 0 || sent.channel == CHANNEL_UNRELIABLE_SEQUENCED) {
+		return;
+	}
+	deque<outgoingMessage_t>& vUnacked = channels[sent.channel].vUnacked;
+	for (auto it = vUnacked.begin(); it != vUnacked.end(); ++it) {
+		if (it->messageId == sent.messageId) {
+			vUnacked.erase(it);
+			break;
+		}
+	}
+	SendWaiting(sent.channel);
+}
+
+void UDPSocket::Deliver(int channelNum, uint16_t messageId, Packet& packet) {
+	channel_t& channel = channels[channelNum];
+	if (channelNum == CHANNEL_UNRELIABLE_SEQUENCED) {
+		if (channel.bReceivedAny && !SequenceNewer(messageId, channel.nextReceiveId - 1)) {
+			pMetricStale->Add(1);
+			return;
+		}
+		channel.bReceivedAny = true;
+		channel.nextReceiveId = messageId + 1;
+		vInbox.push_back(packet);
+		return;
+	}
+
+	// Reliable: anything before nextReceiveId has been delivered already
+	if (SequenceNewer(channel.nextReceiveId, messageId) || (uint16_t)(messageId - channel.nextReceiveId) >= NET_UDP_RELIABLEWINDOW) {
+		pMetricDuplicates->Add(1);
+		return;
+	}
+
+	if (channelNum == CHANNEL_RELIABLE_UNORDERED) {
+		if (channel.bReceived[messageId % NET_UDP_RELIABLEWINDOW]) {
+			pMetricDuplicates->Add(1);
+			return;
+		}
+		channel.bReceived[messageId % NET_UDP_RELIABLEWINDOW] = true;
+		vInbox.push_back(packet);
+		while (channel.bReceived[channel.nextReceiveId % NET_UDP_RELIABLEWINDOW]) {
+			channel.bReceived[channel.nextReceiveId % NET_UDP_RELIABLEWINDOW] = false;
+			channel.nextReceiveId++;
+		}
+		return;
+	}
+
+	// Ordered: hold on to it until everything before it has come in
+	if (channel.mEarly.find(messageId) != channel.mEarly.end()) {
+		pMetricDuplicates->Add(1);
+		return;
+	}
+	channel.mEarly[messageId] = packet;
+	for (auto it = channel.mEarly.find(channel.nextReceiveId); it != channel.mEarly.end(); it = channel.mEarly.find(channel.nextReceiveId)) {
+		vInbox.push_back(it->second);
+		channel.mEarly.erase(it);
+		channel.nextReceiveId++;
+	}
+}
+
+void UDPSocket::Receive(const char* data, size_t size) {
+	const char* end = data + size;
+	uint8_t protocol, flags;
+	uint16_t sequence, ack;
+	uint32_t ackBits;
+	if (!Get(data, end, protocol) || !Get(data, end, flags) || !Get(data, end, sequence) || !Get(data, end, ack)
+		|| !Get(data, end, ackBits) || protocol != RAPTURE_NETPROTOCOL) {
+		return;
+	}
+	lastHeardFrom = SDL_GetTicks();
+
+	// Remember this one for the acks that we send back
+	if (!bReceivedAny) {
+		remoteSequence = sequence;
+		receivedBits = 0;
+		bReceivedAny = true;
+	}
+	else if (SequenceNewer(sequence, remoteSequence)) {
+		uint16_t shift = sequence - remoteSequence;
+		if (shift < NET_UDP_ACKBITS) {
+			receivedBits = (receivedBits << shift) | (1u << (shift - 1));
+		}
+		else {
+			receivedBits = shift == NET_UDP_ACKBITS ? (1u << (NET_UDP_ACKBITS - 1)) : 0;
+		}
+		remoteSequence = sequence;
+	}
+	else if (sequence != remoteSequence) {
+		uint16_t distance = remoteSequence - sequence;
+		if (distance <= NET_UDP_ACKBITS) {
+			receivedBits |= 1u << (distance - 1);
+		}
+	}
+
+	if (flags & UDP_FLAG_ACKS) {
+		ProcessAck(ack);
+		for (int i = 0; i < NET_UDP_ACKBITS; i++) {
+			if (ackBits & (1u << i)) {
+				ProcessAck(ack - 1 - i);
+			}
+		}
+	}
+	if (flags & UDP_FLAG_DISCONNECT) {
+		bClosed = true;
+		return;
+	}
+	if (!(flags & UDP_FLAG_MESSAGE)) {
+		return;
+	}
+
+	uint8_t channel;
+	uint16_t messageId;
+	uint32_t packetType, packetSize;
+	uint64_t sendTime;
+	if (!Get(data, end, channel) || !Get(data, end, messageId) || !Get(data, end, packetType) || !Get(data, end, sendTime)
+		|| !Get(data, end, packetSize) || channel >= CHANNEL_MAX || packetSize > MAX_PACKET_DATASIZE || (size_t)(end - data) < packetSize) {
+		return;
+	}
+	Packet packet;
+	packet.packetHead.type = packetType;
+	packet.packetHead.sendTime = sendTime;
+	packet.packetHead.packetSize = packetSize;
+	memcpy(packet.packetData, data, packetSize);
+
+	bAckPending = true;
+	Deliver(channel, messageId, packet);
+}
+
+// Reads everything that's waiting on the socket. A listening socket sorts it out among its peers.
+void UDPSocket::Pump() {
+	if (pListener != nullptr) {
+		pListener->Pump();
+		return;
+	}
+	if (internalSocket == INVALID_SOCKET) {
+		return;
+	}
+
+	if (vReceiveBuffer.empty()) {
+		vReceiveBuffer.resize(NET_UDP_MAXDATAGRAM);
+	}
+	char* buffer = &vReceiveBuffer[0];
+	string sRemoteKey = remoteAddressSize > 0 ? AddressKey(remoteAddress) : string();
+	while (true) {
+		sockaddr_storage from;
+		socklen_t fromSize = sizeof(from);
+		int numRead = recvfrom(internalSocket, buffer, vReceiveBuffer.size(), 0, (sockaddr*)&from, &fromSize);
+		if (numRead < 0) {
+			int errorNum;
+			Sys_SocketError(errorNum);
+#ifdef _WIN32
+			if (errorNum == WSAECONNRESET) {
+				continue;	// something that we sent bounced off of a closed port; the timeout takes care of that
+			}
+#endif
+			break;	// nothing more waiting
+		}
+
+		string sKey = AddressKey(from);
+		if (remoteAddressSize > 0) {
+			// Connected, so anything from anywhere else is noise
+			if (sKey == sRemoteKey) {
+				Receive(buffer, numRead);
+			}
+			continue;
+		}
+
+		UDPSocket* pPeer;
+		auto it = mPeers.find(sKey);
+		if (it != mPeers.end()) {
+			pPeer = it->second;
+		}
+		else {
+			// Only a message starts a new connection, so stray acks and goodbyes from old ones don't
+			if (numRead < UDP_HEADER_SIZE || !(buffer[1] & UDP_FLAG_MESSAGE)) {
+				continue;
+			}
+			if (mPeers.size() >= ulMaxPeers) {
+				continue;	// full up; they'll resend, and get in once a slot frees up
+			}
+			pPeer = new UDPSocket(this, from, (int)fromSize);
+			mPeers[sKey] = pPeer;
+			vPendingPeers.push_back(pPeer);
+		}
+		pPeer->Receive(buffer, numRead);
+	}
+	if (remoteAddressSize == 0) {
+		ExpireHalfOpenPeers();
+	}
+}
+
+// Listening: true if there's a new connection. Connected: true if there's a packet to read (or the connection closed).
+bool UDPSocket::Select() {
+	Pump();
+	if (remoteAddressSize == 0) {
+		return !vPendingPeers.empty();
+	}
+	Update();
+	return !vInbox.empty() || bClosed;
+}
+
+// False once the connection has closed and everything that came in before that has been read
+bool UDPSocket::ReadPacket(Packet& incoming) {
+	if (vInbox.empty()) {
+		return false;
+	}
+	Packet& front = vInbox.front();
+	incoming.packetHead = front.packetHead;
+	memcpy(incoming.packetData, front.packetData, front.packetHead.packetSize);
+	vInbox.pop_front();
+	return true;
+}
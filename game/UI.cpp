@@ -13,10 +13,12 @@ namespace UI {
 	static Texture* uiTextures[NUM_UI_VISIBLE];
 	static int lastActiveLayer;
 	static UIDataSource* src = nullptr;
+	static bool bNullUI = false;	// headless, nothing gets created and every call does nothing
 	WebView* currentFocus = nullptr;
 	WebCore* wc = nullptr;
 	WebSession* sess = nullptr;
 	Cvar* ui_debugport = nullptr;
+	static CvarRef<char*> fs_homepath = CVAR_REF(char*, "fs_homepath");
 
 	void StartDrawingMenu(Menu* menu) {
 		vDrawMenus.push_back(menu->GetWebView());
@@ -37,6 +39,11 @@ namespace UI {
 	/* UI Class */
 	void Initialize() {
 		R_Message(PRIORITY_NOTE, "UI::Initialize()\n");
+		if (RaptureGame::IsHeadless()) {
+			R_Message(PRIORITY_NOTE, "running headless, UI is disabled\n");
+			bNullUI = true;
+			return;
+		}
 		ui_debugport = Cvar::Get<int>("ui_debugport", "Debugger port for Awesomium debugging (access http://127.0.0.1:this)", (1 << CVAR_ARCHIVE), 8000);
 		for (int i = 0; i < NUM_UI_VISIBLE; i++) {
 			uiTextures[i] = Video::RegisterStreamingTexture(Video::GetWidth(), Video::GetHeight());
@@ -65,7 +72,7 @@ namespace UI {
 		x.additional_options = wsa;
 		wc = WebCore::Initialize(x);
 		R_Message(PRIORITY_NOTE, "Creating web session\n");
-		sess = wc->CreateWebSession(WSLit((CvarSystem::GetStringValue("fs_homepath") + "/session/").c_str()), pref);
+		sess = wc->CreateWebSession(WSLit((string(fs_homepath.Value()) + "/session/").c_str()), pref);
 		sess->AddDataSource(WSLit("Rapture"), src);
 		R_Message(PRIORITY_NOTE, "creating main menu webview\n");
 		MainMenu::GetSingleton();
@@ -74,6 +81,9 @@ namespace UI {
 	}
 
 	void Shutdown() {
+		if (bNullUI) {
+			return;
+		}
 		for (auto it = vmMenus.begin(); it != vmMenus.end(); ++it) {
 			Menu* vmMenu = (*it);
 			delete vmMenu;
@@ -86,6 +96,10 @@ namespace UI {
 	}
 
 	void Update() {
+		if (bNullUI) {
+			return;
+		}
+		Console::FlushConsoleMessages();
 		wc->Update();
 	}
 
@@ -100,6 +114,9 @@ namespace UI {
 
 	// This gets called every frame, to render all of the UI elements.
 	void Render() {
+		if (bNullUI) {
+			return;
+		}
 		lastActiveLayer = 0;
 		for (auto it = vDrawMenus.begin(); it != vDrawMenus.end(); ++it, lastActiveLayer++) {
 			WebView* wv = *it;
@@ -291,7 +308,10 @@ void InjectAKeyboardEvent(Awesomium::WebKeyboardEvent e) {
 
 static Uint32 lastKeyboard = 0;
 void UI::KeyboardEvent(SDL_Keysym keysym, bool bIsKeyDown, char* text) {
-	if(keysym.scancode == SDL_SCANCODE_GRAVE && lastKeyboard < SDL_GetTicks()-200) {
+	if(bNullUI) {
+		return;
+	}
+	if(keysym.scancode == SDL_SCANCODE_GRAVE && lastKeyboard < Demo::Ticks()-200) {
 		if(bIsKeyDown) {
 			if(!Console::GetSingleton()->IsOpen()) {
 				Console::GetSingleton()->Show();
@@ -299,7 +319,7 @@ void UI::KeyboardEvent(SDL_Keysym keysym, bool bIsKeyDown, char* text) {
 				Console::GetSingleton()->Hide();
 			}
 		}
-		lastKeyboard = SDL_GetTicks();
+		lastKeyboard = Demo::Ticks();
 		return;
 	}
 
@@ -426,13 +446,17 @@ void UI::MouseMoveEvent(int x, int y) {
 }
 
 Menu* UI::RegisterStaticMenu(const char* menuName) {
+	if(bNullUI) {
+		return nullptr;
+	}
 	Menu* newMenu = new Menu(menuName);
 	vmMenus.push_back(newMenu);
 	return newMenu;
 }
 
+// Menus are nullptr when running headless, so everything that takes one from the VM has to check
 void UI::KillStaticMenu(Menu* menu) {
-	if(vmMenus.empty()) {
+	if(menu == nullptr || vmMenus.empty()) {
 		return;
 	}
 	for(auto it = vmMenus.begin(); it != vmMenus.end(); ++it) {
@@ -446,29 +470,53 @@ void UI::KillStaticMenu(Menu* menu) {
 }
 
 void UI::AddJavaScriptCallback(Menu* ptMenu, const char* sCallbackName, void(*ptCallback)()) {
+	if(ptMenu == nullptr) {
+		return;
+	}
 	ptMenu->AssignCallback(sCallbackName, ptCallback);
 }
 
 unsigned int UI::GetJavaScriptNumArgs(Menu* ptMenu) {
+	if(ptMenu == nullptr) {
+		return 0;
+	}
 	return ptMenu->GetVMArgCount();
 }
 
 void UI::GetJavaScriptStringArgument(Menu* ptMenu, unsigned int iArgNum, char* sBuffer, size_t numChars) {
+	if(ptMenu == nullptr) {
+		if(sBuffer != nullptr && numChars > 0) {
+			sBuffer[0] = '\0';
+		}
+		return;
+	}
 	ptMenu->GetVMStringArg(iArgNum, sBuffer, numChars);
 }
 
 int UI::GetJavaScriptIntArgument(Menu* ptMenu, unsigned int iArgNum) {
+	if(ptMenu == nullptr) {
+		return 0;
+	}
 	return ptMenu->GetVMIntArg(iArgNum);
 }
 
 double UI::GetJavaScriptDoubleArgument(Menu* ptMenu, unsigned int iArgNum) {
+	if(ptMenu == nullptr) {
+		return 0.0;
+	}
 	return ptMenu->GetVMDoubleArg(iArgNum);
 }
 
 bool UI::GetJavaScriptBoolArgument(Menu* ptMenu, unsigned int iArgNum) {
+	if(ptMenu == nullptr) {
+		return false;
+	}
 	return ptMenu->GetVMBoolArg(iArgNum);
 }
 
 bool UI::IsConsoleOpen() {
+	if(!Console::SingletonExists()) {
+		return false;
+	}
 	return Console::GetSingleton()->IsOpen();
 }
\ No newline at end of file
@@ -18,7 +18,7 @@ namespace UI {
 		Resource* pRes = Resource::ResourceSyncURI(pathBuf);
 		if (pRes == nullptr) {
 			R_Message(PRIORITY_WARNING, "UI: couldn't find resource %s\n", pathBuf);
-			delete pRes;
+			Resource::FreeResource(pRes);
 			// We still need to send a response, otherwise the game will hang
 			SendResponse(request_id, 1, (unsigned char*)"\0", WSLit("text/plain"));
 			return;
@@ -26,13 +26,13 @@ namespace UI {
 		AssetComponent* component = pRes->GetAssetComponent();
 		if (component == nullptr) {
 			R_Message(PRIORITY_WARNING, "UI: couldn't find resource %s\n", pathBuf);
-			delete pRes;
+			Resource::FreeResource(pRes);
 			SendResponse(request_id, 1, (unsigned char*)"\0", WSLit("text/plain"));
 			return;
 		}
 		if (component->meta.componentType != Asset_Data) {
 			R_Message(PRIORITY_WARNING, "UI: resource (%s) is not raw\n", pathBuf);
-			delete pRes;
+			Resource::FreeResource(pRes);
 			SendResponse(request_id, 1, (unsigned char*)"\0", WSLit("text/plain"));
 			return;
 		}
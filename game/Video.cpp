@@ -2,6 +2,7 @@
 #include "tr_local.h"
 
 #define VID_DEFAULT_RENDERER	"sdl"
+#define VID_HEADLESS_RENDERER	"null"
 #define VID_DEFAULT_WIDTH		1024
 #define VID_DEFAULT_HEIGHT		768
 #define VID_DEFAULT_TITLE		"Rapture"
@@ -20,6 +21,12 @@ namespace Video {
 	static SDL_Window* pWindow = nullptr;
 	static Renderer* pRenderer = nullptr;
 
+	static Metric* pMetricFrames = nullptr;
+	static Metric* pMetricFrameTime = nullptr;
+	static Metric* pMetricDraws = nullptr;
+	static Metric* pMetricTextDraws = nullptr;
+	static Metric* pMetricTextureUploads = nullptr;
+
 	static void WidthCallback(int newValue) {
 		if (newValue <= VID_MIN_WIDTH) {
 			R_Message(PRIORITY_WARNING, "WARNING: Invalid vid_width, using fallback resolution\n");
@@ -74,6 +81,28 @@ namespace Video {
 		vid_windowtitle->AddCallback((void*)WindowTitleCallback);
 		vid_gamma->AddCallback((void*)GammaCallback);
 
+		pMetricFrames = Metrics::Counter("render.frames");
+		pMetricFrameTime = Metrics::Histogram("render.frame_us");
+		pMetricDraws = Metrics::Counter("render.draws");
+		pMetricTextDraws = Metrics::Counter("render.text_draws");
+		pMetricTextureUploads = Metrics::Counter("render.texture_uploads");
+
+		if (RaptureGame::IsHeadless()) {
+			// No window and no GPU, just the null renderer (events are still needed for input and quitting)
+			if (SDL_Init(SDL_INIT_EVENTS | SDL_INIT_TIMER) < 0) {
+				printf("could not init SDL (error code: %s)\n", SDL_GetError());
+				return false;
+			}
+			pRenderer = new Renderer(VID_HEADLESS_RENDERER);
+			if (!pRenderer->AreExportsValid()) {
+				delete pRenderer;
+				pRenderer = nullptr;
+				return false;
+			}
+			pRenderer->Initialize();
+			return true;
+		}
+
 		if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_JOYSTICK) < 0) {
 			printf("could not init SDL (error code: %s)\n", SDL_GetError());
 			return false;
@@ -151,7 +180,10 @@ namespace Video {
 
 	void RenderFrame() {
 		if (pRenderer && pRenderer->AreExportsValid()) {
+			uint64_t ulStart = Timer::Nanoseconds();
 			pRenderer->RenderFrame();
+			pMetricFrameTime->Record((Timer::Nanoseconds() - ulStart) / 1000);
+			pMetricFrames->Add(1);
 		}
 	}
 
@@ -172,6 +204,7 @@ namespace Video {
 	void UnlockStreamingTexture(Texture* ptTexture) {
 		if (pRenderer && pRenderer->AreExportsValid()) {
 			pRenderer->pExports->UnlockStreamingTexture(ptTexture);
+			pMetricTextureUploads->Add(1);
 		}
 	}
 
@@ -197,18 +230,21 @@ namespace Video {
 	void RenderSolidText(Font* font, const char* text, int x, int y, int r, int g, int b) {
 		if (pRenderer && pRenderer->AreExportsValid()) {
 			pRenderer->pExports->RenderSolidText(font, text, x, y, r, g, b);
+			pMetricTextDraws->Add(1);
 		}
 	}
 
 	void RenderShadedText(Font* font, const char* text, int x, int y, int br, int bg, int bb, int fr, int fg, int fb) {
 		if (pRenderer && pRenderer->AreExportsValid()) {
 			pRenderer->pExports->RenderShadedText(font, text, x, y, br, bg, bb, fr, fg, fb);
+			pMetricTextDraws->Add(1);
 		}
 	}
 
 	void RenderBlendedText(Font* font, const char* text, int x, int y, int r, int g, int b) {
 		if (pRenderer && pRenderer->AreExportsValid()) {
 			pRenderer->pExports->RenderBlendedText(font, text, x, y, r, g, b);
+			pMetricTextDraws->Add(1);
 		}
 	}
 
@@ -223,30 +259,35 @@ namespace Video {
 	void DrawMaterial(Material* ptMaterial, float xPct, float yPct, float wPct, float hPct) {
 		if (pRenderer && pRenderer->AreExportsValid()) {
 			pRenderer->pExports->DrawMaterial(ptMaterial, xPct, yPct, wPct, hPct);
+			pMetricDraws->Add(1);
 		}
 	}
 
 	void DrawMaterialAspectCorrection(Material* ptMaterial, float xPct, float yPct, float wPct, float hPct) {
 		if (pRenderer && pRenderer->AreExportsValid()) {
 			pRenderer->pExports->DrawMaterialAspectCorrection(ptMaterial, xPct, yPct, wPct, hPct);
+			pMetricDraws->Add(1);
 		}
 	}
 
 	void DrawMaterialClipped(Material* ptMaterial, float sxPct, float syPct, float swPct, float shPct, float ixPct, float iyPct, float iwPct, float ihPct) {
 		if (pRenderer && pRenderer->AreExportsValid()) {
 			pRenderer->pExports->DrawMaterialClipped(ptMaterial, sxPct, syPct, swPct, shPct, ixPct, iyPct, iwPct, ihPct);
+			pMetricDraws->Add(1);
 		}
 	}
 
 	void DrawMaterialAbs(Material* ptMaterial, int nX, int nY, int nW, int nH) {
 		if (pRenderer && pRenderer->AreExportsValid()) {
 			pRenderer->pExports->DrawMaterialAbs(ptMaterial, nX, nY, nW, nH);
+			pMetricDraws->Add(1);
 		}
 	}
 
 	void DrawMaterialAbsClipped(Material* ptMaterial, int sX, int sY, int sW, int sH, int iX, int iY, int iW, int iH) {
 		if (pRenderer && pRenderer->AreExportsValid()) {
 			pRenderer->pExports->DrawMaterialAbsClipped(ptMaterial, sX, sY, sW, sH, iX, iY, iW, iH);
+			pMetricDraws->Add(1);
 		}
 	}
 
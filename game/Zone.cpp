@@ -18,22 +18,23 @@ namespace Zone {
 	};
 
 	// allocate some zone memory
-	void* MemoryManager::Allocate(int iSize, zoneTags_e tag) {
+	void* MemoryManager::Allocate(int iSize, zoneTags_e tag, void* pCallsite) {
 		if(tag == TAG_NONE) {
 			Sys_Error("Zone::Alloc passed TAG_NONE\n");
 			return nullptr;
 		}
 
-		return Allocate(iSize, tagNames[tag]);
+		return Allocate(iSize, tagNames[tag], pCallsite);
 	}
 
 	// allocate some zone memory, but use the tag name (good for VM/mod)
-	void* MemoryManager::Allocate(int iSize, const string& tag) {
+	void* MemoryManager::Allocate(int iSize, const string& tag, void* pCallsite) {
 		if(tag.length() <= 0) {
 			Sys_Error("Zone::Alloc passed zero-size tag string\n");
 			return nullptr;
 		}
 
+		lock_guard<recursive_mutex> lock(zoneMutex);
 		zone[tag].zoneInUse += iSize;
 		if(zone[tag].zoneInUse > zone[tag].peakUsage) {
 			zone[tag].peakUsage = zone[tag].zoneInUse;
@@ -41,89 +42,196 @@ namespace Zone {
 		void* memory = malloc(iSize);
 		ZoneChunk z(iSize, false);
 		zone[tag].zone[memory] = z;
+		CountAllocation();
+		if(bTracking) {
+			TrackAllocation(memory, iSize, tag, pCallsite);
+		}
+		CheckBudget(tag, zone[tag]);
+		return memory;
+	}
+
+	// allocate some zone memory with a specific alignment (must be a power of two)
+	void* MemoryManager::AllocateAligned(int iSize, const string& tag, size_t alignment, void* pCallsite) {
+		if(tag.length() <= 0) {
+			Sys_Error("Zone::AllocAligned passed zero-size tag string\n");
+			return nullptr;
+		}
+		if(alignment == 0) {
+			alignment = AlignmentForSize(iSize);
+		}
+		if(alignment & (alignment - 1)) {
+			Sys_Error("Zone::AllocAligned passed non power of two alignment (%i)\n", alignment);
+			return nullptr;
+		}
+
+		void* memory = Sys_AlignedAlloc(iSize, alignment);
+		if(memory == nullptr) {
+			return nullptr;
+		}
+		lock_guard<recursive_mutex> lock(zoneMutex);
+		zone[tag].zoneInUse += iSize;
+		if(zone[tag].zoneInUse > zone[tag].peakUsage) {
+			zone[tag].peakUsage = zone[tag].zoneInUse;
+		}
+		zone[tag].zone[memory] = ZoneChunk(iSize, false, alignment);
+		CountAllocation();
+		if(bTracking) {
+			TrackAllocation(memory, iSize, tag, pCallsite);
+		}
+		CheckBudget(tag, zone[tag]);
 		return memory;
 	}
 
 	// free some zone memory (SLOW)
 	void MemoryManager::Free(void* memory) {
+		lock_guard<recursive_mutex> lock(zoneMutex);
 		for(auto it = zone.begin(); it != zone.end(); ++it) {
 			for(auto it2 = it->second.zone.begin(); it2 != it->second.zone.end(); ++it2) {
 				if(it2->first == memory) {
+					bool bAligned = it2->second.isAligned;
 					it->second.zoneInUse -= it2->second.memInUse;
 					it->second.zone.erase(it2);
-					free(memory);
+					pMetricFrees->Add(1);
+					if(bTracking) {
+						UntrackAllocation(memory);
+					}
+					if(bAligned)
+						Sys_AlignedFree(memory);
+					else
+						free(memory);
+					return;
 				}
 			}
 		}
 		Sys_Error("Zone::Free(): corrupt zone memory!");
 	}
 
-	// free some zone memory (quicker but still SLOW and not recommended)
-	void MemoryManager::FastFree(void* memory, const string& tag) {
+	// free some zone memory (quicker but still SLOW and not recommended), returns how many bytes were given back
+	size_t MemoryManager::FastFree(void* memory, const string& tag) {
+		lock_guard<recursive_mutex> lock(zoneMutex);
 		try {
 			auto memblock = zone[tag].zone.find(memory);
 			if(memblock == zone[tag].zone.end()) {
 				R_Message(PRIORITY_WARNING, "WARNING: could not dealloc memory block at 0x%X, memory not allocated!\n", (unsigned int)memory);
-				return;
+				return 0;
 			}
 			auto mpair = memblock->second;
 			zone[tag].zoneInUse -= mpair.memInUse;
 			zone[tag].zone.erase(memory);
-			if(!mpair.isClassObject)
+			pMetricFrees->Add(1);
+			if(bTracking) {
+				UntrackAllocation(memory);
+			}
+			if(mpair.isAligned)
+				Sys_AlignedFree(memory);
+			else if(!mpair.isClassObject)
 				free(memory);
 			else
 				delete memory;
+			return mpair.memInUse;
 		}
 		catch( out_of_range e ) {
 			Sys_Error("Zone::FastFree(): corrupt zone memory!");
-			return;
+			return 0;
 		}
 	}
 
 	// free all memory belonging to a tag (FAST)
 	void MemoryManager::FreeAll(const string& tag) {
+		lock_guard<recursive_mutex> lock(zoneMutex);
 		zone[tag].zoneInUse = 0;
 		for(auto it = zone[tag].zone.begin();
 			it != zone[tag].zone.end(); ++it) {
-				if(!it->second.isClassObject)
+				if(bTracking) {
+					UntrackAllocation(it->first);
+				}
+				if(it->second.isAligned)
+					Sys_AlignedFree(it->first);
+				else if(!it->second.isClassObject)
 					free(it->first);
 				else
 					delete it->first;
 		}
+		pMetricFrees->Add(zone[tag].zone.size());
 		zone[tag].zone.clear();
 	}
 
 	void* MemoryManager::Reallocate(void* memory, size_t iNewSize) {
+		lock_guard<recursive_mutex> lock(zoneMutex);
 		for(auto it = zone.begin(); it != zone.end(); ++it) {
-			try {
-				auto it2 = it->second.zone.find(memory);
-				if(it2->second.isClassObject) return memory; // do NOT allow reallocations on classes
-				size_t difference = iNewSize - it2->second.memInUse;
-				it->second.zoneInUse += difference;
-				if(it->second.zoneInUse > it->second.peakUsage) {
-					it->second.peakUsage = it->second.zoneInUse;
-				}
-				void* mem = realloc(memory, iNewSize);
-				if(!mem) {
-					throw false;
+			auto it2 = it->second.zone.find(memory);
+			if(it2 == it->second.zone.end()) {
+				continue;
+			}
+			if(it2->second.isClassObject) return memory; // do NOT allow reallocations on classes
+			ZoneChunk chunk = it2->second;
+
+			void* mem;
+			if(chunk.isAligned) {
+				// there's no aligned realloc that works everywhere, so copy it over by hand
+				mem = Sys_AlignedAlloc(iNewSize, chunk.alignment);
+				if(mem) {
+					memcpy(mem, memory, chunk.memInUse < iNewSize ? chunk.memInUse : iNewSize);
+					Sys_AlignedFree(memory);
 				}
-				memory = mem;
-				it->second.zone[memory] = ZoneChunk(iNewSize, false);
-				return memory;
 			}
-			catch( out_of_range ) {
-				continue;
+			else {
+				mem = realloc(memory, iNewSize);
 			}
-			catch( bool ) {
+			if(!mem) {
 				break;
 			}
+
+			it->second.zoneInUse += iNewSize - chunk.memInUse;
+			if(it->second.zoneInUse > it->second.peakUsage) {
+				it->second.peakUsage = it->second.zoneInUse;
+			}
+			if(bTracking) {
+				auto record = umTrackedBlocks.find(memory);
+				if(record != umTrackedBlocks.end()) {
+					ZoneAllocRecord moved = record->second;
+					moved.size = iNewSize;
+					umTrackedBlocks.erase(record);
+					umTrackedBlocks[mem] = moved;
+				}
+			}
+			it->second.zone.erase(it2);
+			it->second.zone[mem] = ZoneChunk(iNewSize, false, chunk.alignment);
+			CheckBudget(it->first, it->second);
+			return mem;
 		}
 		Sys_Error("Zone::Realloc: corrupt zone memory!");
 		return nullptr;
 	}
 
+	// Page align anything big enough to span several pages, cache line align everything else
+	size_t AlignmentForSize(size_t iSize) {
+		return iSize >= ZONE_LARGE_ALLOCATION ? ZONE_PAGE_SIZE : ZONE_DEFAULT_ALIGNMENT;
+	}
+
 	MemoryManager::MemoryManager() {
 		R_Message(PRIORITY_NOTE, "Initializing zone memory\n");
+		bTracking = false;
+		bBudgetsReady = false;
+		pMetricAllocs = Metrics::Counter("zone.allocs");
+		pMetricFrees = Metrics::Counter("zone.frees");
+	}
+
+	// Allocation churn, for the metrics and hitch traces
+	void MemoryManager::CountAllocation() {
+		pMetricAllocs->Add(1);
+	}
+
+	// Creating a tag that already exists leaves it alone, so that its budgets and callbacks survive
+	void MemoryManager::CreateZoneTag(const string& tag) {
+		lock_guard<recursive_mutex> lock(zoneMutex);
+		if(zone.find(tag) != zone.end()) {
+			return;
+		}
+		ZoneTag& zt = zone[tag];
+		if(bBudgetsReady) {
+			RegisterBudgetCvars(tag, zt);
+		}
 	}
 
 	MemoryManager::~MemoryManager() {
@@ -133,6 +241,7 @@ namespace Zone {
 	}
 
 	void MemoryManager::PrintMemUsage() {
+		lock_guard<recursive_mutex> lock(zoneMutex);
 		R_Message(PRIORITY_MESSAGE, "\n%-10s %20s %20s %20s %20s %20s %20s\n", "Tag", "Cur Usage (b)", "Cur Usage (KB)", "Cur Usage (MB)", "Peak Usage (b)", "Peak Usage (KB)", "Peak Usage (MB)");
 		R_Message(PRIORITY_MESSAGE, "%-10s %20s %20s %20s %20s %20s %20s\n", "-----", "-------------", "--------------", "--------------", "--------------", "---------------", "---------------");
 		for(auto it = zone.begin(); it != zone.end(); ++it) {
@@ -143,6 +252,367 @@ namespace Zone {
 		}
 	}
 
+	// Current and peak usage of every tag, as gauges. Runs as a metrics sampler.
+	void MemoryManager::PublishMetrics() {
+		lock_guard<recursive_mutex> lock(zoneMutex);
+		for(auto it = zone.begin(); it != zone.end(); ++it) {
+			Metrics::Gauge("zone." + it->first + ".bytes")->Set(it->second.zoneInUse);
+			Metrics::Gauge("zone." + it->first + ".peak")->Set(it->second.peakUsage);
+		}
+	}
+
+	// Name a callsite for printing
+	static char* CallsiteName(void* pCallsite, char* buffer, size_t bufferSize) {
+		if(pCallsite == nullptr) {
+			strncpy(buffer, "<unknown>", bufferSize);
+			buffer[bufferSize - 1] = '\0';
+			return buffer;
+		}
+		return Sys_ResolveAddress(pCallsite, buffer, bufferSize);
+	}
+
+	/*
+	 * Memory budgets.
+	 * Each tag has a soft and a hard budget (zone_budget_<tag> and zone_hardbudget_<tag>, in KB).
+	 * Crossing the soft budget runs the eviction callbacks registered on that tag, so caches can throw
+	 * things out. Any thread can cross it, so the callbacks are deferred to RunEvictions, which the main
+	 * thread calls once a frame. Crossing the hard budget logs who is using the memory. Allocations never fail because
+	 * of a budget. Both only fire once per crossing, so a tag that stays over budget doesn't spam.
+	 */
+	void MemoryManager::RegisterBudgetCvars(const string& tag, ZoneTag& zt) {
+		string softName = "zone_budget_" + tag;
+		string hardName = "zone_hardbudget_" + tag;
+		string softDesc = "Soft memory budget (KB) for zone tag '" + tag + "'. Eviction callbacks run when it is exceeded. 0 = no budget";
+		string hardDesc = "Hard memory budget (KB) for zone tag '" + tag + "'. A warning with the top consumers is logged when it is exceeded. 0 = no budget";
+		zt.softBudget = CvarSystem::RegisterCvar(softName.c_str(), softDesc.c_str(), (1 << CVAR_ARCHIVE), 0);
+		zt.hardBudget = CvarSystem::RegisterCvar(hardName.c_str(), hardDesc.c_str(), (1 << CVAR_ARCHIVE), 0);
+	}
+
+	// The cvar system allocates from the zone, so budgets can only be set up once it is running
+	void MemoryManager::InitBudgets() {
+		lock_guard<recursive_mutex> lock(zoneMutex);
+		bBudgetsReady = true;
+		vector<string> vTags;
+		for(auto it = zone.begin(); it != zone.end(); ++it) {
+			if(it->first != tagNames[TAG_NONE] && it->first != tagNames[MAX_ENGINE_TAGS]) {
+				vTags.push_back(it->first);
+			}
+		}
+		// registering the cvars allocates, which can add to the map while we'd be iterating it
+		for(auto it = vTags.begin(); it != vTags.end(); ++it) {
+			RegisterBudgetCvars(*it, zone[*it]);
+		}
+	}
+
+	// Called with the zone locked, from whichever thread allocated
+	void MemoryManager::CheckBudget(const string& tag, ZoneTag& zt) {
+		if(zt.softBudget != nullptr) {
+			size_t softBytes = (size_t)zt.softBudget->AtomicInteger() * 1024;
+			if(softBytes > 0 && zt.zoneInUse > softBytes) {
+				if(!zt.bOverSoftBudget) {
+					zt.bOverSoftBudget = true;
+					zt.bEvictionPending = true;
+				}
+			}
+			else {
+				zt.bOverSoftBudget = false;
+			}
+		}
+
+		if(zt.hardBudget != nullptr) {
+			size_t hardBytes = (size_t)zt.hardBudget->AtomicInteger() * 1024;
+			if(hardBytes > 0 && zt.zoneInUse > hardBytes) {
+				if(!zt.bOverHardBudget) {
+					zt.bOverHardBudget = true;
+					ReportBudgetOverrun(tag, zt, hardBytes);
+				}
+			}
+			else {
+				zt.bOverHardBudget = false;
+			}
+		}
+	}
+
+	// Logs which blocks (or which callsites, if tracking is on) are using up the tag
+	void MemoryManager::ReportBudgetOverrun(const string& tag, ZoneTag& zt, size_t hardBytes) {
+		const size_t numConsumers = 5;
+		R_Message(PRIORITY_WARNING, "zone budget exceeded: tag=%s inuse=%i hard=%i soft=%i peak=%i blocks=%i\n",
+			tag.c_str(), zt.zoneInUse, hardBytes, zt.softBudget ? zt.softBudget->AtomicInteger() * 1024 : 0,
+			zt.peakUsage, zt.zone.size());
+
+		if(bTracking) {
+			ZoneSnapshot snapshot;
+			BuildSnapshot(snapshot, tag);
+			vector<pair<void*, ZoneSiteStats>> vSites(snapshot.begin(), snapshot.end());
+			sort(vSites.begin(), vSites.end(), [](const pair<void*, ZoneSiteStats>& a, const pair<void*, ZoneSiteStats>& b) {
+				return a.second.liveBytes > b.second.liveBytes;
+			});
+			char szSite[256];
+			for(size_t i = 0; i < vSites.size() && i < numConsumers; i++) {
+				R_Message(PRIORITY_WARNING, "  consumer %i: site=%s bytes=%i blocks=%i\n", i + 1,
+					CallsiteName(vSites[i].first, szSite, sizeof(szSite)), vSites[i].second.liveBytes, vSites[i].second.liveBlocks);
+			}
+			return;
+		}
+
+		// Without tracking, the best we can do is point at the biggest blocks
+		vector<pair<void*, size_t>> vBlocks;
+		for(auto it = zt.zone.begin(); it != zt.zone.end(); ++it) {
+			vBlocks.push_back(make_pair(it->first, it->second.memInUse));
+		}
+		size_t numShown = vBlocks.size() < numConsumers ? vBlocks.size() : numConsumers;
+		partial_sort(vBlocks.begin(), vBlocks.begin() + numShown, vBlocks.end(), [](const pair<void*, size_t>& a, const pair<void*, size_t>& b) {
+			return a.second > b.second;
+		});
+		for(size_t i = 0; i < numShown; i++) {
+			R_Message(PRIORITY_WARNING, "  consumer %i: block=0x%p bytes=%i\n", i + 1, vBlocks[i].first, vBlocks[i].second);
+		}
+		R_Message(PRIORITY_WARNING, "  (use zonetrack 1 to see callsites)\n");
+	}
+
+	void MemoryManager::AddEvictionCallback(const string& tag, zoneEvictionCallback callback) {
+		if(callback == nullptr) {
+			return;
+		}
+		lock_guard<recursive_mutex> lock(zoneMutex);
+		CreateZoneTag(tag);
+		vector<zoneEvictionCallback>& vCallbacks = zone[tag].vEvictionCallbacks;
+		if(find(vCallbacks.begin(), vCallbacks.end(), callback) == vCallbacks.end()) {
+			vCallbacks.push_back(callback);
+		}
+	}
+
+	void MemoryManager::RemoveEvictionCallback(const string& tag, zoneEvictionCallback callback) {
+		lock_guard<recursive_mutex> lock(zoneMutex);
+		auto it = zone.find(tag);
+		if(it == zone.end()) {
+			return;
+		}
+		vector<zoneEvictionCallback>& vCallbacks = it->second.vEvictionCallbacks;
+		vCallbacks.erase(remove(vCallbacks.begin(), vCallbacks.end(), callback), vCallbacks.end());
+	}
+
+	// Runs the eviction callbacks of every tag that went over its soft budget since the last call.
+	// The zone isn't locked while a callback runs, since the callbacks take their own locks and free memory.
+	void MemoryManager::RunEvictions() {
+		vector<string> vPending;
+		{
+			lock_guard<recursive_mutex> lock(zoneMutex);
+			for(auto it = zone.begin(); it != zone.end(); ++it) {
+				if(it->second.bEvictionPending) {
+					it->second.bEvictionPending = false;
+					vPending.push_back(it->first);
+				}
+			}
+		}
+
+		for(auto it = vPending.begin(); it != vPending.end(); ++it) {
+			vector<zoneEvictionCallback> vCallbacks;
+			size_t softBytes;
+			{
+				lock_guard<recursive_mutex> lock(zoneMutex);
+				ZoneTag& zt = zone[*it];
+				// callbacks are allowed to unregister themselves, so walk a copy of the list
+				vCallbacks = zt.vEvictionCallbacks;
+				softBytes = zt.softBudget ? (size_t)zt.softBudget->Integer() * 1024 : 0;
+			}
+			for(auto cb = vCallbacks.begin(); cb != vCallbacks.end(); ++cb) {
+				size_t inUse;
+				{
+					lock_guard<recursive_mutex> lock(zoneMutex);
+					inUse = zone[*it].zoneInUse;
+				}
+				if(softBytes == 0 || inUse <= softBytes) {
+					break;	// an earlier callback already freed enough, or the budget was lifted
+				}
+				(*cb)(it->c_str(), inUse - softBytes);
+			}
+		}
+	}
+
+	/*
+	 * Allocation tracking.
+	 * While enabled, every zone allocation records where it came from (the return address of whoever
+	 * called into the zone), how big it is and which frame it was made on. When disabled, nothing is
+	 * recorded and the only cost is the bTracking check.
+	 */
+	void MemoryManager::TrackAllocation(void* memory, size_t iSize, const string& tag, void* pCallsite) {
+		ZoneAllocRecord record;
+		record.pCallsite = pCallsite;
+		record.szTag = zone.find(tag)->first.c_str();
+		record.size = iSize;
+		record.uFrameNum = RaptureGame::GetFrameNumber();
+		umTrackedBlocks[memory] = record;
+	}
+
+	void MemoryManager::UntrackAllocation(void* memory) {
+		umTrackedBlocks.erase(memory);
+	}
+
+	void MemoryManager::SetTracking(bool bEnabled) {
+		lock_guard<recursive_mutex> lock(zoneMutex);
+		if(bEnabled == bTracking) {
+			return;
+		}
+		bTracking = bEnabled;
+		if(!bEnabled) {
+			// blocks allocated from here on wouldn't be recorded, so what we have is meaningless now
+			umTrackedBlocks.clear();
+		}
+		R_Message(PRIORITY_MESSAGE, "Zone allocation tracking %s\n", bEnabled ? "enabled" : "disabled");
+	}
+
+	// Group all of the live tracked blocks by callsite, optionally only looking at one tag
+	void MemoryManager::BuildSnapshot(ZoneSnapshot& snapshot, const string& tag) {
+		snapshot.clear();
+		for(auto it = umTrackedBlocks.begin(); it != umTrackedBlocks.end(); ++it) {
+			if(tag.length() > 0 && tag != it->second.szTag) {
+				continue;
+			}
+			ZoneSiteStats& stats = snapshot[it->second.pCallsite];
+			if(stats.liveBlocks == 0 || it->second.uFrameNum < stats.uFirstFrame) {
+				stats.uFirstFrame = it->second.uFrameNum;
+			}
+			if(it->second.uFrameNum > stats.uLastFrame) {
+				stats.uLastFrame = it->second.uFrameNum;
+			}
+			stats.liveBytes += it->second.size;
+			stats.liveBlocks++;
+		}
+	}
+
+	// Print the callsites which are holding on to the most memory
+	void MemoryManager::PrintTopAllocators(size_t numSites, const string& tag) {
+		lock_guard<recursive_mutex> lock(zoneMutex);
+		if(!bTracking) {
+			R_Message(PRIORITY_MESSAGE, "Zone allocation tracking is off (use zonetrack 1)\n");
+			return;
+		}
+
+		ZoneSnapshot snapshot;
+		BuildSnapshot(snapshot, tag);
+
+		vector<pair<void*, ZoneSiteStats>> vSites(snapshot.begin(), snapshot.end());
+		sort(vSites.begin(), vSites.end(), [](const pair<void*, ZoneSiteStats>& a, const pair<void*, ZoneSiteStats>& b) {
+			return a.second.liveBytes > b.second.liveBytes;
+		});
+
+		char szSite[256];
+		R_Message(PRIORITY_MESSAGE, "\n%-60s %14s %10s %12s %12s\n", "Callsite", "Live (b)", "Blocks", "First Frame", "Last Frame");
+		R_Message(PRIORITY_MESSAGE, "%-60s %14s %10s %12s %12s\n", "--------", "--------", "------", "-----------", "----------");
+		for(size_t i = 0; i < vSites.size() && i < numSites; i++) {
+			ZoneSiteStats& stats = vSites[i].second;
+			R_Message(PRIORITY_MESSAGE, "%-60s %14i %10i %12u %12u\n", CallsiteName(vSites[i].first, szSite, sizeof(szSite)),
+				stats.liveBytes, stats.liveBlocks, stats.uFirstFrame, stats.uLastFrame);
+		}
+	}
+
+	// Print a histogram of live blocks, bucketed by powers of two
+	void MemoryManager::PrintSizeHistogram() {
+		lock_guard<recursive_mutex> lock(zoneMutex);
+		if(!bTracking) {
+			R_Message(PRIORITY_MESSAGE, "Zone allocation tracking is off (use zonetrack 1)\n");
+			return;
+		}
+
+		const int numBuckets = 32;
+		size_t blockCounts[numBuckets] = { 0 };
+		size_t byteCounts[numBuckets] = { 0 };
+		size_t maxCount = 0;
+		for(auto it = umTrackedBlocks.begin(); it != umTrackedBlocks.end(); ++it) {
+			int bucket = 0;
+			while(bucket < numBuckets - 1 && ((size_t)1 << bucket) < it->second.size) {
+				bucket++;
+			}
+			blockCounts[bucket]++;
+			byteCounts[bucket] += it->second.size;
+			if(blockCounts[bucket] > maxCount) {
+				maxCount = blockCounts[bucket];
+			}
+		}
+
+		R_Message(PRIORITY_MESSAGE, "\n%-12s %10s %14s\n", "Size (<=b)", "Blocks", "Bytes");
+		R_Message(PRIORITY_MESSAGE, "%-12s %10s %14s\n", "----------", "------", "-----");
+		for(int i = 0; i < numBuckets; i++) {
+			if(blockCounts[i] == 0) {
+				continue;
+			}
+			char szBar[41];
+			size_t barLength = (blockCounts[i] * 40) / maxCount;
+			memset(szBar, '#', barLength);
+			szBar[barLength] = '\0';
+			R_Message(PRIORITY_MESSAGE, "%-12u %10i %14i %s\n", (unsigned int)((size_t)1 << i), blockCounts[i], byteCounts[i], szBar);
+		}
+	}
+
+	void MemoryManager::TakeSnapshot(const string& name) {
+		lock_guard<recursive_mutex> lock(zoneMutex);
+		if(!bTracking) {
+			R_Message(PRIORITY_MESSAGE, "Zone allocation tracking is off (use zonetrack 1)\n");
+			return;
+		}
+		BuildSnapshot(mSnapshots[name]);
+		R_Message(PRIORITY_MESSAGE, "Zone snapshot '%s' taken on frame %u (%i live blocks)\n", 
+			name.c_str(), RaptureGame::GetFrameNumber(), umTrackedBlocks.size());
+	}
+
+	// Compare two snapshots; if the second one is empty, compare against what's live right now
+	void MemoryManager::PrintSnapshotDiff(const string& from, const string& to) {
+		lock_guard<recursive_mutex> lock(zoneMutex);
+		auto itFrom = mSnapshots.find(from);
+		if(itFrom == mSnapshots.end()) {
+			R_Message(PRIORITY_WARNING, "No zone snapshot named '%s'\n", from.c_str());
+			return;
+		}
+
+		ZoneSnapshot live;
+		ZoneSnapshot* pTo = &live;
+		if(to.length() > 0) {
+			auto itTo = mSnapshots.find(to);
+			if(itTo == mSnapshots.end()) {
+				R_Message(PRIORITY_WARNING, "No zone snapshot named '%s'\n", to.c_str());
+				return;
+			}
+			pTo = &itTo->second;
+		}
+		else {
+			BuildSnapshot(live);
+		}
+
+		// Collect the difference for every callsite in either snapshot
+		map<void*, pair<long long, long long>> mDelta;
+		for(auto it = itFrom->second.begin(); it != itFrom->second.end(); ++it) {
+			mDelta[it->first].first -= it->second.liveBytes;
+			mDelta[it->first].second -= it->second.liveBlocks;
+		}
+		for(auto it = pTo->begin(); it != pTo->end(); ++it) {
+			mDelta[it->first].first += it->second.liveBytes;
+			mDelta[it->first].second += it->second.liveBlocks;
+		}
+
+		vector<pair<void*, pair<long long, long long>>> vDelta;
+		long long totalBytes = 0;
+		for(auto it = mDelta.begin(); it != mDelta.end(); ++it) {
+			if(it->second.first != 0 || it->second.second != 0) {
+				vDelta.push_back(*it);
+				totalBytes += it->second.first;
+			}
+		}
+		sort(vDelta.begin(), vDelta.end(), [](const pair<void*, pair<long long, long long>>& a, const pair<void*, pair<long long, long long>>& b) {
+			return llabs(a.second.first) > llabs(b.second.first);
+		});
+
+		char szSite[256];
+		R_Message(PRIORITY_MESSAGE, "\nZone diff %s -> %s\n", from.c_str(), to.length() > 0 ? to.c_str() : "<live>");
+		R_Message(PRIORITY_MESSAGE, "%-60s %14s %10s\n", "Callsite", "Delta (b)", "Blocks");
+		R_Message(PRIORITY_MESSAGE, "%-60s %14s %10s\n", "--------", "---------", "------");
+		for(auto it = vDelta.begin(); it != vDelta.end(); ++it) {
+			R_Message(PRIORITY_MESSAGE, "%-60s %+14lli %+10lli\n", CallsiteName(it->first, szSite, sizeof(szSite)),
+				it->second.first, it->second.second);
+		}
+		R_Message(PRIORITY_MESSAGE, "%i callsites changed, %+lli bytes total\n", vDelta.size(), totalBytes);
+	}
+
 	// Functions which are accessed from the outside
 	void Init() {
 		mem = new MemoryManager();
@@ -156,19 +626,31 @@ namespace Zone {
 	}
 
 	void* Alloc(int iSize, zoneTags_e tag) {
-		return mem->Allocate(iSize, tag);
+		return mem->Allocate(iSize, tag, Sys_ReturnAddress());
 	}
 
 	void* Alloc(int iSize, const string& tag) {
-		return mem->Allocate(iSize, tag);
+		return mem->Allocate(iSize, tag, Sys_ReturnAddress());
+	}
+
+	void* AllocAligned(int iSize, zoneTags_e tag, size_t alignment) {
+		if(tag == TAG_NONE) {
+			Sys_Error("Zone::AllocAligned passed TAG_NONE\n");
+			return nullptr;
+		}
+		return mem->AllocateAligned(iSize, tagNames[tag], alignment, Sys_ReturnAddress());
+	}
+
+	void* AllocAligned(int iSize, const string& tag, size_t alignment) {
+		return mem->AllocateAligned(iSize, tag, alignment, Sys_ReturnAddress());
 	}
 
 	void Free(void* memory) {
 		mem->Free(memory);
 	}
 
-	void FastFree(void *memory, const string& tag) {
-		mem->FastFree(memory, tag);
+	size_t FastFree(void *memory, const string& tag) {
+		return mem->FastFree(memory, tag);
 	}
 
 	void FreeAll(const string& tag) {
@@ -183,8 +665,40 @@ namespace Zone {
 		mem->PrintMemUsage();
 	}
 
+	void PublishMetrics() {
+		mem->PublishMetrics();
+	}
+
+	void SetTracking(bool bEnabled) {
+		mem->SetTracking(bEnabled);
+	}
+
+	bool IsTracking() {
+		return mem->IsTracking();
+	}
+
+	void TopAllocators(size_t numSites, const string& tag) {
+		mem->PrintTopAllocators(numSites, tag);
+	}
+
+	void SizeHistogram() {
+		mem->PrintSizeHistogram();
+	}
+
+	void Snapshot(const string& name) {
+		mem->TakeSnapshot(name);
+	}
+
+	void SnapshotDiff(const string& from, const string& to) {
+		mem->PrintSnapshotDiff(from, to);
+	}
+
 	void* VMAlloc(int iSize, const char* tag) {
-		return mem->Allocate(iSize, tag);
+		return mem->Allocate(iSize, tag, Sys_ReturnAddress());
+	}
+
+	void* VMAllocAligned(int iSize, const char* tag, size_t alignment) {
+		return mem->AllocateAligned(iSize, tag, alignment, Sys_ReturnAddress());
 	}
 
 	void VMFastFree(void* memory, const char* tag) {
@@ -198,4 +712,28 @@ namespace Zone {
 	void NewTag(const char* tag) {
 		mem->CreateZoneTag(tag);
 	}
+
+	void InitBudgets() {
+		mem->InitBudgets();
+	}
+
+	void AddEvictionCallback(const string& tag, zoneEvictionCallback callback) {
+		mem->AddEvictionCallback(tag, callback);
+	}
+
+	void RemoveEvictionCallback(const string& tag, zoneEvictionCallback callback) {
+		mem->RemoveEvictionCallback(tag, callback);
+	}
+
+	void RunEvictions() {
+		mem->RunEvictions();
+	}
+
+	void VMAddEvictionCallback(const char* tag, zoneEvictionCallback callback) {
+		AddEvictionCallback(tag, callback);
+	}
+
+	void VMRemoveEvictionCallback(const char* tag, zoneEvictionCallback callback) {
+		RemoveEvictionCallback(tag, callback);
+	}
 }
\ No newline at end of file
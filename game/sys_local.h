@@ -5,12 +5,26 @@
 #include <SDL.h>
 #include <SDL_ttf.h>
 #include <RaptureAsset.h>
+#include <deque>
+#include <set>
 
 #define R_Error Sys_Error
 
+#ifdef _WIN32
+#include <intrin.h>
+#pragma intrinsic(_ReturnAddress)
+#define Sys_ReturnAddress()	_ReturnAddress()
+#define Sys_NoInline		__declspec(noinline)
+#else
+#define Sys_ReturnAddress()	__builtin_return_address(0)
+#define Sys_NoInline		__attribute__((noinline))
+#endif
+
 typedef void* ptModule;
 typedef void* ptModuleFunction;
 
+struct Metric;
+
 //
 // sys_main.cpp
 //
@@ -69,6 +83,13 @@ public:
 	static GameModule* GetEditorModule();
 	static gameExports_s* GetImport();
 
+	static unsigned int uFrameNumber;
+	static unsigned int GetFrameNumber() { return uFrameNumber; }
+
+	// Set with -headless on the commandline: no window, the null renderer and no UI
+	static bool bHeadless;
+	static bool IsHeadless() { return bHeadless; }
+
 	static int RaptureInputCallback(void *notUsed, SDL_Event* e);
 };
 
@@ -76,6 +97,21 @@ public:
 // CvarSystem.cpp
 //
 
+// VS2013 doesn't have constexpr; the hash is written so that the optimizer folds it away regardless
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define RAPTURE_CONSTEXPR	inline
+#else
+#define RAPTURE_CONSTEXPR	constexpr
+#endif
+
+// FNV-1a, written as a single expression so that it's a valid C++11 constexpr function
+RAPTURE_CONSTEXPR uint32_t CvarHashName(const char* str, uint32_t hash = 2166136261u) {
+	return *str ? CvarHashName(str + 1, (hash ^ (uint32_t)(unsigned char)*str) * 16777619u) : hash;
+}
+
+typedef int cvarID_t;
+#define CVAR_INVALID_ID		-1
+
 template<typename T>
 struct CvarValueSet {
 	T defaultVal;
@@ -121,6 +157,15 @@ private:
 
 	cvarType_e type;
 	int flags;
+	cvarID_t id;
+
+	// Copy of the current value which other threads read from. Only the main thread writes cvars.
+	// Numeric types are stored as raw bits; the string is guarded by a sequence count (odd = being written)
+	atomic<uint32_t> uPublishedBits;
+	atomic<uint32_t> uStringSequence;
+	char szPublishedString[64];
+	void Publish();
+
 	void AssignHardValue(char* value);
 	void AssignHardValue(int value);
 	void AssignHardValue(float value);
@@ -143,6 +188,7 @@ public:
 	inline int GetFlags() { return flags; }
 	inline string GetName() { return name; }
 	inline string GetDescription() { return description; }
+	inline cvarID_t GetID() { return id; }
 
 	void SetValue(char* value);
 	void SetValue(int value);
@@ -157,6 +203,12 @@ public:
 	inline float DefaultValue() { return v.defaultVal; }
 	inline bool DefaultBool() { return b.defaultVal; }
 
+	// Safe to call from any thread
+	int AtomicInteger() const { return (int)uPublishedBits.load(memory_order_acquire); }
+	float AtomicValue() const { uint32_t bits = uPublishedBits.load(memory_order_acquire); float f; memcpy(&f, &bits, sizeof(f)); return f; }
+	bool AtomicBool() const { return uPublishedBits.load(memory_order_acquire) != 0; }
+	void AtomicString(char* out, size_t outSize) const;
+
 	string TypeToString();
 
 	void AddCallback(void* function);
@@ -164,24 +216,18 @@ public:
 
 	template<typename T>
 	static Cvar* Get(const char* sName, const char* sDesc, int iFlags, T startValue) {
-		try {
-			auto it = CvarSystem::cvars.find(sName);
-			if(it == CvarSystem::cvars.end()) {
-				throw string("not registered");
-			}
-			Cvar* cv = it->second;
-			if(!cv->registered) {
-				throw string("not registered");
-			}
-			return cv;
-		}
-		catch( string e ) {
-			// register a new cvar
-			R_Message(PRIORITY_MESSAGE, "%s %s\n", sName, e.c_str());
-			return CvarSystem::RegisterCvar(sName, sDesc, iFlags, startValue);
+		auto it = CvarSystem::cvars.find(sName);
+		if(it != CvarSystem::cvars.end() && it->second->registered) {
+			return it->second;
 		}
+		// register a new cvar
+		R_Message(PRIORITY_MESSAGE, "%s not registered\n", sName);
+		return CvarSystem::RegisterCvar(sName, sDesc, iFlags, startValue);
 	}
 
+	template<typename T>
+	T Read();
+
 	static bool Exists(const string& sName);
 friend class CvarSystem;
 friend class Cvar;
@@ -196,6 +242,9 @@ struct CvarCacheObject {
 class CvarSystem {
 	static unordered_map<string, Cvar*> cvars;
 	static unordered_map<string, CvarCacheObject*> cache;
+	static vector<Cvar*> vCvarSlots;
+	static unordered_map<uint32_t, cvarID_t> umHashedIDs;
+	static atomic<unsigned int> uGeneration;
 	static bool init;
 	static void Cache_Free(const string& sName);
 	static void ArchiveCvars();
@@ -224,14 +273,32 @@ public:
 	static void Initialize();
 	static void Destroy();
 
-	static int GetCvarFlags(const string& sName) { return cvars[sName]->flags; }
-	static void SetCvarFlags(const string& sName, int flags) { cvars[sName]->flags = flags; }
-	static Cvar::cvarType_e GetCvarType(const string& sName) { return cvars[sName]->type; }
+	// String lookups. These are meant for console and UI input; code should hold on to a Cvar* or a CvarRef.
+	static Cvar* FindCvar(const string& sName);
+	static cvarID_t GetCvarID(const string& sName);
+	static cvarID_t GetCvarID(uint32_t uHash, const char* sName);
+	static unsigned int GetGeneration() { return uGeneration.load(memory_order_acquire); }
+	static const atomic<unsigned int>* GetGenerationCounter() { return &uGeneration; }
+	static Cvar* GetCvarBySlot(cvarID_t id) { return (id >= 0 && id < (cvarID_t)vCvarSlots.size()) ? vCvarSlots[id] : nullptr; }
+
+	static int GetCvarFlags(const string& sName) { Cvar* cv = FindCvar(sName); return cv ? cv->flags : 0; }
+	static void SetCvarFlags(const string& sName, int flags) { Cvar* cv = FindCvar(sName); if (cv) cv->flags = flags; }
+	static Cvar::cvarType_e GetCvarType(const string& sName) { Cvar* cv = FindCvar(sName); return cv ? cv->type : Cvar::CV_STRING; }
+
+	static void SetStringValue(Cvar* cv, char* newValue) {
+		strncpy(cv->s.currentVal, newValue, sizeof(cv->s.currentVal) - 1);
+		cv->s.currentVal[sizeof(cv->s.currentVal) - 1] = '\0';
+		cv->Publish();
+		cv->RunCallback();
+	}
+	static void SetIntegerValue(Cvar* cv, int newValue) { cv->i.currentVal = newValue; cv->Publish(); cv->RunCallback(); }
+	static void SetFloatValue(Cvar* cv, float newValue) { cv->v.currentVal = newValue; cv->Publish(); cv->RunCallback(); }
+	static void SetBooleanValue(Cvar* cv, bool newValue) { cv->b.currentVal = newValue; cv->Publish(); cv->RunCallback(); }
 
-	static void SetStringValue(const string &sName, char* newValue) { strcpy(cvars[sName]->s.currentVal, newValue); cvars[sName]->RunCallback(); }
-	static void SetIntegerValue(const string &sName, int newValue) { cvars[sName]->i.currentVal = newValue; cvars[sName]->RunCallback(); }
-	static void SetFloatValue(const string &sName, float newValue) { cvars[sName]->v.currentVal = newValue; cvars[sName]->RunCallback(); }
-	static void SetBooleanValue(const string &sName, bool newValue) { cvars[sName]->b.currentVal = newValue; cvars[sName]->RunCallback(); }
+	static void SetStringValue(const string &sName, char* newValue) { Cvar* cv = FindCvar(sName); if (cv) SetStringValue(cv, newValue); }
+	static void SetIntegerValue(const string &sName, int newValue) { Cvar* cv = FindCvar(sName); if (cv) SetIntegerValue(cv, newValue); }
+	static void SetFloatValue(const string &sName, float newValue) { Cvar* cv = FindCvar(sName); if (cv) SetFloatValue(cv, newValue); }
+	static void SetBooleanValue(const string &sName, bool newValue) { Cvar* cv = FindCvar(sName); if (cv) SetBooleanValue(cv, newValue); }
 
 	static string GetStringValue(const char* sName);
 	static int GetIntegerValue(const char* sName);
@@ -255,6 +322,52 @@ public:
 friend class Cvar;
 };
 
+template<> inline char* Cvar::Read<char*>() { return s.currentVal; }
+template<> inline int Cvar::Read<int>() { return i.currentVal; }
+template<> inline float Cvar::Read<float>() { return v.currentVal; }
+template<> inline bool Cvar::Read<bool>() { return b.currentVal; }
+
+template<typename T> struct CvarTypeOf { };
+template<> struct CvarTypeOf<char*> { static const Cvar::cvarType_e type = Cvar::CV_STRING; };
+template<> struct CvarTypeOf<int> { static const Cvar::cvarType_e type = Cvar::CV_INTEGER; };
+template<> struct CvarTypeOf<float> { static const Cvar::cvarType_e type = Cvar::CV_FLOAT; };
+template<> struct CvarTypeOf<bool> { static const Cvar::cvarType_e type = Cvar::CV_BOOLEAN; };
+
+// Typed handle to a cvar, made with CVAR_REF. The name is hashed at compile time and resolved to a slot
+// on first use; from then on reads and writes go straight to the slot without touching any strings.
+template<typename T>
+class CvarRef {
+private:
+	const char* szName;
+	uint32_t uHash;
+	mutable cvarID_t id;
+
+	Cvar* Resolve() const {
+		if(id == CVAR_INVALID_ID) {
+			cvarID_t found = CvarSystem::GetCvarID(uHash, szName);
+			Cvar* cv = CvarSystem::GetCvarBySlot(found);
+			if(cv == nullptr) {
+				return nullptr;	// not registered yet, try again next time
+			}
+			if(cv->GetType() != CvarTypeOf<T>::type) {
+				R_Message(PRIORITY_WARNING, "CvarRef: %s is %s, not the requested type\n", szName, cv->TypeToString().c_str());
+				return nullptr;
+			}
+			id = found;
+		}
+		return CvarSystem::GetCvarBySlot(id);
+	}
+public:
+	CvarRef(const char* name, uint32_t hash) : szName(name), uHash(hash), id(CVAR_INVALID_ID) { }
+
+	bool Valid() const { return Resolve() != nullptr; }
+	Cvar* Get() const { return Resolve(); }
+	T Value() const { Cvar* cv = Resolve(); return cv ? cv->Read<T>() : T(); }
+	void SetValue(T value) { Cvar* cv = Resolve(); if(cv) cv->SetValue(value); }
+	operator T() const { return Value(); }
+};
+#define CVAR_REF(type, name)	CvarRef<type>(name, CvarHashName(name))
+
 /* Memory */
 
 //
@@ -277,13 +390,22 @@ namespace Zone {
 
 	extern string tagNames[];
 
+	#define ZONE_DEFAULT_ALIGNMENT	64				// one cache line, enough for any SIMD load
+	#define ZONE_PAGE_SIZE			4096
+	#define ZONE_LARGE_ALLOCATION	(256 * 1024)	// allocations at least this big get page aligned
+	#define ZONE_HUGEPAGE_SIZE		(2 * 1024 * 1024)
+
+	size_t AlignmentForSize(size_t iSize);
+
 	struct ZoneChunk {
 		size_t memInUse;
 		bool isClassObject;
+		bool isAligned;
+		size_t alignment;		// what AllocAligned was asked for, so that Realloc keeps it
 
-		ZoneChunk(size_t mem, bool bClass) : 
-		memInUse(mem), isClassObject(bClass) {}
-		ZoneChunk() { memInUse = 0; isClassObject = false; }
+		ZoneChunk(size_t mem, bool bClass, size_t align = 0) : 
+		memInUse(mem), isClassObject(bClass), isAligned(align != 0), alignment(align) {}
+		ZoneChunk() { memInUse = 0; isClassObject = false; isAligned = false; alignment = 0; }
 	};
 
 	struct ZoneTag {
@@ -291,33 +413,96 @@ namespace Zone {
 		size_t peakUsage;
 		map<void*, ZoneChunk> zone;
 
-		ZoneTag() : zoneInUse(0), peakUsage(0) { }
+		// Budgets are in KB, 0 means there isn't one
+		Cvar* softBudget;
+		Cvar* hardBudget;
+		bool bOverSoftBudget;
+		bool bOverHardBudget;
+		bool bEvictionPending;	// crossed the soft budget, the callbacks run on the next RunEvictions
+		vector<zoneEvictionCallback> vEvictionCallbacks;
+
+		ZoneTag() : zoneInUse(0), peakUsage(0), softBudget(nullptr), hardBudget(nullptr), 
+			bOverSoftBudget(false), bOverHardBudget(false), bEvictionPending(false) { }
+	};
+
+	// Only filled in while allocation tracking is enabled (zonetrack)
+	struct ZoneAllocRecord {
+		void* pCallsite;
+		const char* szTag;
+		size_t size;
+		unsigned int uFrameNum;
+	};
+
+	struct ZoneSiteStats {
+		size_t liveBytes;
+		size_t liveBlocks;
+		unsigned int uFirstFrame;
+		unsigned int uLastFrame;
+
+		ZoneSiteStats() : liveBytes(0), liveBlocks(0), uFirstFrame(0), uLastFrame(0) { }
 	};
+	typedef map<void*, ZoneSiteStats> ZoneSnapshot;
 
 	class MemoryManager {
 	private:
 		unordered_map<string, ZoneTag> zone;
+		recursive_mutex zoneMutex;	// the filesystem threads allocate too
+
+		bool bTracking;
+		unordered_map<void*, ZoneAllocRecord> umTrackedBlocks;
+		map<string, ZoneSnapshot> mSnapshots;
+		bool bBudgetsReady;
+		Metric* pMetricAllocs;
+		Metric* pMetricFrees;
+		void CountAllocation();
+		void CheckBudget(const string& tag, ZoneTag& zt);
+		void RegisterBudgetCvars(const string& tag, ZoneTag& zt);
+		void ReportBudgetOverrun(const string& tag, ZoneTag& zt, size_t hardBytes);
+
+		void TrackAllocation(void* memory, size_t iSize, const string& tag, void* pCallsite);
+		void UntrackAllocation(void* memory);
+		void BuildSnapshot(ZoneSnapshot& snapshot, const string& tag = "");
 	public:
-		void* Allocate(int iSize, zoneTags_e tag);
-		void* Allocate(int iSize, const string& tag);
+		void* Allocate(int iSize, zoneTags_e tag, void* pCallsite = nullptr);
+		void* Allocate(int iSize, const string& tag, void* pCallsite = nullptr);
+		void* AllocateAligned(int iSize, const string& tag, size_t alignment, void* pCallsite = nullptr);
 		void Free(void* memory);
-		void FastFree(void* memory, const string& tag);
+		size_t FastFree(void* memory, const string& tag);
 		void FreeAll(const string& tag);
 		void* Reallocate(void *memory, size_t iNewSize);
-		void CreateZoneTag(const string& tag) { zone[tag] = ZoneTag(); }
+		void CreateZoneTag(const string& tag);
 		MemoryManager();
 		~MemoryManager(); // deliberately ignoring rule of three
 		void PrintMemUsage();
+		void PublishMetrics();
+
+		void InitBudgets();
+		void AddEvictionCallback(const string& tag, zoneEvictionCallback callback);
+		void RemoveEvictionCallback(const string& tag, zoneEvictionCallback callback);
+		void RunEvictions();
+
+		void SetTracking(bool bEnabled);
+		bool IsTracking() { return bTracking; }
+		void PrintTopAllocators(size_t numSites, const string& tag);
+		void PrintSizeHistogram();
+		void TakeSnapshot(const string& name);
+		void PrintSnapshotDiff(const string& from, const string& to);
 
 		template<typename T>
-		T* AllocClass(zoneTags_e tag) {
+		T* AllocClass(zoneTags_e tag, void* pCallsite = nullptr) {
 			T* retVal = new T();
 			ZoneChunk zc(sizeof(T), true);
+			lock_guard<recursive_mutex> lock(zoneMutex);
 			zone[tagNames[tag]].zoneInUse += sizeof(T);
 			if(zone[tagNames[tag]].zoneInUse > zone[tagNames[tag]].peakUsage) {
 				zone[tagNames[tag]].peakUsage = zone[tagNames[tag]].zoneInUse;
 			}
 			zone[tagNames[tag]].zone[retVal] = zc;
+			CountAllocation();
+			if(bTracking) {
+				TrackAllocation(retVal, sizeof(T), tagNames[tag], pCallsite);
+			}
+			CheckBudget(tagNames[tag], zone[tagNames[tag]]);
 			return retVal;
 		}
 	};
@@ -329,17 +514,79 @@ namespace Zone {
 
 	void* Alloc(int iSize, zoneTags_e tag);
 	void* Alloc(int iSize, const string& tag);
+	void* AllocAligned(int iSize, zoneTags_e tag, size_t alignment = 0);
+	void* AllocAligned(int iSize, const string& tag, size_t alignment = 0);
 	void* VMAlloc(int iSize, const char* tag)/* { return Alloc(iSize, tag); }*/ ;
+	void* VMAllocAligned(int iSize, const char* tag, size_t alignment);
 	void  Free(void* memory);
-	void  FastFree(void *memory, const string& tag);
+	size_t FastFree(void *memory, const string& tag);
 	void  VMFastFree(void* memory, const char* tag)/* { FastFree(memory, tag); }*/ ;
 	void  FreeAll(const string& tag);
 	void  VMFreeAll(const char* tag)/* { FreeAll(tag); }*/ ;
 	void* Realloc(void *memory, size_t iNewSize);
 	void  NewTag(const char* tag)/* { mem->CreateZoneTag(tag); }*/ ;
+	void  InitBudgets();
+	void  AddEvictionCallback(const string& tag, zoneEvictionCallback callback);
+	void  RemoveEvictionCallback(const string& tag, zoneEvictionCallback callback);
+	void  RunEvictions();
+	void  VMAddEvictionCallback(const char* tag, zoneEvictionCallback callback);
+	void  VMRemoveEvictionCallback(const char* tag, zoneEvictionCallback callback);
+	// Kept out of line, so that the return address is whoever called New
 	template<typename T>
-	T* New(zoneTags_e tag) { return mem->AllocClass<T>(tag); }
+	Sys_NoInline T* New(zoneTags_e tag) { return mem->AllocClass<T>(tag, Sys_ReturnAddress()); }
 	void MemoryUsage();
+	void PublishMetrics();
+
+	void SetTracking(bool bEnabled);
+	bool IsTracking();
+	void TopAllocators(size_t numSites, const string& tag);
+	void SizeHistogram();
+	void Snapshot(const string& name);
+	void SnapshotDiff(const string& from, const string& to);
+};
+
+//
+// Pool.cpp
+//
+
+#define CACHE_LINE_SIZE		64
+
+// Slab allocator for small objects that get created and destroyed constantly.
+// Every slot starts on its own cache line, so objects touched by different threads don't share one.
+class MemoryPool {
+private:
+	struct FreeSlot {
+		FreeSlot* pNext;
+	};
+
+	const char* szName;
+	size_t ulSlotSize;
+	size_t ulSlotsPerSlab;
+	vector<void*> vSlabs;
+	FreeSlot* pFreeList;
+	size_t ulInUse;
+	size_t ulPeakInUse;
+	size_t ulTotalAllocs;
+	mutex mut;
+
+	void AllocateSlab();
+	static vector<MemoryPool*>& GetPoolList();
+public:
+	MemoryPool(const char* name, size_t objectSize, size_t slotsPerSlab);
+	~MemoryPool();
+
+	void* Allocate();
+	void* AllocateObject(size_t size);
+	void Free(void* memory);
+
+	static void PrintPoolUsage();
+};
+
+template<typename T>
+class ObjectPool : public MemoryPool {
+public:
+	ObjectPool(const char* name, size_t slotsPerSlab) : MemoryPool(name, sizeof(T), slotsPerSlab) {}
+	T* Alloc() { return (T*)Allocate(); }
 };
 
 //
@@ -358,6 +605,38 @@ public:
 	MutexVariable<T>(T& other) { var = other; }
 };
 
+//
+// ResTrace.cpp
+//
+#define RESTRACE_HISTORY	2048	// finished requests that restrace can look back over
+#define RESTRACE_NAMELEN	64
+
+enum traceStage_e {
+	TRACE_ENQUEUE,
+	TRACE_DEQUEUE,
+	TRACE_IODONE,			// path resolved and the bytes read (or written)
+	TRACE_DECODEDONE,		// deserialized; only resources have this
+	TRACE_CALLBACKDONE,
+	TRACE_MAX
+};
+
+// Timestamps for one Resource or File request on its way through the filesystem.
+// Stages that a request never stamps take no time.
+struct requestTrace_t {
+	const char* szKind;
+	char szName[RESTRACE_NAMELEN];
+	uint64_t ulStamps[TRACE_MAX];
+
+	void Begin(const char* kind, const char* name);		// stamps the enqueue
+	void Stamp(traceStage_e stage);
+};
+
+namespace ResTrace {
+	void Submit(requestTrace_t& trace);
+	void GetFinished(uint64_t ulSince, vector<requestTrace_t>& vOut);
+	void Print(int seconds, int numSlowest);
+}
+
 //
 // FileSystem.cpp
 //
@@ -370,16 +649,30 @@ namespace Filesystem {
 
 	extern Cvar* fs_multithreaded;
 	extern Cvar* fs_threads;
+	extern Cvar* fs_hugepages;
+
+	extern Metric* pMetricBytesRead;
+	extern Metric* pMetricBytesWritten;
+	extern Metric* pMetricCacheHits;
+	extern Metric* pMetricCacheMisses;
 
 	void Init();
 	void Exit();
 
+	void* AllocPayload(size_t size);
+	size_t FreePayload(void* memory);
+
 	string& ResolveFilePath(string& filePath, const string& file, const string& mode);
 	string ResolveAssetPath(const string& assetName);
 	char* ResolveFilePath(char* buffer, size_t bufferSize, const char* file, const char* mode);
 	const char* ResolveAssetPath(const char* assetName);
 
-	void LoadRaptureAsset(RaptureAsset** pAsset, const string& assetName);
+	extern recursive_mutex assetCacheMutex;
+
+	bool LoadRaptureAsset(RaptureAsset** pAsset, const string& assetName, requestTrace_t* pTrace = nullptr);
+	void CacheRaptureAsset(RaptureAsset* pAsset, const string& assetName);
+	void AcquireRaptureAsset(const string& assetName);
+	void ReleaseRaptureAsset(const string& assetName);
 	AssetComponent* FindComponentByName(RaptureAsset* pAsset, const char* compName);
 
 	void QueueFileOpen(File* pFile, fileOpenedCallback callback);
@@ -412,6 +705,9 @@ private:
 public:
 	File(const File& other);
 
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr);
+
 	static File*	OpenAsync(const char* file, const char* mode = "rb+", fileOpenedCallback callback = nullptr);
 	static void		ReadAsync(File* pFile, void* data, size_t dataSize, fileReadCallback callback = nullptr);
 	static void		WriteAsync(File* pFile, void* data, size_t dataSize, fileWrittenCallback callback = nullptr);
@@ -428,10 +724,10 @@ public:
 	static bool		WriteSync(File* pFile, void* data, size_t dataSize);
 	static bool		CloseSync(File* pFile);
 
-	void DequeOpen(fileOpenedCallback callback);
-	void DequeRead(void* data, size_t dataSize, fileReadCallback callback);
-	void DequeWrite(void* data, size_t dataSize, fileWrittenCallback callback);
-	void DequeClose(fileClosedCallback callback);
+	void DequeOpen(fileOpenedCallback callback, requestTrace_t* pTrace = nullptr);
+	void DequeRead(void* data, size_t dataSize, fileReadCallback callback, requestTrace_t* pTrace = nullptr);
+	void DequeWrite(void* data, size_t dataSize, fileWrittenCallback callback, requestTrace_t* pTrace = nullptr);
+	void DequeClose(fileClosedCallback callback, requestTrace_t* pTrace = nullptr);
 
 	const char* GetFileMode() { return mode.c_str(); }
 	const char* GetFilePath() { return path.c_str(); }
@@ -443,19 +739,23 @@ class Resource {
 	AssetComponent* component;
 	bool bRetrieved;
 	bool bBad;
+	bool bHoldsAsset;
 
 	string szAssetFile;
 	string szComponent;
 
 	Resource();
 public:
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr);
+
 	static Resource* ResourceAsync(const char* asset, const char* component, assetRequestCallback callback = nullptr);
 	static Resource* ResourceAsyncURI(const char* uri, assetRequestCallback callback = nullptr);
 	static Resource* ResourceSync(const char* asset, const char* component);
 	static Resource* ResourceSyncURI(const char* uri);
 	static void FreeResource(Resource* pResource);
 
-	void DequeRetrieve(assetRequestCallback callback);
+	void DequeRetrieve(assetRequestCallback callback, requestTrace_t* pTrace = nullptr);
 
 	bool Retrieved();
 	bool Bad();
@@ -464,6 +764,8 @@ public:
 
 	AssetComponent* GetAssetComponent() { return component; }
 	static AssetComponent* GetAssetComponent(Resource* pRes) { return pRes->GetAssetComponent(); }
+	const char* GetAssetName() { return szAssetFile.c_str(); }
+	const char* GetComponentName() { return szComponent.c_str(); }
 };
 
 struct AsyncFileTask {
@@ -479,6 +781,7 @@ struct AsyncFileTask {
 	void* callback;
 	void* data;
 	size_t	dataSize;
+	requestTrace_t trace;
 
 	AsyncFileTask& operator=(const AsyncFileTask& rhs);
 };
@@ -491,6 +794,7 @@ struct AsyncResourceTask {
 	TaskType type;
 	Resource* pResource;
 	void* callback;
+	requestTrace_t trace;
 
 	AsyncResourceTask& operator=(const AsyncResourceTask& rhs);
 };
@@ -499,16 +803,52 @@ struct AsyncResourceTask {
 // CmdSystem.cpp
 //
 
+#define MAX_CMD_TOKENS	128
+
+// One argument of a command. Points into the text of the command instead of copying it, so it is not null-terminated
+// and is only valid for as long as the command is being executed.
+struct CmdToken {
+	const char* text;
+	size_t length;
+
+	string ToString() const { return string(text, length); }
+	bool Equals(const char* other) const { return !strncmp(text, other, length) && other[length] == '\0'; }
+	int ToInteger() const { return atoi(ToString().c_str()); }
+	float ToFloat() const { return (float)atof(ToString().c_str()); }
+};
+
+// Tokenized arguments of a command, held inline (no heap allocations)
+struct CmdArgs {
+	size_t numTokens;
+	CmdToken tokens[MAX_CMD_TOKENS];
+
+	CmdArgs() : numTokens(0) { }
+	size_t size() const { return numTokens; }
+	const CmdToken& operator[](size_t index) const { return tokens[index]; }
+};
+
+typedef void(*conCmdArgs_t)(const CmdArgs& args);
+
 namespace Cmd {
 	void ProcessCommand(const char *cmd);
+	void AppendCommand(const string& text);
+	void InsertCommand(const string& text);
+	void ExecuteBuffer();
+	void FlushBuffer();
+	void Wait(int frames);
+	typedef vector<string>::const_iterator tabCompletionIterator;
 	void AddTabCompletion(const string& cmdName);
+	void RemoveTabCompletion(const string& cmdName);
+	void TabCompletionRange(const string& prefix, tabCompletionIterator& begin, tabCompletionIterator& end);
 	void AddCommand(const string& cmdName, conCmd_t cmd);
 	void AddCommand(const char* cmdName, conCmd_t cmd);
+	void AddCommand(const char* cmdName, conCmdArgs_t cmd);
 	void RemoveCommand(const string& cmdName);
 	void RemoveCommand(const char* cmdName);
 	void ClearCommandList();
 	void ListCommands();
 	vector<string> Tokenize(const string &str);
+	void Tokenize(const char* str, CmdArgs& args);
 	string TabComplete(const string& input);
 };
 
@@ -545,8 +885,8 @@ extern const string keycodeNames[];
 //
 class Timer {
 protected:
-	unsigned long ulStartTicks;
-	unsigned long ulPausedTicks;
+	uint64_t ulStartCounter;		// performance counter ticks, not milliseconds
+	uint64_t ulPausedCounter;
 
 	bool bIsStarted;
 	bool bIsPaused;
@@ -562,18 +902,114 @@ public:
 	void Unpause();
 
 	unsigned long GetTicks();
+	uint64_t GetMicroseconds();
+	uint64_t GetNanoseconds();
+
+	static uint64_t Nanoseconds();
 
 	bool IsStarted() { return bIsStarted; };
 	bool IsPaused() { return bIsPaused; };
 };
 
+//
+// Profiler.cpp
+//
+#define PROFILE_MAX_DEPTH	32		// zones nested deeper than this on one thread aren't recorded
+#define PROFILE_MAX_FRAMES	600
+
+struct ProfileEvent {
+	const char* szName;		// must stay valid until the capture is written (modcode names are interned for this)
+	uint64_t ulStart;		// nanoseconds since startup
+	uint64_t ulDuration;
+};
+
+namespace Profiler {
+	uint64_t Nanoseconds();
+	void SetThreadName(const char* name);
+	void ExitThread();
+	void BeginZone(const char* name);
+	void VMBeginZone(const char* name);
+	void EndZone();
+	void Init();
+	void FrameBoundary();
+	void StartCapture(int numFrames, const char* filename);
+	bool IsCapturing();
+	void ReportHitch(unsigned long ulFrameTicks);
+}
+
+class ProfileScope {
+public:
+	ProfileScope(const char* name) { Profiler::BeginZone(name); }
+	~ProfileScope() { Profiler::EndZone(); }
+};
+
+#define PROFILE_CONCAT_(a, b)	a##b
+#define PROFILE_CONCAT(a, b)	PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name)		ProfileScope PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION()		PROFILE_ZONE(__FUNCTION__)
+
 
 //
 // Dispatch.cpp
 //
+#define LOG_RING_SIZE		1024	// must be a power of two
+#define LOG_WRITER_SLEEP	5		// milliseconds the writer thread sleeps when there's nothing to write
+
+class LogWriter {
+private:
+	struct LogRecord {
+		atomic<size_t> ulSequence;
+		int iPriority;
+		unsigned int uTicks;
+		bool bBinary;				// szMessage holds an encoded binary log record instead of text
+		unsigned short usLength;	// length of the binary record
+		char szMessage[1024];
+	};
+
+	File* ptLogFile;
+	bool bBinaryLog;
+	LogRecord* ptRecords;
+	atomic<size_t> ulEnqueuePos;
+	size_t ulDequeuePos;		// only touched by the writer thread
+	atomic<size_t> ulWritten;
+	atomic<size_t> ulDropped;
+	size_t ulDroppedReported;
+	bool bLastHadNewline;
+	atomic<bool> bRunning;
+	thread thWriter;
+
+	// Binary log format strings, by address. The text is kept so that a reused address (eg a reloaded DLL) is noticed
+	mutex mFormats;
+	unordered_map<const char*, pair<uint32_t, string>> umFormatIDs;
+	uint32_t uNextFormatID;
+
+	LogRecord* Reserve(size_t& pos);
+	void Commit(LogRecord* pRecord, size_t pos);
+	bool FormatID(const char* fmt, uint32_t& id);
+	void FormatRecord(const LogRecord& record, string& out);
+	size_t WriteBatch();
+	void WriterThread();
+public:
+	LogWriter(File* ptFile, bool bBinary = false);
+	~LogWriter();
+	bool Push(int iPriority, const char* message);
+	bool PushBinary(int iPriority, const char* fmt, va_list args);
+	void Flush();
+	void Stop();
+	bool IsBinary() const { return bBinaryLog; }
+	size_t GetDropped() { return ulDropped.load(memory_order_relaxed); }
+};
+
 class Dispatch {
 private:
 	File* ptLogFile;
+	atomic<LogWriter*> ptLogWriter;		// swapped when com_binarylog changes, while other threads are logging
+	vector<LogWriter*> vRetiredWriters;	// other threads might still be pushing to these, so they live until shutdown
+	atomic<bool> bBinaryLog;
+	int iBinaryLogs;					// each binary log gets its own file, since format IDs start over
+	char szLogName[MAX_HANDLE_STRING*2];
+
+	void OpenLog(bool bBinary);
 
 	int iHiddenMask;
 	int iShutdownMask;
@@ -585,21 +1021,26 @@ public:
 	Dispatch(const int _iHiddenMask, const int _iShutdownMask, const int _iMessageMask);
 	void CatchError();
 	void PrintMessage(const int iPriority, const char* message);
+	void PrintBinary(const int iPriority, const char* fmt, va_list args);
+	bool IsHidden(const int iPriority) const { return (iHiddenMask & (1 << iPriority)) && iPriority != PRIORITY_ERRFATAL; }
+	bool IsBinaryLogging() const { return bBinaryLog; }
 	void Setup();
 	~Dispatch();
 
 	static void ChangeHiddenMask(int newValue);
 	static void ChangeShutdownMask(int newValue);
 	static void ChangeMessageMask(int newValue);
+	static void ChangeBinaryLog(bool newValue);
 };
 extern Dispatch* ptDispatch;
 
-/* Netcode. Note that only TCP is supported, not UDP. */
+/* Netcode. Connections go over TCP or UDP, depending on net_transport. */
 
 #ifdef _WIN32
 typedef SOCKET socket_t;
 #else
 typedef int socket_t;
+#define INVALID_SOCKET	(-1)
 #endif
 
 #define RAPTURE_DEFAULT_PORT		1750
@@ -608,6 +1049,20 @@ typedef int socket_t;
 
 #define RAPTURE_NETPROTOCOL			0
 
+#define NET_UDP_MAXDATAGRAM			65507	// biggest UDP payload there is; IP fragments anything over the MTU
+#define NET_UDP_ACKBITS				32		// datagrams before the latest one that each ack covers
+#define NET_UDP_SENTHISTORY			1024	// sent datagrams remembered until they're acked (divides 65536)
+#define NET_UDP_RELIABLEWINDOW		256		// reliable messages that can be in flight on one channel at once
+#define NET_UDP_INITIAL_RTO			200		// milliseconds before the first retransmit, until there's an RTT sample
+#define NET_UDP_MIN_RTO				20
+#define NET_UDP_MAX_RTO				2000
+#define NET_UDP_HALFOPEN_TIMEOUT	5000	// milliseconds a new peer gets to ack something of ours before it's dropped
+
+#define NETPOLL_MAXEVENTS			256		// readiness events taken per epoll_wait
+#define NET_TCP_SENDBACKLOG			(1 << 20)	// bytes that can wait on a TCP connection before it's given up on
+#define NET_LISTEN_TIMEOUT			2000	// milliseconds the game waits to hear whether the network thread could listen
+#define NET_QUEUE_CAPACITY			64		// messages preallocated in each queue to and from the network thread, and packets per slab
+
 // The Network namespace contains all of the basic, low-level functions 
 namespace Network {
 	enum NetworkInterfaceCallbacks {
@@ -638,27 +1093,66 @@ namespace Network {
 	typedef bool(*networkCallbackFunction)(...);
 	typedef pair<Packet, int> packetMsg;
 
+	// What goes between the game thread and the network thread
+	enum netMessageType_e {
+		NETMSG_LISTEN,				// game -> network: pSocket is the new local socket; start listening on it
+		NETMSG_CONNECTED,			// game -> network: pSocket is our connection to a remote server, clientNum numbers it
+		NETMSG_DISCONNECT,			// game -> network: close the connection to the remote server
+		NETMSG_SENDTOCLIENT,		// game -> network: packet for clientNum (-1 for everybody)
+		NETMSG_SENDTOSERVER,		// game -> network: packet for the remote server
+		NETMSG_CLIENTCONNECTED,		// network -> server: clientNum was accepted
+		NETMSG_CLIENTDROPPED,		// network -> server: clientNum closed its connection or timed out
+		NETMSG_CLIENTPACKET,		// network -> server: packet from clientNum
+		NETMSG_SERVERPACKET,		// network -> client: packet from the remote server (clientNum is the connection's number)
+		NETMSG_SERVERLOST,			// network -> client: the remote server closed the connection or timed out (likewise)
+	};
+
+	struct netMessage_t {
+		netMessageType_e type;
+		int clientNum;
+		Socket* pSocket;
+		Packet* pPacket;			// nullptr if there isn't one; whoever takes the message out frees it with Thread::FreePacket
+	};
+
+	// Packets and bytes (header included) that went over one connection
+	struct trafficMetrics_t {
+		Metric* pPacketsIn;
+		Metric* pBytesIn;
+		Metric* pPacketsOut;
+		Metric* pBytesOut;
+
+		void CountIn(const Packet& packet);
+		void CountOut(const Packet& packet);
+	};
+
 	extern Cvar* net_port;
 	extern Cvar* net_serverbacklog;
 	extern Cvar* net_maxclients;
 	extern Cvar* net_netmode;
 	extern Cvar* net_timeout;
 	extern Cvar* net_ipv6;
+	extern Cvar* net_transport;
 
-	extern Socket*				localSocket;
-	extern map<int, Socket*>	mOtherConnectedClients;
-	extern Socket*				remoteSocket;
+	extern Cvar* net_threadsleep;
+
+	extern set<int>				sOtherConnectedClients;		// as the game thread knows them; the sockets belong to the network thread
+	extern bool					bRemoteConnection;
 	extern vector<packetMsg>	vPacketsAwaitingSend;
 	extern Netstate_e			currentNetState;
-	extern vector<Socket*>		vTemporaryConnections;
 
 	extern int			numConnectedClients;
 	extern int			myClientNum;				// Client 0 is always the host
 	extern int			lastFreeClientNum;
 	extern networkCallbackFunction	callbacks[NIC_MAX];
+	extern trafficMetrics_t	serverTraffic;
 
 	void Init();
 	void Shutdown();
+	trafficMetrics_t& ClientTraffic(int clientNum);
+	void ReleaseClientTraffic(int clientNum);
+	int TransportSocketType();
+	netChannel_e PacketChannel(uint32_t packetType);
+	void SetPacketChannel(packetType_e packetType, netChannel_e channel);
 	void AddCallback(NetworkInterfaceCallbacks callback, networkCallbackFunction func);
 	void RemoveCallback(NetworkInterfaceCallbacks callback);
 
@@ -677,6 +1171,29 @@ namespace Network {
 		bool JoinServer(const char* hostname);
 		void Connect(const char* hostname);
 		void DispatchSinglePacket(Packet& packet);
+		void DeliverPacket(Packet& packet);
+	}
+
+	// NetPoll.cpp
+	namespace Poll {
+		void Init();
+		void Shutdown();
+		void Add(Socket* pSocket);
+		void Remove(Socket* pSocket);
+		void Wait(int msTimeout);
+		bool IsReady(Socket* pSocket);
+		void Drained(Socket* pSocket);
+	}
+
+	// NetThread.cpp
+	namespace Thread {
+		void Init();
+		void Shutdown();
+		void Post(netMessageType_e type, int clientNum, Socket* pSocket, const Packet* pPacket);
+		bool Listen(Socket* pSocket);
+		void FreePacket(Packet* pPacket);
+		bool ReceiveForServer(netMessage_t& message);
+		bool ReceiveForClient(netMessage_t& message);
 	}
 
 	namespace Packets {
@@ -704,27 +1221,57 @@ namespace Network {
 
 //
 // Socket.cpp
-// Socket is just a wrapper for internal socket format, with some functions operating on it
-// TODO: Make this into a class with inheritance (TCPSocket.cpp/UDPSocket.cpp)
+// A Socket is one connection (or a server that's listening for them). Socket::Create makes whichever kind net_transport asks for.
 //
 struct Socket {
-private:
+protected:
 	socket_t internalSocket;
 	int af, type;
 
+	Socket(int af_, int type_);
 	bool SetNonBlocking();
-	bool SendPacketHeader(PacketHeader& head);
-	bool RecvPacketHeader(PacketHeader& head);
-	bool SendEntireData(void* data, size_t dataSize);
-	bool ReadEntireData(void* data, size_t dataSize);
+	bool Resolve(const char* hostname, unsigned short port, sockaddr_storage& address, int& addressSize);
 public:
 	uint64_t lastHeardFrom;
 	uint64_t lastSpoken;
 
-	Socket(int af_, int type_);
-	Socket(addrinfo& pConnectingClient, socket_t socket);
-	Socket(Socket& other);
-	~Socket();
+	static Socket* Create(int af);
+	virtual ~Socket() {}
+
+	int GetType() const { return type; }
+
+	virtual bool Connect(const char* hostname, unsigned short port) = 0;
+	virtual bool StartListening(unsigned short port, uint32_t backlog) = 0;
+	virtual void Disconnect() = 0;
+
+	virtual bool SendPacket(Packet& outgoing) = 0;
+	virtual bool ReadPacket(Packet& incoming) = 0;
+	virtual Socket* CheckPendingConnections() = 0;
+	virtual bool Select() = 0;
+
+	// Pushes out whatever couldn't be sent right away; false once the connection has broken or fallen too far behind
+	virtual bool FlushSends() { return true; }
+
+	// The descriptor that readiness gets reported on, or INVALID_SOCKET if it doesn't have one of its own
+	virtual socket_t PollHandle() { return internalSocket; }
+};
+
+// A stream, so everything arrives and in order. Packets are sent as the header fields followed by the data.
+// Sends never block: whatever the connection won't take yet waits in vSendBacklog for FlushSends.
+struct TCPSocket : public Socket {
+private:
+	vector<char> vSendBacklog;
+	bool bSendFailed;
+
+	bool RecvPacketHeader(PacketHeader& head);
+	bool ReadEntireData(void* data, size_t dataSize);
+public:
+	TCPSocket(int af_);
+	TCPSocket(addrinfo& pConnectingClient, socket_t socket);
+	~TCPSocket();
+
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr);
 
 	bool Connect(const char* hostname, unsigned short port);
 	bool StartListening(unsigned short port, uint32_t backlog);
@@ -740,6 +1287,98 @@ public:
 	bool ReadPacket(Packet& incoming);
 	Socket* CheckPendingConnections();
 	bool Select();
+	bool FlushSends();
+};
+
+//
+// UDPSocket.cpp
+// Connections over UDP, with each packet going on the channel that Network::PacketChannel picks for its type.
+// A listening UDPSocket hands out one UDPSocket per address that it hears from; they all share its socket.
+//
+struct UDPSocket : public Socket {
+private:
+	struct sentDatagram_t {
+		uint16_t sequence;
+		bool bUsed;
+		bool bAcked;
+		uint64_t ulSent;			// nanoseconds
+		int channel;				// -1 if it only carried acks
+		uint16_t messageId;
+	};
+
+	struct outgoingMessage_t {
+		uint16_t messageId;
+		uint64_t ulLastSent;		// nanoseconds
+		int numSends;
+		vector<char> vData;
+	};
+
+	struct channel_t {
+		uint16_t nextSendId;
+		uint16_t nextReceiveId;		// sequenced: one past the newest received, reliable: the oldest not yet received
+		bool bReceivedAny;
+		bool bReceived[NET_UDP_RELIABLEWINDOW];		// unordered: ones past nextReceiveId that already came in
+		map<uint16_t, Packet> mEarly;				// ordered: ones past nextReceiveId waiting for the gap to fill
+		deque<outgoingMessage_t> vUnacked;
+		deque<outgoingMessage_t> vWaiting;			// reliable ones that didn't fit in the window yet
+	};
+
+	UDPSocket* pListener;					// peers: the listening socket that they share
+	map<string, UDPSocket*> mPeers;			// listening: every peer, by address
+	deque<UDPSocket*> vPendingPeers;		// listening: peers that CheckPendingConnections hasn't handed out yet
+	size_t ulMaxPeers;						// listening: net_maxclients plus the backlog
+	uint64_t ulCreated;						// peers: when the first datagram came in
+
+	sockaddr_storage remoteAddress;
+	int remoteAddressSize;
+	bool bClosed;							// the other side said goodbye, or the listener went away
+
+	uint16_t localSequence;
+	uint16_t remoteSequence;
+	uint32_t receivedBits;					// bit n set means remoteSequence - 1 - n came in
+	bool bReceivedAny;
+	bool bAckPending;
+	sentDatagram_t sentDatagrams[NET_UDP_SENTHISTORY];
+
+	float fSmoothedRTT;						// milliseconds
+	float fRTTVariance;
+	bool bHaveRTT;
+
+	channel_t channels[CHANNEL_MAX];
+	deque<Packet> vInbox;					// delivered and waiting on ReadPacket
+	vector<char> vReceiveBuffer;			// sockets can be read on more than one thread, so each one that has a descriptor gets its own
+
+	UDPSocket(UDPSocket* listener, const sockaddr_storage& address, int addressSize);
+	void Reset();
+	socket_t Handle();
+	void Pump();
+	void Receive(const char* data, size_t size);
+	void ProcessAck(uint16_t sequence);
+	void Deliver(int channel, uint16_t messageId, Packet& packet);
+	bool SendDatagram(uint8_t flags, int channel, uint16_t messageId, const vector<char>* message);
+	void SendWaiting(int channel);
+	void Update();
+	uint64_t RetransmitTimeout(int numSends);
+	void RemovePeer(UDPSocket* peer);
+	void ExpireHalfOpenPeers();
+public:
+	UDPSocket(int af_);
+	~UDPSocket();
+
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr);
+
+	bool Connect(const char* hostname, unsigned short port);
+	bool StartListening(unsigned short port, uint32_t backlog);
+	void Disconnect();
+
+	bool SendPacket(Packet& outgoing);
+	bool ReadPacket(Packet& incoming);
+	Socket* CheckPendingConnections();
+	bool Select();
+	socket_t PollHandle() { return pListener != nullptr ? INVALID_SOCKET : internalSocket; }
+
+	float GetRTT() const { return fSmoothedRTT; }
 };
 
 //
@@ -759,14 +1398,168 @@ protected:
 	Timer capTimer;
 	Cvar* capCvar;
 	Cvar* hitchWarningCvar;
+	Cvar* spinCvar;
+	uint64_t ulDeadline;		// when the current frame should end, in Timer::Nanoseconds
+
+	// How far off the target the pacer woke up, over every frame that it had to wait for
+	static uint64_t ulPacedFrames;
+	static uint64_t ulLateFrames;		// frames that were already over time, so there was nothing to pace
+	static double dErrorSum;
+	static double dErrorSquaredSum;
+	static uint64_t ulMaxError;
+
+	void WaitUntil(uint64_t ulTarget);
 public:
 	void StartFrame();
 	void EndFrame();
 	FrameCapper();
+
+	static void PrintPacingStats();
+	static void ResetPacingStats();
 };
 
 void setGameQuitting(const bool b);
 
+//
+// PerfStats.cpp
+//
+#define PERF_WINDOW		512		// number of frames that statistics are kept for
+
+enum perfPhase_e {
+	PERF_INPUT,
+	PERF_UIUPDATE,
+	PERF_COMMANDS,
+	PERF_CLEARFRAME,
+	PERF_SERVER,
+	PERF_CLIENT,
+	PERF_UIRENDER,
+	PERF_RENDERFRAME,
+	PERF_MAX
+};
+
+namespace PerfStats {
+	const char* PhaseName(perfPhase_e phase);
+	void AddPhaseTime(perfPhase_e phase, uint64_t ulNanoseconds);
+	void FrameBoundary();
+	void GetFrameStats(frameStats_t* stats);
+	bool GetLastFrame(float* fFrameTime, float fPhases[PERF_MAX]);
+	void SummarizeSamples(float* fSamples, unsigned int uNumSamples, frameStats_t& stats);
+	void Print();
+	void Reset();
+}
+
+// Times one phase of the frame for perfstats, and shows up in profile captures as well
+class PerfPhaseScope {
+	perfPhase_e phase;
+	uint64_t ulStart;
+public:
+	PerfPhaseScope(perfPhase_e _phase) : phase(_phase), ulStart(Timer::Nanoseconds()) {}
+	~PerfPhaseScope() { PerfStats::AddPhaseTime(phase, Timer::Nanoseconds() - ulStart); }
+};
+
+#define PERF_PHASE(phase)	PROFILE_ZONE(PerfStats::PhaseName(phase)); PerfPhaseScope PROFILE_CONCAT(perfPhase, __LINE__)(phase)
+
+//
+// Metrics.cpp
+//
+#define METRICS_HISTOGRAM_BUCKETS	40		// bucket i holds samples that are i bits long, so this covers up to 2^39
+#define METRICS_SNAPSHOT_FILE		"metrics.jsonl"
+
+enum metricType_e {
+	METRIC_COUNTER,		// only goes up
+	METRIC_GAUGE,		// a value that gets set or sampled
+	METRIC_HISTOGRAM,	// distribution of samples, cleared by every snapshot
+};
+
+// A named value published for monitoring. Updating one is lock-free from any thread; only registering takes a lock.
+// Metrics live until shutdown, so the pointer that registration returns can be kept around.
+struct Metric {
+	string sName;
+	metricType_e type;
+	atomic<int64_t> value;		// total for counters, current value for gauges, number of samples for histograms
+	atomic<int64_t> sum;
+	atomic<int64_t> maximum;
+	atomic<int64_t> buckets[METRICS_HISTOGRAM_BUCKETS];
+
+	Metric(const string& _sName, metricType_e _type);
+	void Add(int64_t amount) { value.fetch_add(amount, memory_order_relaxed); }
+	void Set(int64_t newValue) { value.store(newValue, memory_order_relaxed); }
+	void Record(int64_t sample);
+};
+
+typedef void(*metricSampler_t)();
+
+namespace Metrics {
+	void Init();
+	void Shutdown();
+	Metric* Counter(const string& name);
+	Metric* Gauge(const string& name);
+	Metric* Histogram(const string& name);
+	void AddSampler(metricSampler_t sampler);
+	void GetAll(vector<Metric*>& vOut);
+	void Frame();
+	void WriteSnapshot();
+	void Print();
+}
+
+//
+// Demo.cpp
+//
+#define DEMO_HEADER			"RDEM"
+#define DEMO_VERSION		1
+#define DEMO_EXTENSION		".rdem"
+#define DEMO_TEXT_SIZE		32		// same as SDL_TEXTINPUTEVENT_TEXT_SIZE
+#define DEMO_STALL_MS		1000	// a frame that blocks for longer than this gets a real clock again, so waits with a timeout still end
+
+enum demoRecord_e {
+	DEMO_RECORD_FRAME = 1,
+	DEMO_RECORD_KEYDOWN,
+	DEMO_RECORD_KEYUP,
+	DEMO_RECORD_MOUSEBUTTON,
+	DEMO_RECORD_MOUSEMOVE,
+	DEMO_RECORD_TEXTINPUT,
+	DEMO_RECORD_PACKET,
+	DEMO_RECORD_END,
+};
+
+namespace Demo {
+	void StartRecording(const char* name);
+	void StopRecording();
+	void StartTimedemo(const char* name);
+	void Shutdown();
+	void Frame();
+	void ReplayInput();
+	void ReplayPackets();
+
+	bool IsRecording();
+	bool IsPlaying();
+	Uint32 Ticks();
+
+	void RecordKey(SDL_Keysym key, char* text, bool bDown);
+	void RecordMouseButton(unsigned int buttonId, unsigned char state, int x, int y);
+	void RecordMouseMove(int x, int y);
+	void RecordTextInput(char* text);
+	void RecordPacket(Packet& packet);
+}
+
+//
+// Stress.cpp
+//
+#define STRESS_DEFAULT_STEPS	8		// steps that stress takes to ramp up to the full count (plus one with no load at all)
+#define STRESS_WARMUP_FRAMES	10		// frames that each step runs before it's measured
+#define STRESS_READY_TIMEOUT	5000	// milliseconds to wait on a font or on clients getting accepted before giving up
+#define STRESS_PACKET_SIZE		64		// payload of every packet that a stress client sends
+
+namespace Stress {
+	void Init();
+	void Shutdown();
+	void Start(const char* mode, int count, int numSteps);
+	void Stop();
+	void Frame();
+	void Run();
+	bool IsRunning();
+}
+
 //
 // CmdSystem.cpp
 //
@@ -795,6 +1588,10 @@ ptModule Sys_LoadLibrary(string name);
 void Sys_FreeLibrary(ptModule module);
 ptModuleFunction Sys_GetFunctionAddress(ptModule module, string name);
 bool Sys_Assertion(const char* msg, const char* file, const unsigned int line);
+char* Sys_ResolveAddress(void* address, char* buffer, size_t bufferSize);
+void* Sys_AlignedAlloc(size_t size, size_t alignment);
+void Sys_AlignedFree(void* memory);
+bool Sys_AdviseHugePages(void* memory, size_t size);
 void Sys_Error(const char* error, ...);
 void Sys_InitSockets();
 void Sys_ExitSockets();
@@ -6,6 +6,7 @@
 #include <Rpc.h>
 #endif
 #include <stdlib.h>
+#include <stdio.h>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -18,6 +19,7 @@
 #include <mutex>
 #include <chrono>
 #include <thread>
+#include <atomic>
 #include <dirent.h>
 #include <functional>
 #include <iomanip>
@@ -31,6 +33,13 @@ using namespace std;
 #pragma warning(error: 4190) // 'X' has C-linkage specified but returns UDT Y
 #endif
 
+// VS2013 has no snprintf, and _snprintf doesn't terminate the buffer when it truncates
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define Sys_snprintf(buffer, size, ...)	_snprintf_s(buffer, size, _TRUNCATE, __VA_ARGS__)
+#else
+#define Sys_snprintf	snprintf
+#endif
+
 #define MAX_HANDLE_STRING	64
 
 extern const string keycodeNames[];
@@ -101,6 +110,15 @@ enum packetType_e {
 	PACKET_MODCODE_START = PACKET_SENDCHAT, // Anything beyond this point is considered "modcode packets"
 };
 
+// Which guarantees a packet gets on its way to the other side.
+// Over TCP everything arrives, in order; over UDP (net_transport udp) each packet type goes on its own channel.
+enum netChannel_e {
+	CHANNEL_UNRELIABLE_SEQUENCED,	// Might not arrive; anything older than the newest one that did is thrown away (game state)
+	CHANNEL_RELIABLE_ORDERED,		// Always arrives, in the order it was sent
+	CHANNEL_RELIABLE_UNORDERED,		// Always arrives, as soon as it gets there
+	CHANNEL_MAX
+};
+
 // Packet structure
 
 // The packet header is always sent. Only packetHead.packetSize bytes of packetData gets sent across the wire.
@@ -168,6 +186,17 @@ API
 =====================================================================
 */
 
+// Rolling frame time statistics over the last few hundred frames, in milliseconds
+struct frameStats_t {
+	unsigned int numFrames;		// frames in the window
+	float fAverage;
+	float fP50;
+	float fP95;
+	float fP99;
+	float fMax;
+	unsigned int numHitches;	// frames in the window at or over com_hitch
+};
+
 // Callbacks
 typedef void(*fileOpenedCallback)(File* pFile);
 typedef void(*fileReadCallback)(File* pFile, void* buffer, size_t bufferSize);
@@ -175,6 +204,7 @@ typedef fileReadCallback fileWrittenCallback;
 typedef fileOpenedCallback fileClosedCallback;
 typedef void(*assetRequestCallback)(AssetComponent* component);
 typedef void(*fontRegisteredCallback)(const char* handleName, Font* fontFile);
+typedef void(*zoneEvictionCallback)(const char* tag, size_t bytesOverBudget);
 typedef void(__cdecl *conCmd_t)(vector<string>& args);
 
 extern "C" {
@@ -251,6 +281,7 @@ extern "C" {
 		// Network
 		void(*SendServerPacket)(packetType_e packetType, int clientNum, void* extraData);
 		void(*SendClientPacket)(packetType_e packetType, void* extraData);
+		void(*SetPacketChannel)(packetType_e packetType, netChannel_e channel);
 
 		// Cvars
 		int(*CvarIntVal)(Cvar* cvar, int* value);
@@ -261,6 +292,12 @@ extern "C" {
 		Cvar* (*RegisterCvarFloat)(const char* cvarName, const char* description, int flags, float startingValue);
 		Cvar* (*RegisterCvarBool)(const char* cvarName, const char* description, int flags, bool bStartingValue);
 		Cvar* (*RegisterCvarStr)(const char* cvarName, const char* description, int flags, char* sStartingValue);
+		const atomic<unsigned int>* CvarGeneration;	// changes whenever any cvar changes value
+
+		// Profiling (zones must be closed on the same thread, in reverse order)
+		void(*ProfileBeginZone)(const char* name);
+		void(*ProfileEndZone)();
+		void(*GetFrameStats)(frameStats_t* stats);
 
 		// Commands
 		void(*AddCommand)(const char* cmdName, conCmd_t command);
@@ -273,6 +310,9 @@ extern "C" {
 		void(*Zone_FastFree)(void* memory, const char* tag);
 		void(*Zone_FreeAll)(const char* tag);
 		void* (*Zone_Realloc)(void* memory, size_t iNewSize);
+		void* (*Zone_AllocAligned)(int iSize, const char* tag, size_t alignment);	// alignment of 0 picks one based on size
+		void(*Zone_AddEvictionCallback)(const char* tag, zoneEvictionCallback callback);
+		void(*Zone_RemoveEvictionCallback)(const char* tag, zoneEvictionCallback callback);
 
 		// Global effects
 		void(*FadeFromBlack)(int time);
@@ -90,9 +90,21 @@ private:
 
 	const int GetLineCount();
 	void SendConsoleLines(string lines);
-	static string conLines;
 	void ReplaceConsoleContents();
 
+	// Scrollback is a ring of lines so that it doesn't grow forever. Messages can come from any thread,
+	// but the web view only ever gets new text from FlushConsoleMessages on the main thread.
+	static mutex mScrollback;
+	static vector<string> vScrollback;
+	static size_t ulScrollbackHead;		// index of the oldest line
+	static size_t ulScrollbackCount;
+	static bool bLastLineOpen;			// the newest line hasn't gotten its newline yet
+	static string sPendingText;			// text the web view hasn't been sent yet
+	static size_t ulPendingLines;
+	static bool bPendingOverflow;		// more pending text than scrollback, so resend everything instead
+	static void AddScrollbackText(const string& text);
+	static string JoinScrollback();
+
 	Console(Console& other);
 	Console& operator= (Console& other);
 
@@ -111,6 +123,8 @@ public:
 	bool IsOpen() const { return bIsOpen; }
 	void BlankConsole();
 	static void PushConsoleMessage(string message);
+	static void FlushConsoleMessages();
+	static void ResizeScrollback(int lines);
 
 	static void Sizeup(vector<string>& args);
 	static void Sizedn(vector<string>& args);
@@ -1,6 +1,9 @@
 #include "../sys_local.h"
 #include <direct.h>
 #include <process.h>
+#include <DbgHelp.h>
+
+#pragma comment(lib, "dbghelp.lib")
 
 char* Sys_FS_GetHomepath() {
 	// not sure
@@ -134,6 +137,52 @@ bool Sys_Assertion(const char* msg, const char* file, const unsigned int line) {
 	}
 }
 
+// Turns a code address into file:line (function) using the debug symbols, if we have any
+char* Sys_ResolveAddress(void* address, char* buffer, size_t bufferSize) {
+	static bool bSymbolsLoaded = false;
+	HANDLE hProcess = GetCurrentProcess();
+	if (!bSymbolsLoaded) {
+		SymSetOptions(SYMOPT_LOAD_LINES | SYMOPT_DEFERRED_LOADS | SYMOPT_UNDNAME);
+		bSymbolsLoaded = SymInitialize(hProcess, nullptr, TRUE) == TRUE;
+	}
+
+	char symbolBuffer[sizeof(SYMBOL_INFO) + MAX_SYM_NAME];
+	SYMBOL_INFO* pSymbol = (SYMBOL_INFO*)symbolBuffer;
+	pSymbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+	pSymbol->MaxNameLen = MAX_SYM_NAME;
+
+	DWORD64 displacement = 0;
+	DWORD lineDisplacement = 0;
+	IMAGEHLP_LINE64 line;
+	line.SizeOfStruct = sizeof(line);
+
+	if (!bSymbolsLoaded || !SymFromAddr(hProcess, (DWORD64)address, &displacement, pSymbol)) {
+		_snprintf(buffer, bufferSize, "0x%p", address);
+	}
+	else if (SymGetLineFromAddr64(hProcess, (DWORD64)address, &lineDisplacement, &line)) {
+		const char* szFile = strrchr(line.FileName, '\\');
+		_snprintf(buffer, bufferSize, "%s:%u (%s)", szFile ? szFile + 1 : line.FileName, line.LineNumber, pSymbol->Name);
+	}
+	else {
+		_snprintf(buffer, bufferSize, "%s+0x%X", pSymbol->Name, (unsigned int)displacement);
+	}
+	buffer[bufferSize - 1] = '\0';
+	return buffer;
+}
+
+void* Sys_AlignedAlloc(size_t size, size_t alignment) {
+	return _aligned_malloc(size, alignment);
+}
+
+void Sys_AlignedFree(void* memory) {
+	_aligned_free(memory);
+}
+
+// Windows has no transparent huge pages. Large pages need SeLockMemoryPrivilege and VirtualAlloc, so we don't bother.
+bool Sys_AdviseHugePages(void* memory, size_t size) {
+	return false;
+}
+
 void Sys_Error(const char* error, ...) {
 	va_list		argptr;
 	char		text[4096];
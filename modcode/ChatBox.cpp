@@ -3,6 +3,8 @@
 
 Chatbox::Chatbox() {
 	cm_chatduration = trap->RegisterCvarInt("cm_chatduration", "Amount of time that chat should remain onscreen (MS)", (1 << CVAR_ARCHIVE), 20000);
+	trap->CvarIntVal(cm_chatduration, &iChatDuration);
+	uCvarGeneration = trap->CvarGeneration->load();
 
 	trap->AddCommand("chat", ChatCommand);
 }
@@ -13,13 +15,16 @@ Chatbox::~Chatbox() {
 
 void Chatbox::Display() {
 	uint64_t currentTicks = trap->GetTicks();
-	int duration;
 
 	const int chatX = 10;
 	int chatY = 200;
 	Font* segoeFont = ClientFont::RetrieveFont(ClientFont::FONT_CONSOLAS);
 
-	trap->CvarIntVal(cm_chatduration, &duration);
+	unsigned int generation = trap->CvarGeneration->load();
+	if (generation != uCvarGeneration) {
+		trap->CvarIntVal(cm_chatduration, &iChatDuration);
+		uCvarGeneration = generation;
+	}
 
 	for (auto it = vCurrentChatMessages.begin(); it != vCurrentChatMessages.end(); ) {
 		// Display the chat message onscreen.
@@ -28,7 +33,7 @@ void Chatbox::Display() {
 
 		// Determine whether the chat message should be removed
 		uint64_t difference = currentTicks - it->uTicks;
-		if (difference > duration) {
+		if (difference > iChatDuration) {
 			it = vCurrentChatMessages.erase(it);
 		}
 		else {
@@ -6,6 +6,8 @@ private:
 	vector<ChatMessage> vCurrentChatMessages;
 	
 	Cvar* cm_chatduration;
+	unsigned int uCvarGeneration;
+	int iChatDuration;
 public:
 	Chatbox();
 	~Chatbox();
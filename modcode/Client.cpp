@@ -65,6 +65,7 @@ namespace Client {
 
 	/* Code that gets run every frame */
 	void Frame() {
+		MODCODE_ZONE("ClientDisplay::DrawDisplay");
 		ClientDisplay::DrawDisplay();
 	}
 
@@ -8,15 +8,22 @@ namespace ClientDisplay {
 	static Cvar* cm_drawft = nullptr;
 	static Cvar* cm_drawchat = nullptr;
 
-	static Chatbox* chat = nullptr;
+	// Cached cvar values, only refreshed when the engine says that some cvar has changed
+	static unsigned int uCvarGeneration = 0;
+	static bool bDrawFPS = false, bDrawFrameTime = false, bDrawChat = false;
 
-	static uint64_t lastTicks = 0;
+	static Chatbox* chat = nullptr;
 
 	void Initialize() {
 		cm_drawfps = trap->RegisterCvarBool("cm_drawfps", "Draw FPS (frames per second).", (1 << CVAR_ARCHIVE), false);
 		cm_drawft = trap->RegisterCvarBool("cm_drawft", "Draw FT (frame time, milliseconds).", (1 << CVAR_ARCHIVE), false);
 		cm_drawchat = trap->RegisterCvarBool("cm_drawchat", "Draw chatbox.", (1 << CVAR_ARCHIVE), true);
 
+		trap->CvarBoolVal(cm_drawfps, &bDrawFPS);
+		trap->CvarBoolVal(cm_drawft, &bDrawFrameTime);
+		trap->CvarBoolVal(cm_drawchat, &bDrawChat);
+		uCvarGeneration = trap->CvarGeneration->load();
+
 		chat = new Chatbox();
 	}
 
@@ -25,32 +32,36 @@ namespace ClientDisplay {
 	}
 
 	void DrawDisplay() {
-		bool bDrawFPS, bDrawFrameTime, bDrawChat;
-		uint64_t currentTicks = trap->GetTicks();
-
-		trap->CvarBoolVal(cm_drawfps, &bDrawFPS);
-		trap->CvarBoolVal(cm_drawft, &bDrawFrameTime);
-		trap->CvarBoolVal(cm_drawchat, &bDrawChat);
+		unsigned int generation = trap->CvarGeneration->load();
+		if (generation != uCvarGeneration) {
+			trap->CvarBoolVal(cm_drawfps, &bDrawFPS);
+			trap->CvarBoolVal(cm_drawft, &bDrawFrameTime);
+			trap->CvarBoolVal(cm_drawchat, &bDrawChat);
+			uCvarGeneration = generation;
+		}
 
 		Font* consolasFont = ClientFont::RetrieveFont(ClientFont::FONT_CONSOLAS);
 
-		if (bDrawFPS) {
-			float fps = 1000.0f / (currentTicks - lastTicks);
+		// Averaged over the engine's frame window instead of just the last frame
+		frameStats_t stats;
+		if (bDrawFPS || bDrawFrameTime) {
+			trap->GetFrameStats(&stats);
+		}
+
+		if (bDrawFPS && stats.numFrames > 0) {
+			float fps = 1000.0f / stats.fAverage;
 			char fpsBuffer[32] {0};
 			sprintf(fpsBuffer, "FPS: %.2f", fps);
 			trap->RenderShadedText(consolasFont, fpsBuffer, 0, 0, 0, 0, 0, 255, 255, 255);
 		}
-		if (bDrawFrameTime) {
-			int frametime = currentTicks - lastTicks;
-			char ftBuffer[32]{0};
-			sprintf(ftBuffer, "Frametime: %i ms", frametime);
+		if (bDrawFrameTime && stats.numFrames > 0) {
+			char ftBuffer[96]{0};
+			sprintf(ftBuffer, "Frametime: %.2f ms (p99 %.2f, max %.2f, %u hitches)", stats.fAverage, stats.fP99, stats.fMax, stats.numHitches);
 			trap->RenderShadedText(consolasFont, ftBuffer, 100, 0, 0, 0, 0, 255, 255, 255);
 		}
 		if (bDrawChat) {
 			chat->Display();
 		}
-
-		lastTicks = currentTicks;
 	}
 
 	void ReceivedChatMessage(int clientNum, const char* message) {
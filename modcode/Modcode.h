@@ -3,4 +3,14 @@
 
 extern gameImports_s* trap;
 
+// Times the enclosing block in the engine profiler
+class ModcodeProfileZone {
+public:
+	ModcodeProfileZone(const char* name) { trap->ProfileBeginZone(name); }
+	~ModcodeProfileZone() { trap->ProfileEndZone(); }
+};
+#define MODCODE_ZONE_CONCAT_(a, b)	a##b
+#define MODCODE_ZONE_CONCAT(a, b)	MODCODE_ZONE_CONCAT_(a, b)
+#define MODCODE_ZONE(name)			ModcodeProfileZone MODCODE_ZONE_CONCAT(modcodeZone, __LINE__)(name)
+
 #define CHAT_MAXLEN	140
\ No newline at end of file
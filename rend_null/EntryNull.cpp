@@ -0,0 +1,198 @@
+#include "tr_local.h"
+
+renderImports_s *trap = nullptr;
+
+enum nullCounter_e {
+	NULL_FRAMES,
+	NULL_MATERIALS,
+	NULL_MATERIALDRAWS,
+	NULL_TEXTURES,
+	NULL_TEXTURELOCKS,
+	NULL_TEXTUREBLENDS,
+	NULL_FONTS,
+	NULL_TEXTDRAWS,
+	NULL_SCREENSHOTS,
+	NULL_MAX
+};
+
+static const char* counterNames[NULL_MAX] = {
+	"frames",
+	"materials registered",
+	"material draws",
+	"textures registered",
+	"texture locks",
+	"texture blends",
+	"fonts registered",
+	"text draws",
+	"screenshots",
+};
+
+static unsigned int counters[NULL_MAX];
+static unordered_map<string, Material*> umMaterials;
+
+// Render Exports
+void RenderExport::Initialize() {
+	trap->Print(PRIORITY_NOTE, "Render Init : Null\n");
+	memset(counters, 0, sizeof(counters));
+}
+
+void RenderExport::Shutdown() {
+	trap->Print(PRIORITY_MESSAGE, "Null renderer totals:\n");
+	for (int i = 0; i < NULL_MAX; i++) {
+		trap->Print(PRIORITY_MESSAGE, "%-24s %u\n", counterNames[i], counters[i]);
+	}
+	for (auto it = umMaterials.begin(); it != umMaterials.end(); ++it) {
+		delete it->second;
+	}
+	umMaterials.clear();
+}
+
+void RenderExport::Restart() {
+}
+
+void RenderExport::ClearFrame() {
+}
+
+void RenderExport::DrawActiveFrame() {
+	counters[NULL_FRAMES]++;
+}
+
+void RenderExport::QueueScreenshot(const char* szFileName, const char* szExtension) {
+	counters[NULL_SCREENSHOTS]++;
+}
+
+void RenderExport::FadeFromBlack(int ms) {
+}
+
+void RenderExport::WindowWidthChanged(int newWidth) {
+}
+
+void RenderExport::WindowHeightChanged(int newHeight) {
+}
+
+// Materials
+static Material* RegisterMaterial(const char* URI) {
+	auto it = umMaterials.find(URI);
+	if (it != umMaterials.end()) {
+		return it->second;
+	}
+	Material* ptMaterial = new Material();
+	ptMaterial->sName = URI;
+	umMaterials[URI] = ptMaterial;
+	counters[NULL_MATERIALS]++;
+	return ptMaterial;
+}
+
+static void DrawMaterial(Material* ptMaterial, float xPct, float yPct, float wPct, float hPct) {
+	counters[NULL_MATERIALDRAWS]++;
+}
+
+static void DrawMaterialClipped(Material* ptMaterial, float sxPct, float syPct, float swPct, float shPct, float ixPct, float iyPct, float iwPct, float ihPct) {
+	counters[NULL_MATERIALDRAWS]++;
+}
+
+static void DrawMaterialAbs(Material* ptMaterial, int nX, int nY, int nW, int nH) {
+	counters[NULL_MATERIALDRAWS]++;
+}
+
+static void DrawMaterialAbsClipped(Material* ptMaterial, int sX, int sY, int sW, int sH, int iX, int iY, int iW, int iH) {
+	counters[NULL_MATERIALDRAWS]++;
+}
+
+// Streaming textures
+static Texture* RegisterStreamingTexture(unsigned int nWidth, unsigned int nHeight) {
+	Texture* ptTexture = new Texture();
+	ptTexture->nWidth = nWidth;
+	ptTexture->nHeight = nHeight;
+	counters[NULL_TEXTURES]++;
+	return ptTexture;
+}
+
+static int LockStreamingTexture(Texture* ptTexture, unsigned int nX, unsigned int nY, unsigned int nW, unsigned int nH, void** pixels, int* pitch) {
+	if (ptTexture == nullptr || pixels == nullptr || pitch == nullptr) {
+		return -1;
+	}
+	// Only allocated the first time it gets locked, most of them never are
+	if (ptTexture->vPixels.empty()) {
+		ptTexture->vPixels.resize(ptTexture->nWidth * ptTexture->nHeight * 4 + 4);
+	}
+	*pixels = &ptTexture->vPixels[0];
+	*pitch = ptTexture->nWidth * 4;
+	counters[NULL_TEXTURELOCKS]++;
+	return 0;
+}
+
+static void UnlockStreamingTexture(Texture* ptTexture) {
+}
+
+static void DeleteStreamingTexture(Texture* ptTexture) {
+	delete ptTexture;
+}
+
+static void BlendTexture(Texture* ptTexture) {
+	counters[NULL_TEXTUREBLENDS]++;
+}
+
+// Text. Fonts are "registered" right away; the callback gets the component name, like the real renderers do.
+static void RegisterFontAsync(const char* szResourceURI, fontRegisteredCallback callback) {
+	static char dummyFont;
+	const char* szComponent = strchr(szResourceURI, '/');
+	counters[NULL_FONTS]++;
+	if (callback) {
+		callback(szComponent ? szComponent + 1 : szResourceURI, (Font*)&dummyFont);
+	}
+}
+
+static void RenderSolidText(Font* font, const char* text, int x, int y, int r, int g, int b) {
+	counters[NULL_TEXTDRAWS]++;
+}
+
+static void RenderShadedText(Font* font, const char* text, int x, int y, int br, int bg, int bb, int fr, int fg, int fb) {
+	counters[NULL_TEXTDRAWS]++;
+}
+
+static void RenderBlendedText(Font* font, const char* text, int x, int y, int r, int g, int b) {
+	counters[NULL_TEXTDRAWS]++;
+}
+
+// Main entrypoint of the program
+static renderExports_s renderExport;
+extern "C" {
+	__declspec(dllexport) renderExports_s* GetRefAPI(renderImports_s* import) {
+		trap = import;
+
+		renderExport.Initialize = RenderExport::Initialize;
+		renderExport.Shutdown = RenderExport::Shutdown;
+		renderExport.Restart = RenderExport::Restart;
+
+		renderExport.WindowWidthChanged = RenderExport::WindowWidthChanged;
+		renderExport.WindowHeightChanged = RenderExport::WindowHeightChanged;
+
+		renderExport.ClearFrame = RenderExport::ClearFrame;
+		renderExport.DrawActiveFrame = RenderExport::DrawActiveFrame;
+
+		renderExport.RegisterMaterial = RegisterMaterial;
+		renderExport.DrawMaterial = DrawMaterial;
+		renderExport.DrawMaterialAspectCorrection = DrawMaterial;
+		renderExport.DrawMaterialClipped = DrawMaterialClipped;
+		renderExport.DrawMaterialAbs = DrawMaterialAbs;
+		renderExport.DrawMaterialAbsClipped = DrawMaterialAbsClipped;
+
+		renderExport.RegisterStreamingTexture = RegisterStreamingTexture;
+		renderExport.LockStreamingTexture = LockStreamingTexture;
+		renderExport.UnlockStreamingTexture = UnlockStreamingTexture;
+		renderExport.DeleteStreamingTexture = DeleteStreamingTexture;
+		renderExport.BlendTexture = BlendTexture;
+
+		renderExport.RegisterFontAsync = RegisterFontAsync;
+		renderExport.RenderSolidText = RenderSolidText;
+		renderExport.RenderShadedText = RenderShadedText;
+		renderExport.RenderBlendedText = RenderBlendedText;
+
+		renderExport.QueueScreenshot = RenderExport::QueueScreenshot;
+
+		renderExport.FadeFromBlack = RenderExport::FadeFromBlack;
+
+		return &renderExport;
+	}
+}
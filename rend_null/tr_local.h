@@ -0,0 +1,35 @@
+#pragma once
+#include "../game/tr_shared.h"
+
+extern renderImports_s* trap;
+
+// Renderer that draws nothing. Used for headless runs (-headless), where there is no window or GPU.
+// Every export is a no-op that counts how many times it was called, so that benchmarks can still see how much
+// rendering work the engine and modcode asked for.
+
+class Material {
+public:
+	string sName;
+};
+
+class Texture {
+public:
+	unsigned int nWidth;
+	unsigned int nHeight;
+	vector<unsigned char> vPixels;	// so that locking a streaming texture still gives out valid memory
+};
+
+namespace RenderExport {
+	void Initialize();
+	void Shutdown();
+	void Restart();
+
+	void ClearFrame();
+	void DrawActiveFrame();
+
+	void QueueScreenshot(const char* szFileName, const char* szExtension);
+	void FadeFromBlack(int ms);
+
+	void WindowWidthChanged(int newWidth);
+	void WindowHeightChanged(int newHeight);
+}
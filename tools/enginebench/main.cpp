@@ -0,0 +1,399 @@
+#include "sys_local.h"
+#include <new>
+#include <sstream>
+#define RASS_PayloadAlloc(size)	Filesystem::AllocPayload(size)	// must match FileSystem.cpp
+#include <SerializedRaptureAsset.h>
+#include <cereal/archives/binary.hpp>
+#include "json/cJSON.h"
+
+// enginebench: times the hot paths of the engine core in isolation and reports the results as JSON.
+// usage: enginebench [-time <ms>] [-levels <directory>] [-o <output.json>]
+//
+// Every benchmark is run in doubling batches until one batch takes at least -time milliseconds (default 250),
+// and that batch is the one that gets reported.
+// bytes_per_op is every byte requested per operation from operator new, malloc through cJSON, the zone and asset payloads.
+// It doesn't subtract anything that was freed, so it measures allocator traffic rather than growth.
+
+#define BENCH_DEFAULT_TIME		250
+#define BENCH_MAX_ITERATIONS	(1 << 26)
+#define BENCH_PORT				27962
+#define BENCH_PACKET_SIZE		256
+#define BENCH_ZONE_SLOTS		64
+#define BENCH_ASSET_COMPONENTS	8
+#define BENCH_ASSET_DATASIZE	16384
+
+extern unordered_map<string, AssetComponent*> m_assetComponents;
+
+static atomic<uint64_t> ulAllocatedBytes(0);
+
+void* operator new(size_t size) {
+	ulAllocatedBytes += size;
+	void* memory = malloc(size ? size : 1);
+	if (memory == nullptr) {
+		throw bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new[](size_t size) {
+	ulAllocatedBytes += size;
+	void* memory = malloc(size ? size : 1);
+	if (memory == nullptr) {
+		throw bad_alloc();
+	}
+	return memory;
+}
+
+void operator delete(void* memory) {
+	free(memory);
+}
+
+void operator delete[](void* memory) {
+	free(memory);
+}
+
+static void* CountingMalloc(size_t size) {
+	ulAllocatedBytes += size;
+	return malloc(size);
+}
+
+static void* CountingRealloc(void* memory, size_t size) {
+	ulAllocatedBytes += size;
+	return realloc(memory, size);
+}
+
+struct benchResult_t {
+	string sName;
+	uint64_t ulIterations;
+	double dNsPerOp;
+	double dBytesPerOp;
+};
+
+typedef void(*benchFunc_t)(uint64_t iterations, void* pData);
+
+static vector<benchResult_t> vResults;
+static uint64_t ulMinTime = BENCH_DEFAULT_TIME * 1000000ULL;
+
+static void RunBenchmark(const string& sName, benchFunc_t func, void* pData) {
+	func(1, pData);	// warm up caches and any lazily created state
+
+	uint64_t ulIterations = 1;
+	uint64_t ulElapsed = 0;
+	uint64_t ulBytes = 0;
+	while (true) {
+		ulAllocatedBytes = 0;
+		uint64_t ulStart = Timer::Nanoseconds();
+		func(ulIterations, pData);
+		ulElapsed = Timer::Nanoseconds() - ulStart;
+		ulBytes = ulAllocatedBytes;
+		if (ulElapsed >= ulMinTime || ulIterations >= BENCH_MAX_ITERATIONS) {
+			break;
+		}
+		ulIterations *= 2;
+	}
+
+	benchResult_t result;
+	result.sName = sName;
+	result.ulIterations = ulIterations;
+	result.dNsPerOp = (double)ulElapsed / ulIterations;
+	result.dBytesPerOp = (double)ulBytes / ulIterations;
+	vResults.push_back(result);
+	fprintf(stderr, "%-40s %12.1f ns/op %12.1f bytes/op\n", sName.c_str(), result.dNsPerOp, result.dBytesPerOp);
+}
+
+/* Zone */
+
+// A rolling window of live blocks, so that frees land out of order like they do in the game
+static void Bench_ZoneAllocFree(uint64_t iterations, void* pData) {
+	static const int sizes[] = { 16, 48, 128, 24, 512, 64, 4096, 32 };
+	void* slots[BENCH_ZONE_SLOTS] = { nullptr };
+	for (uint64_t i = 0; i < iterations; i++) {
+		int slot = (i * 7) % BENCH_ZONE_SLOTS;
+		if (slots[slot] != nullptr) {
+			Zone::FastFree(slots[slot], "bench");
+		}
+		int size = sizes[i % (sizeof(sizes) / sizeof(sizes[0]))];
+		ulAllocatedBytes += size;
+		slots[slot] = Zone::Alloc(size, "bench");
+	}
+	for (int i = 0; i < BENCH_ZONE_SLOTS; i++) {
+		if (slots[i] != nullptr) {
+			Zone::FastFree(slots[i], "bench");
+		}
+	}
+}
+
+/* Cvars */
+
+static void Bench_CvarGetSet(uint64_t iterations, void* pData) {
+	int total = 0;
+	for (uint64_t i = 0; i < iterations; i++) {
+		CvarSystem::SetIntegerValue("bench_value", (int)i);
+		total += CvarSystem::GetIntegerValue("bench_value");
+	}
+	if (total == -1) {
+		fprintf(stderr, "\n");	// keep the loop from being optimized out
+	}
+}
+
+/* Commands */
+
+static void Bench_CmdTokenize(uint64_t iterations, void* pData) {
+	static CmdArgs args;
+	const char* szLine = "bind mouse1 \"+attack; wait; echo \\\"fire\\\"\" // trailing comment";
+	size_t total = 0;
+	for (uint64_t i = 0; i < iterations; i++) {
+		Cmd::Tokenize(szLine, args);
+		total += args.size();
+	}
+	if (total == 0) {
+		fprintf(stderr, "\n");
+	}
+}
+
+/* Resources */
+
+// Only the lookup is being measured, so the component is put straight into the table instead of coming from disk
+static void Bench_ResourceLookup(uint64_t iterations, void* pData) {
+	for (uint64_t i = 0; i < iterations; i++) {
+		Resource* pRes = Resource::ResourceSyncURI("asset://bench/data");
+		Resource::FreeResource(pRes);
+	}
+}
+
+/* Sockets */
+
+struct socketPair_t {
+	Socket* ptListener;
+	Socket* ptClient;
+	Socket* ptServer;
+};
+
+static void Bench_SocketLoopback(uint64_t iterations, void* pData) {
+	socketPair_t* pPair = (socketPair_t*)pData;
+	static Packet outgoing;
+	static Packet incoming;
+	outgoing.packetHead.type = PACKET_PING;
+	outgoing.packetHead.packetSize = BENCH_PACKET_SIZE;
+	for (uint64_t i = 0; i < iterations; i++) {
+		outgoing.packetHead.sendTime = i;
+		pPair->ptClient->SendPacket(outgoing);
+		pPair->ptServer->ReadPacket(incoming);
+	}
+}
+
+/* Assets */
+
+static void FreeComponent(AssetComponent& component) {
+	if (component.meta.componentType == Asset_Data) {
+		if (component.data.dataComponent->data) {
+			Filesystem::FreePayload(component.data.dataComponent->data);
+		}
+		free(component.data.dataComponent);
+	}
+}
+
+// Writes an asset with a few data components to memory, in the same format that assettool writes to disk
+static string BuildSyntheticAsset() {
+	RaptureAsset asset;
+	memset(&asset.head, 0, sizeof(asset.head));
+	memcpy(asset.head.header, "RASS", 4);
+	asset.head.version = RASS_VERSION;
+	strcpy(asset.head.assetName, "bench");
+	asset.head.compressionType = Compression_None;
+	asset.head.numberComponents = BENCH_ASSET_COMPONENTS;
+
+	ostringstream stream;
+	{
+		cereal::BinaryOutputArchive out(stream);
+		out << asset.head;
+
+		ComponentData data;
+		memset(&data.head, 0, sizeof(data.head));
+		strcpy(data.head.mime, "application/octet-stream");
+		vector<char> vBytes(BENCH_ASSET_DATASIZE);
+		for (size_t i = 0; i < vBytes.size(); i++) {
+			vBytes[i] = (char)(i * 31);
+		}
+		data.data = &vBytes[0];
+
+		for (int i = 0; i < BENCH_ASSET_COMPONENTS; i++) {
+			AssetComponent component;
+			memset(&component.meta, 0, sizeof(component.meta));
+			Sys_snprintf(component.meta.componentName, sizeof(component.meta.componentName), "data%i", i);
+			component.meta.componentType = Asset_Data;
+			component.meta.decompressedSize = BENCH_ASSET_DATASIZE;
+			component.data.dataComponent = &data;
+			out << component;
+		}
+	}
+	return stream.str();
+}
+
+// Same steps as Filesystem::LoadRaptureAsset, minus the file
+static void Bench_AssetLoad(uint64_t iterations, void* pData) {
+	const string& sAsset = *(string*)pData;
+	AssetComponent components[BENCH_ASSET_COMPONENTS];
+	istringstream stream(sAsset);
+	for (uint64_t i = 0; i < iterations; i++) {
+		stream.clear();
+		stream.seekg(0);
+		cereal::BinaryInputArchive in(stream);
+		AssetHeader head;
+		in >> head;
+		for (int j = 0; j < head.numberComponents && j < BENCH_ASSET_COMPONENTS; j++) {
+			in >> components[j];
+			ulAllocatedBytes += sizeof(ComponentData) + components[j].meta.decompressedSize;
+		}
+		for (int j = 0; j < head.numberComponents && j < BENCH_ASSET_COMPONENTS; j++) {
+			FreeComponent(components[j]);
+		}
+	}
+}
+
+/* JSON */
+
+static void Bench_ParseLevel(uint64_t iterations, void* pData) {
+	const string& sText = *(string*)pData;
+	char error[1024];
+	for (uint64_t i = 0; i < iterations; i++) {
+		cJSON* root = cJSON_ParsePooled(sText.c_str(), error, sizeof(error));
+		if (root == nullptr) {
+			fprintf(stderr, "parse error: %s\n", error);
+			return;
+		}
+		cJSON_Delete(root);
+	}
+}
+
+static bool ReadWholeFile(const string& sPath, string& sOut) {
+	FILE* fp = fopen(sPath.c_str(), "rb");
+	if (fp == nullptr) {
+		return false;
+	}
+	fseek(fp, 0, SEEK_END);
+	long length = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	sOut.resize(length);
+	bool bRead = length == 0 || fread(&sOut[0], 1, length, fp) == (size_t)length;
+	fclose(fp);
+	return bRead;
+}
+
+static void AppendEscaped(string& out, const char* text) {
+	for (const char* p = text; *p; p++) {
+		if (*p == '"' || *p == '\\') {
+			out += '\\';
+		}
+		out += *p;
+	}
+}
+
+static bool WriteResults(const char* szOutput) {
+	string out = "{\"benchmarks\":[\n";
+	char buffer[256];
+	for (auto it = vResults.begin(); it != vResults.end(); ++it) {
+		out += "{\"name\":\"";
+		AppendEscaped(out, it->sName.c_str());
+		Sys_snprintf(buffer, sizeof(buffer), "\",\"iterations\":%llu,\"ns_per_op\":%.2f,\"bytes_per_op\":%.2f}%s\n",
+			(unsigned long long)it->ulIterations, it->dNsPerOp, it->dBytesPerOp, it + 1 != vResults.end() ? "," : "");
+		out += buffer;
+	}
+	out += "]}\n";
+
+	FILE* fp = szOutput ? fopen(szOutput, "wb") : stdout;
+	if (fp == nullptr) {
+		fprintf(stderr, "could not open %s for writing\n", szOutput);
+		return false;
+	}
+	fwrite(out.c_str(), 1, out.length(), fp);
+	if (fp != stdout) {
+		fclose(fp);
+	}
+	return true;
+}
+
+int main(int argc, char** argv) {
+	const char* szOutput = nullptr;
+	string sLevelDir = "core/levels";
+	for (int i = 1; i < argc; i++) {
+		if (!stricmp(argv[i], "-time") && i + 1 < argc) {
+			ulMinTime = strtoull(argv[++i], nullptr, 10) * 1000000ULL;
+		}
+		else if (!stricmp(argv[i], "-levels") && i + 1 < argc) {
+			sLevelDir = argv[++i];
+		}
+		else if (!stricmp(argv[i], "-o") && i + 1 < argc) {
+			szOutput = argv[++i];
+		}
+		else {
+			fprintf(stderr, "usage: enginebench [-time <ms>] [-levels <directory>] [-o <output.json>]\n");
+			return 1;
+		}
+	}
+
+	// Just enough of the engine to run the subsystems; anything below an error would only add noise to the timings
+	ptDispatch = new Dispatch((1 << PRIORITY_NOTE) | (1 << PRIORITY_DEBUG) | (1 << PRIORITY_MESSAGE) | (1 << PRIORITY_WARNING), 0, 0);
+	Zone::Init();
+	CvarSystem::Initialize();
+	Zone::NewTag("bench");
+	Sys_InitSockets();
+
+	cJSON_Hooks hooks = { CountingMalloc, CountingRealloc, free };
+	cJSON_InitHooks(&hooks);
+
+	RunBenchmark("zone_alloc_free", Bench_ZoneAllocFree, nullptr);
+
+	CvarSystem::RegisterCvar("bench_value", "Written and read back by enginebench.", 0, 0);
+	RunBenchmark("cvar_set_get_by_name", Bench_CvarGetSet, nullptr);
+
+	RunBenchmark("cmd_tokenize", Bench_CmdTokenize, nullptr);
+
+	AssetComponent lookupComponent;
+	memset(&lookupComponent, 0, sizeof(lookupComponent));
+	m_assetComponents["bench/data"] = &lookupComponent;
+	RunBenchmark("resource_uri_lookup", Bench_ResourceLookup, nullptr);
+	m_assetComponents.erase("bench/data");
+
+	socketPair_t pair = { nullptr, nullptr, nullptr };
+	pair.ptListener = new TCPSocket(AF_INET);
+	pair.ptClient = new TCPSocket(AF_INET);
+	if (pair.ptListener->StartListening(BENCH_PORT, 1) && pair.ptClient->Connect("127.0.0.1", BENCH_PORT)) {
+		for (int i = 0; i < 100 && pair.ptServer == nullptr; i++) {
+			pair.ptServer = pair.ptListener->CheckPendingConnections();
+			if (pair.ptServer == nullptr) {
+				this_thread::sleep_for(chrono::milliseconds(10));
+			}
+		}
+	}
+	if (pair.ptServer != nullptr) {
+		RunBenchmark("socket_packet_loopback", Bench_SocketLoopback, &pair);
+		delete pair.ptServer;
+	}
+	else {
+		fprintf(stderr, "could not open a loopback connection on port %i, skipping socket_packet_loopback\n", BENCH_PORT);
+	}
+	delete pair.ptClient;
+	delete pair.ptListener;
+
+	string sAsset = BuildSyntheticAsset();
+	RunBenchmark("rass_load_synthetic", Bench_AssetLoad, &sAsset);
+
+	const char* levelFiles[] = { "Levels.json", "LevelMaze.json", "LevelWarp.json" };
+	for (size_t i = 0; i < sizeof(levelFiles) / sizeof(levelFiles[0]); i++) {
+		string sText;
+		if (!ReadWholeFile(sLevelDir + "/" + levelFiles[i], sText)) {
+			fprintf(stderr, "could not read %s/%s, skipping\n", sLevelDir.c_str(), levelFiles[i]);
+			continue;
+		}
+		RunBenchmark(string("cjson_parse_pooled/") + levelFiles[i], Bench_ParseLevel, &sText);
+	}
+
+	cJSON_InitHooks(nullptr);
+	Sys_ExitSockets();
+	CvarSystem::Destroy();
+	delete ptDispatch;
+	Zone::Shutdown();
+
+	return WriteResults(szOutput) ? 0 : 1;
+}
@@ -0,0 +1,231 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include "../../common/BinaryLog.h"
+
+using namespace std;
+
+// VS2013 has no snprintf, and _snprintf doesn't terminate the buffer when it truncates
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define snprintf(buffer, size, ...)	_snprintf_s(buffer, size, _TRUNCATE, __VA_ARGS__)
+#endif
+
+// logdecode: turns a binary log (written with com_binarylog 1) back into the same text that a normal log contains.
+// usage: logdecode <rapturelog.rblg> [output.log]
+
+// Must match dispatchPriorities_e in sys_shared.h
+static const char* priorityTags[] = {
+	"[NOTE]\t\t",		// PRIORITY_NONE
+	"[NOTE]\t\t",
+	"[DEBUG]\t\t",
+	"[MESSAGE]\t",
+	"[WARNING]\t",
+	"[ERROR]\t",
+	"[FATAL]\t\t",
+};
+
+struct argReader_t {
+	const unsigned char* data;
+	size_t size;
+	size_t offset;
+
+	bool ReadInt(int64_t& value) {
+		if (offset + sizeof(value) > size) return false;
+		memcpy(&value, data + offset, sizeof(value));
+		offset += sizeof(value);
+		return true;
+	}
+	bool ReadDouble(double& value) {
+		if (offset + sizeof(value) > size) return false;
+		memcpy(&value, data + offset, sizeof(value));
+		offset += sizeof(value);
+		return true;
+	}
+	bool ReadString(string& value) {
+		uint16_t length;
+		if (offset + sizeof(length) > size) return false;
+		memcpy(&length, data + offset, sizeof(length));
+		offset += sizeof(length);
+		if (offset + length > size) return false;
+		value.assign((const char*)data + offset, length);
+		offset += length;
+		return true;
+	}
+};
+
+// Formats one message by walking the format string and feeding each specifier its stored argument
+static string formatmessage(const string& format, argReader_t& args) {
+	string out;
+	char buffer[2048];
+	const char* p = format.c_str();
+	const char* literal = p;
+	binaryLogSpec_t spec;
+	while (BinaryLog_NextSpec(p, spec)) {
+		// Text before the specifier (turn %% back into %)
+		for (const char* c = literal; c < spec.start; c++) {
+			out += *c;
+			if (*c == '%' && c + 1 < spec.start && c[1] == '%') c++;
+		}
+		literal = p;
+
+		string specifier(spec.start, spec.length);
+		bool bOk = true;
+		int64_t stars[2] = { 0, 0 };
+		for (int i = 0; i < spec.numStarArgs && i < 2; i++) {
+			bOk = bOk && args.ReadInt(stars[i]);
+		}
+		if (!bOk) {
+			out += specifier;
+			continue;
+		}
+
+		buffer[0] = '\0';
+		switch (spec.argType) {
+			case BLOG_ARG_INT:
+			case BLOG_ARG_LONGLONG:
+			case BLOG_ARG_POINTER:
+				{
+					int64_t value;
+					if (!args.ReadInt(value)) { bOk = false; break; }
+					if (spec.argType == BLOG_ARG_POINTER) {
+						snprintf(buffer, sizeof(buffer), "0x%llx", (unsigned long long)value);
+					}
+					else if (spec.argType == BLOG_ARG_LONGLONG) {
+						// Swap whatever 64-bit length modifier was used for ll so that it works here
+						string fixed = specifier.substr(0, specifier.find_first_of("Ijlzt")) + "ll" + specifier.substr(specifier.length() - 1);
+						if (spec.numStarArgs == 0) snprintf(buffer, sizeof(buffer), fixed.c_str(), (long long)value);
+						else if (spec.numStarArgs == 1) snprintf(buffer, sizeof(buffer), fixed.c_str(), (int)stars[0], (long long)value);
+						else snprintf(buffer, sizeof(buffer), fixed.c_str(), (int)stars[0], (int)stars[1], (long long)value);
+					}
+					else {
+						if (spec.numStarArgs == 0) snprintf(buffer, sizeof(buffer), specifier.c_str(), (int)value);
+						else if (spec.numStarArgs == 1) snprintf(buffer, sizeof(buffer), specifier.c_str(), (int)stars[0], (int)value);
+						else snprintf(buffer, sizeof(buffer), specifier.c_str(), (int)stars[0], (int)stars[1], (int)value);
+					}
+				}
+				break;
+			case BLOG_ARG_DOUBLE:
+				{
+					double value;
+					if (!args.ReadDouble(value)) { bOk = false; break; }
+					if (spec.numStarArgs == 0) snprintf(buffer, sizeof(buffer), specifier.c_str(), value);
+					else if (spec.numStarArgs == 1) snprintf(buffer, sizeof(buffer), specifier.c_str(), (int)stars[0], value);
+					else snprintf(buffer, sizeof(buffer), specifier.c_str(), (int)stars[0], (int)stars[1], value);
+				}
+				break;
+			case BLOG_ARG_STRING:
+				{
+					string value;
+					if (!args.ReadString(value)) { bOk = false; break; }
+					if (spec.numStarArgs == 0) snprintf(buffer, sizeof(buffer), specifier.c_str(), value.c_str());
+					else if (spec.numStarArgs == 1) snprintf(buffer, sizeof(buffer), specifier.c_str(), (int)stars[0], value.c_str());
+					else snprintf(buffer, sizeof(buffer), specifier.c_str(), (int)stars[0], (int)stars[1], value.c_str());
+				}
+				break;
+			default:
+				bOk = false;
+				break;
+		}
+		out += bOk ? buffer : specifier;
+	}
+	for (const char* c = literal; *c; c++) {
+		out += *c;
+		if (*c == '%' && c[1] == '%') c++;
+	}
+	return out;
+}
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		printf("usage: logdecode <rapturelog.rblg> [output.log]\n");
+		return 1;
+	}
+
+	FILE* in = fopen(argv[1], "rb");
+	if (!in) {
+		printf("could not open %s\n", argv[1]);
+		return 1;
+	}
+	FILE* out = stdout;
+	if (argc >= 3) {
+		out = fopen(argv[2], "wb");
+		if (!out) {
+			printf("could not open %s for writing\n", argv[2]);
+			fclose(in);
+			return 1;
+		}
+	}
+
+	char header[4];
+	uint32_t version;
+	if (fread(header, 1, 4, in) != 4 || strncmp(header, BLOG_HEADER, 4) || fread(&version, sizeof(version), 1, in) != 1) {
+		printf("%s is not a binary log\n", argv[1]);
+		fclose(in);
+		return 1;
+	}
+	if (version != BLOG_VERSION) {
+		printf("%s is version %u, expected version %u\n", argv[1], version, BLOG_VERSION);
+		fclose(in);
+		return 1;
+	}
+
+	unordered_map<uint32_t, string> formats;
+	vector<unsigned char> argData;
+	bool bLastHadNewline = true;
+	size_t numMessages = 0;
+	uint8_t type;
+	while (fread(&type, 1, 1, in) == 1) {
+		if (type == BLOG_RECORD_FORMAT) {
+			uint32_t id;
+			uint16_t length;
+			if (fread(&id, sizeof(id), 1, in) != 1 || fread(&length, sizeof(length), 1, in) != 1) break;
+			string format(length, '\0');
+			if (length > 0 && fread(&format[0], 1, length, in) != length) break;
+			formats[id] = format;
+		}
+		else if (type == BLOG_RECORD_MESSAGE) {
+			uint8_t priority;
+			uint32_t ticks, id;
+			uint16_t argSize;
+			if (fread(&priority, 1, 1, in) != 1 || fread(&ticks, sizeof(ticks), 1, in) != 1 ||
+				fread(&id, sizeof(id), 1, in) != 1 || fread(&argSize, sizeof(argSize), 1, in) != 1) break;
+			argData.resize(argSize);
+			if (argSize > 0 && fread(&argData[0], 1, argSize, in) != argSize) break;
+
+			string text;
+			auto it = formats.find(id);
+			if (it == formats.end()) {
+				char unknown[64];
+				snprintf(unknown, sizeof(unknown), "<unknown format %u>\n", id);
+				text = unknown;
+			}
+			else {
+				argReader_t args = { argData.empty() ? nullptr : &argData[0], argData.size(), 0 };
+				text = formatmessage(it->second, args);
+			}
+
+			// Same layout as the text log
+			if (bLastHadNewline) {
+				fprintf(out, "%02u:%02u:%02u ", ticks / 3600000, ticks / 60000, ticks / 1000);
+				fprintf(out, "%s", priority < sizeof(priorityTags) / sizeof(priorityTags[0]) ? priorityTags[priority] : priorityTags[1]);
+			}
+			fwrite(text.c_str(), 1, text.length(), out);
+			bLastHadNewline = text.length() > 0 && text[text.length() - 1] == '\n';
+			numMessages++;
+		}
+		else {
+			printf("corrupt record (type %u), stopping\n", type);
+			break;
+		}
+	}
+
+	fclose(in);
+	if (out != stdout) {
+		fclose(out);
+		printf("decoded %u messages\n", (unsigned int)numMessages);
+	}
+	return 0;
+}